@@ -0,0 +1,1223 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include "TransmittanceMap.hpp"
+#include "TransmittanceTable.hpp"
+#include "ScatteringMap.hpp"
+#include "IrradianceMap.hpp"
+#include "TableFile.hpp"
+#include "TextureSampler.hpp"
+#include "SkyRenderer.hpp"
+#include "AccuracySweep.hpp"
+
+// Micro-benchmarks of the integrators and their building blocks, and whole-map benchmarks at the resolutions of the
+// Scattering project, the latter at thread counts doubling from 1 up to every core.
+//
+//   Benchmark [--quick] [--filter <substring>] [--repetitions <n>] [--threads <n>] [--json <file>]
+//   Benchmark --accuracy [--quick] [--planet earth|mars] [--threads <n>]
+//
+// Every result reports the best of the repetitions. With --json the results are also written as one JSON document,
+// meant to be kept per version and compared to catch regressions. The FastMath lookup tables, the analytic
+// transmittance and the vectorized kernels are checked against their error bounds first, and the exit code is 1 if
+// one of them fails.
+//
+// With --accuracy the benchmarks give way to a sweep of cheaper settings of the maps against a reference baked with
+// many samples, reporting the error and wall time of each and the Pareto frontier of every map. The default settings
+// are checked against error bounds as well, so an optimization that changes the maps can be accepted by the same exit
+// code.
+namespace
+{
+    struct Options final
+    {
+        bool quick = false;
+        std::string filter;
+        int repetitions = 3;
+        int maxThreads = 1;
+        std::string jsonFileName;
+        bool accuracy = false;
+        std::string planet = "earth";
+    };
+
+    struct Result final
+    {
+        std::string name;
+        std::string group;
+        int threads = 1;
+        double seconds = 0.0;
+        // Calls for micro-benchmarks, texels for maps.
+        double items = 0.0;
+        // Density evaluations, zero where the benchmark does not integrate.
+        double samples = 0.0;
+        // Time with one thread divided by this time, for the maps.
+        double speedup = 1.0;
+    };
+
+    // Keeps the compiler from dropping the work whose results are otherwise unused.
+    float volatile sink = 0.0f;
+
+    auto Consume(float const value) -> void
+    {
+        sink = sink + value;
+    }
+
+    auto Consume(Vector3 const& value) -> void
+    {
+        sink = sink + value.x + value.y + value.z;
+    }
+
+    auto GetMaxThreads() -> int
+    {
+#if defined(_OPENMP)
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    auto SetThreads(int const threads) -> void
+    {
+#if defined(_OPENMP)
+        omp_set_num_threads(threads);
+#else
+        static_cast<void>(threads);
+#endif
+    }
+
+    // Best time of the repetitions, together with the density evaluations of the last one.
+    template <typename Function>
+    auto Measure(int const repetitions, Function const& function, std::int64_t& evaluations) -> double
+    {
+        auto best = 0.0;
+        for(auto repetition = 0; repetition < repetitions; ++repetition)
+        {
+            auto const evaluationsBefore = Atmos::Quadrature::EvaluationCount();
+            auto const start = std::chrono::steady_clock::now();
+            evaluations = function();
+            auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(evaluations == 0)
+            {
+                evaluations = Atmos::Quadrature::EvaluationCount() - evaluationsBefore;
+            }
+            best = repetition == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+
+    class Suite final
+    {
+        Options options;
+        std::vector<Result> results;
+
+    public:
+        explicit Suite(Options const& options)
+            : options(options)
+        { }
+
+        // Function performs one batch of calls and returns zero, the evaluations being read from the quadrature
+        // counter.
+        template <typename Function>
+        auto Micro(std::string const& name, std::int64_t const calls, Function const& function) -> void
+        {
+            if(!Selected(name))
+            {
+                return;
+            }
+
+            SetThreads(1);
+            auto evaluations = std::int64_t(0);
+            auto const seconds = Measure(options.repetitions, [&] { function(); return std::int64_t(0); }, evaluations);
+
+            Add({ name, "micro", 1, seconds, static_cast<double>(calls), static_cast<double>(evaluations), 1.0 });
+        }
+
+        // MakeAndCompute builds and computes a map and returns its evaluation count.
+        template <typename Function>
+        auto Map(std::string const& name, std::int64_t const texels, Function const& makeAndCompute) -> void
+        {
+            if(!Selected(name))
+            {
+                return;
+            }
+
+            auto singleThreadSeconds = 0.0;
+            for(auto const threads : GetThreadCounts())
+            {
+                SetThreads(threads);
+                auto evaluations = std::int64_t(0);
+                auto const seconds = Measure(options.repetitions, makeAndCompute, evaluations);
+                if(threads == 1)
+                {
+                    singleThreadSeconds = seconds;
+                }
+
+                Add({ name, "map", threads, seconds, static_cast<double>(texels), static_cast<double>(evaluations),
+                    seconds > 0.0 ? singleThreadSeconds / seconds : 0.0 });
+            }
+            SetThreads(options.maxThreads);
+        }
+
+        auto WriteJson(std::string const& fileName) const -> void
+        {
+            auto fout = std::ofstream(fileName);
+            if(!fout)
+            {
+                throw;
+            }
+
+            fout << std::setprecision(9);
+            fout << "{\n  \"isa\": \"" << Atmos::Simd::GetIsaName(Atmos::Simd::GetIsa()) << "\",\n  \"maxThreads\": "
+                << options.maxThreads << ",\n  \"quick\": " << (options.quick ? "true" : "false")
+                << ",\n  \"results\": [\n";
+            for(std::size_t i = 0; i < results.size(); ++i)
+            {
+                auto const& result = results[i];
+                fout << "    { \"name\": \"" << result.name << "\", \"group\": \"" << result.group
+                    << "\", \"threads\": " << result.threads << ", \"seconds\": " << result.seconds
+                    << ", \"items\": " << result.items << ", \"samples\": " << result.samples
+                    << ", \"itemsPerSecond\": " << PerSecond(result.items, result.seconds)
+                    << ", \"samplesPerSecond\": " << PerSecond(result.samples, result.seconds)
+                    << ", \"speedup\": " << result.speedup << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            fout << "  ]\n}\n";
+        }
+
+        [[nodiscard]]
+        auto IsQuick() const -> bool
+        {
+            return options.quick;
+        }
+
+    private:
+        auto Selected(std::string const& name) const -> bool
+        {
+            return options.filter.empty() || name.find(options.filter) != std::string::npos;
+        }
+
+        auto GetThreadCounts() const -> std::vector<int>
+        {
+            auto counts = std::vector<int>();
+            for(auto threads = 1; threads < options.maxThreads; threads *= 2)
+            {
+                counts.push_back(threads);
+            }
+            counts.push_back(options.maxThreads);
+            return counts;
+        }
+
+        auto Add(Result const& result) -> void
+        {
+            std::cout << std::left << std::setw(56) << result.name << std::right
+                << std::setw(4) << result.threads << " threads"
+                << std::setw(12) << std::setprecision(4) << result.seconds * 1e3 << " ms"
+                << std::setw(12) << std::setprecision(4) << PerSecond(result.items, result.seconds) << " items/s";
+            if(result.samples > 0.0)
+            {
+                std::cout << std::setw(12) << std::setprecision(4) << PerSecond(result.samples, result.seconds) << " samples/s";
+            }
+            if(result.group == "map")
+            {
+                std::cout << std::setw(8) << std::setprecision(3) << result.speedup << "x";
+            }
+            std::cout << std::endl;
+
+            results.push_back(result);
+        }
+
+        auto static PerSecond(double const count, double const seconds) -> double
+        {
+            return seconds > 0.0 ? count / seconds : 0.0;
+        }
+    };
+
+    auto RunMicroBenchmarks(Suite& suite, Atmos::TransmittanceTable const& table) -> void
+    {
+        auto const& pp = table.GetPlanetProperties();
+        auto const count = suite.IsQuick() ? 1024 : 8192;
+
+        auto generator = std::mt19937(7);
+        auto unit = std::uniform_real_distribution<float>(0.0f, 1.0f);
+        auto signedUnit = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+
+        auto const randomDirection = [&]
+        {
+            auto const zenithCos = signedUnit(generator);
+            auto const zenithSin = std::sqrtf(1.0f - zenithCos * zenithCos);
+            auto const azimuth = 6.2831853f * unit(generator);
+            return Vector3(zenithSin * std::cosf(azimuth), zenithCos, zenithSin * std::sinf(azimuth));
+        };
+
+        // Observers inside the atmosphere looking in every direction, with the exit points of their view rays.
+        auto origins = std::vector<Vector3>(count);
+        auto directions = std::vector<Vector3>(count);
+        auto exitPoints = std::vector<Vector3>(count);
+        auto sunDirections = std::vector<Vector3>(count);
+        auto radii = std::vector<float>(count);
+        auto cosines = std::vector<float>(count);
+        for(auto i = 0; i < count; ++i)
+        {
+            origins[i] = Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * unit(generator) * 0.99f + 0.01f, 0.0f);
+            directions[i] = randomDirection();
+            sunDirections[i] = randomDirection();
+            auto const ground = RayCircleIntersection(origins[i], directions[i], pp.GetPlanetRadius());
+            exitPoints[i] = ground ? ground.value() : RayCircleIntersection(origins[i], directions[i], pp.GetAtmosphereRadius()).value();
+            radii[i] = origins[i].Length();
+            cosines[i] = signedUnit(generator);
+        }
+
+        suite.Micro("RayCircleIntersection", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                auto const hit = RayCircleIntersection(origins[i], directions[i], pp.GetAtmosphereRadius());
+                Consume(hit ? hit.value() : Vector3());
+            }
+        });
+
+        // The densities also with the lookup tables of MathMode::Fast.
+        auto const fastPp = [&]
+        {
+            auto properties = pp;
+            properties.SetMathMode(Atmos::MathMode::Fast);
+            return properties;
+        }();
+
+        for(auto const* const properties : { &pp, &fastPp })
+        {
+            auto const suffix = properties->GetMathMode() == Atmos::MathMode::Fast ? std::string("/Fast") : std::string();
+
+            suite.Micro("PlanetProperties::RayleightDensityRadius" + suffix, count, [&]
+            {
+                for(auto i = 0; i < count; ++i)
+                {
+                    Consume(properties->RayleightDensityRadius(radii[i]));
+                }
+            });
+
+            suite.Micro("PlanetProperties::MieDensityRadius" + suffix, count, [&]
+            {
+                for(auto i = 0; i < count; ++i)
+                {
+                    Consume(properties->MieDensityRadius(radii[i]));
+                }
+            });
+
+        }
+
+        suite.Micro("PlanetProperties::RayleightPhaseCos", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(pp.RayleightPhaseCos(cosines[i]));
+            }
+        });
+
+        suite.Micro("PlanetProperties::MiePhaseCos", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(pp.MiePhaseCos(cosines[i]));
+            }
+        });
+
+        // Exponents of the densities.
+        auto exponents = std::vector<float>(count);
+        for(auto i = 0; i < count; ++i)
+        {
+            exponents[i] = -80.0f * unit(generator);
+        }
+
+        suite.Micro("std::expf", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(std::expf(exponents[i]));
+            }
+        });
+
+        auto coordinates = std::vector<float>(4 * count);
+        for(auto& coordinate : coordinates)
+        {
+            coordinate = unit(generator);
+        }
+
+        auto const texture1D = Atmos::Texture1D<Vector3>(512);
+        auto const texture2D = Atmos::Texture2D<Vector3>(512, 512);
+        auto const texture3D = Atmos::Texture3D<Vector3>(64, 64, 16);
+        auto const texture4D = Atmos::Texture4D<Vector3>(64, 32, 8, 16);
+
+        suite.Micro("Texture1D::Sample", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(texture1D.Sample(coordinates[4 * i]));
+            }
+        });
+
+        suite.Micro("Texture2D::Sample", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(texture2D.Sample(coordinates[4 * i], coordinates[4 * i + 1]));
+            }
+        });
+
+        suite.Micro("Texture3D::Sample", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(texture3D.Sample(coordinates[4 * i], coordinates[4 * i + 1], coordinates[4 * i + 2]));
+            }
+        });
+
+        suite.Micro("Texture4D::Sample", count, [&]
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                Consume(texture4D.Sample(coordinates[4 * i], coordinates[4 * i + 1], coordinates[4 * i + 2], coordinates[4 * i + 3]));
+            }
+        });
+
+        // The same lookups in bulk, with the coordinates of each axis in an array of their own.
+        auto axes = std::vector<std::vector<float>>(4, std::vector<float>(count));
+        for(auto i = 0; i < count; ++i)
+        {
+            for(auto axis = 0; axis < 4; ++axis)
+            {
+                axes[axis][i] = coordinates[4 * i + axis];
+            }
+        }
+        auto texels = std::vector<Vector3>(count);
+        auto const lookupCount = static_cast<std::size_t>(count);
+
+        suite.Micro("TextureSampler::Sample/1D", count, [&]
+        {
+            Atmos::TextureSampler::Sample(texture1D.GetView(), lookupCount, axes[0].data(), texels.data());
+            Consume(texels[count - 1]);
+        });
+
+        suite.Micro("TextureSampler::Sample/2D", count, [&]
+        {
+            Atmos::TextureSampler::Sample(texture2D.GetView(), lookupCount, axes[0].data(), axes[1].data(), texels.data());
+            Consume(texels[count - 1]);
+        });
+
+        suite.Micro("TextureSampler::Sample/3D", count, [&]
+        {
+            Atmos::TextureSampler::Sample(texture3D.GetView(), lookupCount, axes[0].data(), axes[1].data(), axes[2].data(),
+                texels.data());
+            Consume(texels[count - 1]);
+        });
+
+        suite.Micro("TextureSampler::Sample/4D", count, [&]
+        {
+            Atmos::TextureSampler::Sample(texture4D.GetView(), lookupCount, axes[0].data(), axes[1].data(), axes[2].data(),
+                axes[3].data(), texels.data());
+            Consume(texels[count - 1]);
+        });
+
+        // Integrators are slower by orders of magnitude, a fraction of the rays is enough.
+        auto const rayCount = count / 16;
+
+        struct TransmittanceCase final
+        {
+            char const* name;
+            Atmos::Transmittance::IntegrationParameters params;
+        };
+        TransmittanceCase const transmittanceCases[] = {
+            { "Transmittance::GetPathTransmittance/Midpoint512/Scalar",
+                { 512, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Scalar, Atmos::QuadratureRule::Midpoint } },
+            { "Transmittance::GetPathTransmittance/Midpoint512/Simd",
+                { 512, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Simd, Atmos::QuadratureRule::Midpoint } },
+            { "Transmittance::GetPathTransmittance/Gauss32/Simd",
+                { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Simd, Atmos::QuadratureRule::GaussLegendre } },
+            { "Transmittance::GetPathTransmittance/Analytic",
+                { 0, Atmos::Transmittance::Method::Analytic } },
+        };
+        for(auto const& transmittanceCase : transmittanceCases)
+        {
+            suite.Micro(transmittanceCase.name, rayCount, [&]
+            {
+                for(auto i = 0; i < rayCount; ++i)
+                {
+                    Consume(Atmos::Transmittance::GetPathTransmittance(origins[i], exitPoints[i], pp, transmittanceCase.params));
+                }
+            });
+        }
+
+        struct ScatteringCase final
+        {
+            char const* name;
+            Atmos::Scattering::IntegrationParams params;
+        };
+        ScatteringCase const scatteringCases[] = {
+            { "Scattering::GetPathScattering/Midpoint64/Scalar", { 64, Atmos::Kernel::Scalar, Atmos::QuadratureRule::Midpoint } },
+            { "Scattering::GetPathScattering/Midpoint64/Simd", { 64, Atmos::Kernel::Simd, Atmos::QuadratureRule::Midpoint } },
+            { "Scattering::GetPathScattering/AltitudeAdapted64/Simd", { 64, Atmos::Kernel::Simd, Atmos::QuadratureRule::AltitudeAdapted } },
+            { "Scattering::GetPathScattering/Adaptive", { 256, Atmos::Kernel::Scalar, Atmos::QuadratureRule::Adaptive, 1e-3f } },
+        };
+        for(auto const& scatteringCase : scatteringCases)
+        {
+            suite.Micro(scatteringCase.name, rayCount, [&]
+            {
+                for(auto i = 0; i < rayCount; ++i)
+                {
+                    Consume(Atmos::Scattering::GetPathScattering(origins[i], exitPoints[i], sunDirections[i], table, scatteringCase.params));
+                }
+            });
+        }
+    }
+
+    auto RunMapBenchmarks(Suite& suite, Atmos::PlanetProperties const& pp, Atmos::TransmittanceTable const& table) -> void
+    {
+        auto const scale = suite.IsQuick() ? std::size_t(4) : std::size_t(1);
+        auto const size = [](std::size_t const u, std::size_t const v)
+        {
+            return std::to_string(u) + "x" + std::to_string(v);
+        };
+
+        suite.Map("TransmittanceMap/" + std::to_string(512 / scale), 512 / scale, [&]
+        {
+            auto map = Atmos::TransmittanceMap(512 / scale, pp, { 512 });
+            map.Compute();
+            return map.GetEvaluationCount();
+        });
+
+        suite.Map("TransmittanceTable/" + size(256 / scale, 64 / scale), (256 / scale) * (64 / scale), [&]
+        {
+            auto map = Atmos::TransmittanceTable(256 / scale, 64 / scale, pp,
+                { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+            map.Compute();
+            return map.GetEvaluationCount();
+        });
+
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale), (512 / scale) * (512 / scale), [&]
+        {
+            auto map = Atmos::ScatteringMap(512 / scale, 512 / scale, table,
+                { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+            map.Compute(Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+            return map.GetEvaluationCount();
+        });
+
+        // The same map traced row by row, every row tracing the view rays again.
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale) + "/Rows", (512 / scale) * (512 / scale), [&]
+        {
+            auto params = Atmos::Scattering::IntegrationParams{ 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted };
+            params.reuseViewSamples = false;
+
+            auto map = Atmos::ScatteringMap(512 / scale, 512 / scale, table, params);
+            map.Compute(Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+            return map.GetEvaluationCount();
+        });
+
+        // The same map for 8 and 16 wavelengths, which fill the lanes where RGB fills three of them. The optical depths
+        // they read are computed once, as the transmittance table is.
+        auto spectralTable = table;
+        spectralTable.ComputeOpticalDepths();
+
+        auto const spectralPp8 = Atmos::SpectralPlanetProperties<8>(pp);
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale) + "/Spectral8", (512 / scale) * (512 / scale), [&]
+        {
+            auto map = Atmos::ScatteringMap(512 / scale, 512 / scale, spectralTable,
+                { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+            map.ComputeSpectral(spectralPp8, Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+            return map.GetEvaluationCount();
+        });
+
+        auto const spectralPp16 = Atmos::SpectralPlanetProperties<16>(pp);
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale) + "/Spectral16", (512 / scale) * (512 / scale), [&]
+        {
+            auto map = Atmos::ScatteringMap(512 / scale, 512 / scale, spectralTable,
+                { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+            map.ComputeSpectral(spectralPp16, Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+            return map.GetEvaluationCount();
+        });
+
+        // The same map baked as separate Rayleigh and Mie tables, and the pass that applies new phase functions and
+        // scattering coefficients to them.
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale) + "/Deferred", (512 / scale) * (512 / scale), [&]
+        {
+            auto map = Atmos::ScatteringMap(512 / scale, 512 / scale, table,
+                { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+            map.ComputeDeferred(Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+            return map.GetEvaluationCount();
+        });
+
+        auto deferredMap = Atmos::ScatteringMap(512 / scale, 512 / scale, table,
+            { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+        deferredMap.ComputeDeferred(Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+        auto hazy = pp;
+        hazy.SetMieAsymmetryCoef(0.9f);
+        suite.Map("ScatteringMap/" + size(512 / scale, 512 / scale) + "/Resolve", (512 / scale) * (512 / scale), [&]
+        {
+            deferredMap.Resolve(hazy);
+            return std::int64_t(0);
+        });
+
+        // Opening a table file and sampling one of its tables in place, the start-up cost of an engine loading them.
+        auto const tableFileName = "benchmark.tables";
+        Atmos::TableFileWriter()
+            .Add("transmittance", table.GetTexture())
+            .Add("scattering", deferredMap.GetTexture(),
+                Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear)
+            .Write(tableFileName, pp);
+        suite.Micro("TableFile::Open", 100, [&]
+        {
+            for(auto i = 0; i < 100; ++i)
+            {
+                auto file = Atmos::TableFile();
+                file.Open(tableFileName);
+                Consume(file.GetTexture2D<Vector3>("scattering").Sample(0.5f, 0.5f));
+            }
+        });
+        std::remove(tableFileName);
+
+        suite.Map("IrradianceMap/" + size(512 / scale, 128), 512 / scale, [&]
+        {
+            auto map = Atmos::IrradianceMap(512 / scale, 128, table,
+                { 32, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+            map.Compute();
+            return map.GetEvaluationCount();
+        });
+
+        // The reference sky renderer, drawing a frame from the baked tables and by integrating every ray.
+        auto fullMap = Atmos::ScatteringMap(64 / scale, 32 / scale, 16 / scale, 8, table,
+            { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+        fullMap.ComputeFullDeferred(Atmos::ScatteringMap::Mapping::Cubic, Atmos::ScatteringMap::Mapping::Linear);
+        auto irradianceMap = Atmos::IrradianceMap(128, 32, table,
+            { 32, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+        irradianceMap.Compute();
+        auto const renderer = Atmos::SkyRenderer(fullMap, table, irradianceMap,
+            { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted },
+            { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+
+        auto camera = Atmos::SkyRenderer::Camera();
+        camera.width = static_cast<int>(512 / scale);
+        camera.height = static_cast<int>(256 / scale);
+        auto const pixelCount = static_cast<std::size_t>(camera.width * camera.height);
+        suite.Map("SkyRenderer/" + size(512 / scale, 256 / scale) + "/Tables", pixelCount, [&]
+        {
+            return renderer.Render(camera, Atmos::SkyRenderer::Mode::Tables).evaluationCount;
+        });
+        suite.Map("SkyRenderer/" + size(512 / scale, 256 / scale) + "/Raymarch", pixelCount, [&]
+        {
+            return renderer.Render(camera, Atmos::SkyRenderer::Mode::Raymarch).evaluationCount;
+        });
+    }
+
+    // The planets the checks and the accuracy sweep run for, the Earth defaults and the Mars-like planet of the Scattering
+    // project.
+    auto GetPlanet(std::string const& name) -> std::optional<Atmos::PlanetProperties>
+    {
+        auto pp = Atmos::PlanetProperties();
+        if(name == "earth")
+        {
+            return pp;
+        }
+        if(name == "mars")
+        {
+            pp.SetPlanetRadius(3400.0f);
+            pp.SetAtmosphereHeight(50.0f);
+            pp.SetRayleightScaleHeight(11.0f);
+            pp.SetMieScaleHeight(2.0f);
+            pp.SetRayleightScatteringCoef(Vector3(0.0331f, 0.0135f, 0.0058f));
+            pp.SetRayleightExtinctionCoef(Vector3(0.0331f, 0.0135f, 0.0058f));
+            return pp;
+        }
+        return std::nullopt;
+    }
+
+    struct Ray final
+    {
+        Vector3 origin;
+        Vector3 direction;
+        Vector3 exitPoint;
+    };
+
+    auto GetExitPoint(Atmos::PlanetProperties const& pp, Vector3 const& origin, Vector3 const& direction) -> Vector3
+    {
+        auto const ground = RayCircleIntersection(origin, direction, pp.GetPlanetRadius());
+        return ground ? ground.value() : RayCircleIntersection(origin, direction, pp.GetAtmosphereRadius()).value();
+    }
+
+    // Rays from random points inside the atmosphere in random directions, up to the ground or the top of the
+    // atmosphere.
+    auto GetRandomRays(Atmos::PlanetProperties const& pp, int const count) -> std::vector<Ray>
+    {
+        auto generator = std::mt19937(7);
+        auto unit = std::uniform_real_distribution<float>(0.0f, 1.0f);
+
+        auto rays = std::vector<Ray>(count);
+        for(auto& ray : rays)
+        {
+            ray.origin = Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * unit(generator) * 0.99f + 0.01f, 0.0f);
+            auto const zenithCos = 2.0f * unit(generator) - 1.0f;
+            auto const zenithSin = std::sqrtf(1.0f - zenithCos * zenithCos);
+            auto const azimuth = 6.2831853f * unit(generator);
+            ray.direction = Vector3(zenithSin * std::cosf(azimuth), zenithCos, zenithSin * std::sinf(azimuth));
+            ray.exitPoint = GetExitPoint(pp, ray.origin, ray.direction);
+        }
+        return rays;
+    }
+
+    // Largest value of error at count evenly spaced points of [first, last].
+    template <typename Error>
+    auto MaxError(float const first, float const last, int const count, Error const& error) -> double
+    {
+        auto maxError = 0.0;
+        for(auto i = 0; i < count; ++i)
+        {
+            maxError = std::max(maxError, error(first + (last - first) * static_cast<float>(i) / static_cast<float>(count - 1)));
+        }
+        return maxError;
+    }
+
+    auto RelativeError(double const value, double const expected) -> double
+    {
+        return std::abs(value - expected) / std::abs(expected);
+    }
+
+    // Largest difference of a channel relative to the brightest channel of the expected color, since a channel in the
+    // shadow of the planet may be near zero.
+    auto RelativeError(Vector3 const& value, Vector3 const& expected) -> double
+    {
+        auto const scale = std::max({ std::abs(expected.x), std::abs(expected.y), std::abs(expected.z),
+            std::numeric_limits<float>::min() });
+        return std::max({ std::abs(value.x - expected.x), std::abs(value.y - expected.y),
+            std::abs(value.z - expected.z) }) / static_cast<double>(scale);
+    }
+
+    // Prints an error next to its bound and reports whether it holds.
+    auto CheckBound(std::string const& name, double const error, double const bound) -> bool
+    {
+        auto const holds = error <= bound;
+        std::cout << std::left << std::setw(56) << name << std::right << std::setw(12) << std::setprecision(3)
+            << error << " <= " << std::setw(9) << bound << (holds ? "" : "  FAILED") << std::endl;
+        return holds;
+    }
+
+    // Checks the Mie phase function against double precision and every MathMode::Fast table against MathMode::Exact,
+    // each within its documented bound. Reports whether all of them hold.
+    auto CheckFastMath(Atmos::PlanetProperties const& pp, bool const quick) -> bool
+    {
+        auto const count = quick ? 100000 : 2000000;
+        auto passed = true;
+
+        auto const check = [&](std::string const& name, double const error, double const bound)
+        {
+            passed = CheckBound(name, error, bound) && passed;
+        };
+
+        // The power of 1.5 taken as a product with the square root.
+        check("PlanetProperties::MiePhaseCos", MaxError(-1.0f, 1.0f, count, [&](float const cos)
+        {
+            auto const g = static_cast<double>(pp.GetMieAsymmetryCoef());
+            auto const c = static_cast<double>(cos);
+            auto const expected = 3.0 / 8.0 / 3.14159265358979323846 * (1.0 - g * g) * (1.0 + c * c) / (2.0 + g * g)
+                / std::pow(1.0 + g * g - 2.0 * g * c, 1.5);
+            return RelativeError(pp.MiePhaseCos(cos), expected);
+        }), 2e-5);
+
+        auto exact = pp;
+        exact.SetMathMode(Atmos::MathMode::Exact);
+        auto fast = exact;
+        fast.SetMathMode(Atmos::MathMode::Fast);
+
+        // The interpolation bound of the tables, (spacing / scale height)^2 / 8, and the rounding of the index.
+        auto const spacing = static_cast<double>(pp.GetAtmosphereHeight()) / 4095.0;
+        auto const densityBound = [&](float const scaleHeight)
+        {
+            return 1e-5 + spacing * spacing / (8.0 * scaleHeight * scaleHeight);
+        };
+
+        check("PlanetProperties::RayleightDensityRadius/Fast", MaxError(pp.GetPlanetRadius(), pp.GetAtmosphereRadius(), count,
+            [&](float const radius)
+            {
+                return RelativeError(fast.RayleightDensityRadius(radius), exact.RayleightDensityRadius(radius));
+            }), densityBound(pp.GetRayleightScaleHeight()));
+        check("PlanetProperties::MieDensityRadius/Fast", MaxError(pp.GetPlanetRadius(), pp.GetAtmosphereRadius(), count,
+            [&](float const radius)
+            {
+                return RelativeError(fast.MieDensityRadius(radius), exact.MieDensityRadius(radius));
+            }), densityBound(pp.GetMieScaleHeight()));
+
+        return passed;
+    }
+
+    // Checks Transmittance::Method::Analytic against Numeric with 4096 steps on random rays of both planets, for the
+    // bounds documented with the method: 2e-3 absolute on the transmittance and 1% relative on the optical depths.
+    auto CheckAnalyticTransmittance(bool const quick) -> bool
+    {
+        auto const numeric = Atmos::Transmittance::IntegrationParameters{
+            4096, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Scalar, Atmos::QuadratureRule::Midpoint };
+        auto const analytic = Atmos::Transmittance::IntegrationParameters{ 0, Atmos::Transmittance::Method::Analytic };
+
+        auto passed = true;
+        for(auto const* const name : { "earth", "mars" })
+        {
+            auto const pp = GetPlanet(name).value();
+
+            auto transmittanceError = 0.0;
+            auto depthError = 0.0;
+            for(auto const& ray : GetRandomRays(pp, quick ? 1000 : 10000))
+            {
+                auto const expected = Atmos::Transmittance::GetPathTransmittance(ray.origin, ray.exitPoint, pp, numeric);
+                auto const value = Atmos::Transmittance::GetPathTransmittance(ray.origin, ray.exitPoint, pp, analytic);
+                transmittanceError = std::max({ transmittanceError, std::abs(static_cast<double>(value.x - expected.x)),
+                    std::abs(static_cast<double>(value.y - expected.y)), std::abs(static_cast<double>(value.z - expected.z)) });
+
+                auto const expectedDepth = Atmos::Transmittance::GetPathDensity(ray.origin, ray.exitPoint, pp, numeric);
+                auto const depth = Atmos::Transmittance::GetPathDensity(ray.origin, ray.exitPoint, pp, analytic);
+                depthError = std::max({ depthError, RelativeError(depth.x, expectedDepth.x),
+                    RelativeError(depth.y, expectedDepth.y) });
+            }
+
+            passed = CheckBound(std::string("Transmittance/Analytic/") + name, transmittanceError, 2e-3) && passed;
+            passed = CheckBound(std::string("Transmittance/Analytic/") + name + " (optical depth)", depthError, 1e-2)
+                && passed;
+        }
+        return passed;
+    }
+
+    // Checks the Simd and Packet kernels against the Scalar one they replace, on random rays of both planets in both
+    // math modes with the sun along another of the rays: transmittance, and single scattering both integrated
+    // numerically and read from a transmittance table. Packets share the origin of their first ray. The kernels differ
+    // from the scalar loops in the order of their sums and in Simd::Exp, which the bound of 1e-5 relative covers.
+    // Scattering is compared relative to the brightest channel of its ray.
+    // The bound assumes the compiler does not contract multiplies and adds into FMAs, as MSVC does not by default:
+    // a contracted altitude |p| - R may move by an ulp of the radius, which is 1e-4 of the Mie density.
+    auto CheckKernels(bool const quick) -> bool
+    {
+        using Atmos::Kernel;
+        using Atmos::QuadratureRule;
+        auto const tableParams = Atmos::Transmittance::IntegrationParameters{
+            32, Atmos::Transmittance::Method::Numeric, Kernel::Packet, QuadratureRule::GaussLegendre };
+
+        auto passed = true;
+        for(auto const* const name : { "earth", "mars" })
+        {
+            for(auto const mathMode : { Atmos::MathMode::Exact, Atmos::MathMode::Fast })
+            {
+                auto pp = GetPlanet(name).value();
+                pp.SetMathMode(mathMode);
+                auto table = Atmos::TransmittanceTable(256, 64, pp, tableParams);
+                table.Compute();
+
+                auto const rays = GetRandomRays(pp, quick ? 256 : 2048);
+                auto const packetWidth = 16;
+
+                for(auto const rule : { QuadratureRule::Midpoint, QuadratureRule::GaussLegendre })
+                {
+                    auto const sampleCount = rule == QuadratureRule::Midpoint ? 256 : 32;
+                    auto const ruleName = std::string(rule == QuadratureRule::Midpoint ? "/Midpoint" : "/GaussLegendre");
+                    auto const tParams = [&](Kernel const kernel)
+                    {
+                        return Atmos::Transmittance::IntegrationParameters{
+                            sampleCount, Atmos::Transmittance::Method::Numeric, kernel, rule };
+                    };
+                    auto const sParams = [&](Kernel const kernel)
+                    {
+                        return Atmos::Scattering::IntegrationParams{ sampleCount, kernel, rule };
+                    };
+
+                    auto transmittanceError = 0.0;
+                    auto scatteringError = 0.0;
+                    auto tableScatteringError = 0.0;
+                    for(std::size_t i = 0; i < rays.size(); ++i)
+                    {
+                        auto const& ray = rays[i];
+                        auto const& sunDir = rays[rays.size() - 1 - i].direction;
+
+                        auto const transmittance = Atmos::Transmittance::GetPathTransmittance(ray.origin, ray.exitPoint, pp,
+                            tParams(Kernel::Scalar));
+                        transmittanceError = std::max(transmittanceError, RelativeError(Atmos::Transmittance::GetPathTransmittance(
+                            ray.origin, ray.exitPoint, pp, tParams(Kernel::Simd)), transmittance));
+
+                        auto const scattering = Atmos::Scattering::GetPathScattering(ray.origin, ray.exitPoint, sunDir, pp,
+                            tParams(Kernel::Scalar), sParams(Kernel::Scalar));
+                        scatteringError = std::max(scatteringError, RelativeError(Atmos::Scattering::GetPathScattering(
+                            ray.origin, ray.exitPoint, sunDir, pp, tParams(Kernel::Simd), sParams(Kernel::Simd)), scattering));
+
+                        auto const tableScattering = Atmos::Scattering::GetPathScattering(ray.origin, ray.exitPoint, sunDir,
+                            table, sParams(Kernel::Scalar));
+                        tableScatteringError = std::max(tableScatteringError, RelativeError(Atmos::Scattering::GetPathScattering(
+                            ray.origin, ray.exitPoint, sunDir, table, sParams(Kernel::Simd)), tableScattering));
+                    }
+
+                    auto packetTransmittanceError = 0.0;
+                    auto packetScatteringError = 0.0;
+                    for(std::size_t first = 0; first + packetWidth <= rays.size(); first += packetWidth)
+                    {
+                        auto const origin = rays[first].origin;
+                        auto const& sunDir = rays[rays.size() - 1 - first].direction;
+
+                        Vector3 exitPoints[packetWidth];
+                        for(auto i = 0; i < packetWidth; ++i)
+                        {
+                            exitPoints[i] = GetExitPoint(pp, origin, rays[first + i].direction);
+                        }
+
+                        Vector3 transmittance[packetWidth];
+                        Vector3 scattering[packetWidth];
+                        Atmos::Transmittance::GetPathTransmittancePacket(origin, exitPoints, packetWidth, pp,
+                            tParams(Kernel::Packet), transmittance);
+                        Atmos::Scattering::GetPathScatteringPacket(origin, exitPoints, packetWidth, sunDir, table,
+                            sParams(Kernel::Packet), scattering);
+
+                        for(auto i = 0; i < packetWidth; ++i)
+                        {
+                            packetTransmittanceError = std::max(packetTransmittanceError, RelativeError(transmittance[i],
+                                Atmos::Transmittance::GetPathTransmittance(origin, exitPoints[i], pp, tParams(Kernel::Scalar))));
+                            packetScatteringError = std::max(packetScatteringError, RelativeError(scattering[i],
+                                Atmos::Scattering::GetPathScattering(origin, exitPoints[i], sunDir, table, sParams(Kernel::Scalar))));
+                        }
+                    }
+
+                    auto const prefix = std::string("Kernel/") + name
+                        + (mathMode == Atmos::MathMode::Fast ? "/Fast" : "") + ruleName;
+                    passed = CheckBound(prefix + "/Transmittance/Simd", transmittanceError, 1e-5) && passed;
+                    passed = CheckBound(prefix + "/Transmittance/Packet", packetTransmittanceError, 1e-5) && passed;
+                    passed = CheckBound(prefix + "/Scattering/Simd", scatteringError, 1e-5) && passed;
+                    passed = CheckBound(prefix + "/Scattering/Table/Simd", tableScatteringError, 1e-5) && passed;
+                    passed = CheckBound(prefix + "/Scattering/Table/Packet", packetScatteringError, 1e-5) && passed;
+                }
+            }
+        }
+        return passed;
+    }
+
+    auto GetMappingName(Atmos::ScatteringMap::Mapping const mapping) -> char const*
+    {
+        return mapping == Atmos::ScatteringMap::Mapping::Cubic ? "Cubic" : "Linear";
+    }
+
+    auto GetSamplingName(Atmos::IrradianceMap::HemisphereSampling const sampling) -> char const*
+    {
+        return sampling == Atmos::IrradianceMap::HemisphereSampling::Halton ? "Halton" : "GaussProduct";
+    }
+
+    auto Describe(Atmos::ParameterSweep::TransmittanceTableSpec const& spec) -> std::string
+    {
+        auto const method = spec.params.method == Atmos::Transmittance::Method::Analytic
+            ? std::string("Analytic") : "Gauss" + std::to_string(spec.params.sampleCount);
+        return std::to_string(spec.zenithCosResolution) + "x" + std::to_string(spec.radiusResolution) + "/" + method;
+    }
+
+    auto Describe(Atmos::ParameterSweep::ScatteringMapSpec const& spec) -> std::string
+    {
+        return std::to_string(spec.viewZenithCosResolution) + "x" + std::to_string(spec.sunZenithCosResolution)
+            + "/AltitudeAdapted" + std::to_string(spec.params.sampleCount) + "/" + GetMappingName(spec.viewZenithMapping);
+    }
+
+    auto Describe(Atmos::ParameterSweep::IrradianceMapSpec const& spec) -> std::string
+    {
+        return std::to_string(spec.resolution) + "/" + GetSamplingName(spec.sampling) + std::to_string(spec.samples);
+    }
+
+    // Values of the reference maps of RunAccuracySweep at a few probes, row and column as AccuracySweep lays them out.
+    // The candidates are only compared with a reference baked in the same run, so these catch a change to the reference
+    // itself. Bake them again, and bump CacheKey::CodeVersion, when a change to the computations is meant to move them.
+    struct GoldenProbe final
+    {
+        Atmos::AccuracySweep::Map map;
+        std::size_t row;
+        std::size_t column;
+        Vector3 value;
+    };
+
+    auto GetGoldenProbes(std::string const& planet) -> std::vector<GoldenProbe>
+    {
+        using Map = Atmos::AccuracySweep::Map;
+        if(planet == "earth")
+        {
+            return {
+                { Map::TransmittanceTable, 0, 0, Vector3(0.0614747f, 0.003847115f, 3.326199e-06f) },
+                { Map::TransmittanceTable, 0, 127, Vector3(0.9133433f, 0.8158238f, 0.6120312f) },
+                { Map::TransmittanceTable, 31, 200, Vector3(0.9998825f, 0.9997264f, 0.9993291f) },
+                { Map::TransmittanceTable, 62, 254, Vector3(1.0f, 0.9999999f, 0.9999999f) },
+                { Map::ScatteringMap, 20, 10, Vector3(2.829951e-06f, 6.586786e-06f, 1.614878e-05f) },
+                { Map::ScatteringMap, 100, 127, Vector3(0.008374907f, 0.01556098f, 0.02511057f) },
+                { Map::ScatteringMap, 127, 250, Vector3(0.001434126f, 0.001770863f, 0.0018189f) },
+                { Map::ScatteringMap, 135, 200, Vector3(0.0005067724f, 0.0005228994f, 0.0005004707f) },
+                { Map::IrradianceMap, 0, 100, Vector3(0.0396224f, 0.07874487f, 0.1474139f) },
+                { Map::IrradianceMap, 0, 400, Vector3(0.03546725f, 0.06456542f, 0.0956389f) },
+                { Map::IrradianceMap, 0, 511, Vector3(0.01880347f, 0.02046344f, 0.01518795f) },
+                { Map::IrradianceMap, 0, 560, Vector3(0.0003271894f, 0.0003049201f, 0.0002168507f) }
+            };
+        }
+        if(planet == "mars")
+        {
+            return {
+                { Map::TransmittanceTable, 0, 0, Vector3(4.411151e-05f, 0.01159174f, 0.1034561f) },
+                { Map::TransmittanceTable, 0, 127, Vector3(0.4898447f, 0.740949f, 0.8717594f) },
+                { Map::TransmittanceTable, 31, 200, Vector3(0.9567912f, 0.9821463f, 0.99229f) },
+                { Map::TransmittanceTable, 62, 254, Vector3(0.9998577f, 0.9999421f, 0.9999751f) },
+                { Map::ScatteringMap, 20, 10, Vector3(0.0117434f, 0.005038625f, 0.002208785f) },
+                { Map::ScatteringMap, 100, 127, Vector3(0.02744583f, 0.01889536f, 0.01085089f) },
+                { Map::ScatteringMap, 127, 250, Vector3(0.002572946f, 0.002578456f, 0.002042849f) },
+                { Map::ScatteringMap, 135, 200, Vector3(0.001267416f, 0.001568142f, 0.001527159f) },
+                { Map::IrradianceMap, 0, 100, Vector3(0.1826877f, 0.1099425f, 0.06051034f) },
+                { Map::IrradianceMap, 0, 400, Vector3(0.09930068f, 0.08198988f, 0.05073373f) },
+                { Map::IrradianceMap, 0, 511, Vector3(0.01861503f, 0.02839331f, 0.02714816f) },
+                { Map::IrradianceMap, 0, 560, Vector3(0.001301146f, 0.002739301f, 0.003361259f) }
+            };
+        }
+        return {};
+    }
+
+    // Bakes a reference with far more samples and texels than the defaults of ParameterSweep, sweeps cheaper settings
+    // of every map against it and checks the defaults against error bounds. Reports whether all of them hold.
+    auto RunAccuracySweep(std::string const& planet, Atmos::PlanetProperties const& pp, bool const quick) -> bool
+    {
+        using Sweep = Atmos::ParameterSweep;
+        auto const defaults = Sweep::Specs();
+
+        auto reference = Sweep::Specs();
+        reference.transmittanceTable.zenithCosResolution = 1024;
+        reference.transmittanceTable.radiusResolution = 256;
+        reference.transmittanceTable.params.sampleCount = 128;
+        reference.scatteringMap->viewZenithCosResolution = 1024;
+        reference.scatteringMap->sunZenithCosResolution = 1024;
+        reference.scatteringMap->viewZenithMapping = Atmos::ScatteringMap::Mapping::Cubic;
+        reference.scatteringMap->params.sampleCount = 256;
+        reference.irradianceMap->resolution = 1024;
+        reference.irradianceMap->samples = 1024;
+        reference.irradianceMap->params.sampleCount = 64;
+
+        // Every combination of the settings that trade accuracy for time, the defaults among them. Quick runs leave
+        // out the values between the extremes other than the default.
+        auto const pick = [&](std::vector<int> values, int const defaultValue)
+        {
+            if(quick)
+            {
+                auto const first = values.front();
+                auto const last = values.back();
+                values.erase(std::remove_if(values.begin(), values.end(), [&](int const value)
+                {
+                    return value != first && value != last && value != defaultValue;
+                }), values.end());
+            }
+            return values;
+        };
+
+        auto const& defaultTable = defaults.transmittanceTable;
+        auto const& defaultScattering = *defaults.scatteringMap;
+        auto const& defaultIrradiance = *defaults.irradianceMap;
+
+        auto candidates = std::vector<Atmos::AccuracySweep::Candidate>();
+        for(auto const resolution : pick({ 64, 128, 256 }, static_cast<int>(defaultTable.zenithCosResolution)))
+        {
+            for(auto const sampleCount : pick({ 8, 16, 32 }, defaultTable.params.sampleCount))
+            {
+                auto spec = defaultTable;
+                spec.zenithCosResolution = static_cast<std::size_t>(resolution);
+                spec.radiusResolution = static_cast<std::size_t>(resolution / 4);
+                spec.params.sampleCount = sampleCount;
+                candidates.push_back({ Describe(spec), spec, std::nullopt, std::nullopt });
+            }
+        }
+        for(auto const resolution : pick({ 128, 256, 512 }, static_cast<int>(defaultScattering.viewZenithCosResolution)))
+        {
+            for(auto const sampleCount : pick({ 16, 32, 64 }, defaultScattering.params.sampleCount))
+            {
+                for(auto const mapping : { Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Cubic })
+                {
+                    auto spec = defaultScattering;
+                    spec.viewZenithCosResolution = static_cast<std::size_t>(resolution);
+                    spec.sunZenithCosResolution = static_cast<std::size_t>(resolution);
+                    spec.viewZenithMapping = mapping;
+                    spec.params.sampleCount = sampleCount;
+                    candidates.push_back({ Describe(spec), std::nullopt, spec, std::nullopt });
+                }
+            }
+        }
+        for(auto const resolution : { 128, 512 })
+        {
+            for(auto const samples : pick({ 32, 128, 512 }, defaultIrradiance.samples))
+            {
+                for(auto const sampling : { Atmos::IrradianceMap::HemisphereSampling::GaussProduct,
+                    Atmos::IrradianceMap::HemisphereSampling::Halton })
+                {
+                    auto spec = defaultIrradiance;
+                    spec.resolution = static_cast<std::size_t>(resolution);
+                    spec.samples = samples;
+                    spec.sampling = sampling;
+                    candidates.push_back({ Describe(spec), std::nullopt, std::nullopt, spec });
+                }
+            }
+        }
+
+        auto sweep = Atmos::AccuracySweep(pp, reference);
+        sweep.ComputeReference();
+        std::cout << "Reference " << Describe(reference.transmittanceTable) << ", "
+            << Describe(*reference.scatteringMap) << ", " << Describe(*reference.irradianceMap) << ": "
+            << std::setprecision(4) << sweep.GetReferenceSeconds() << " s" << std::endl;
+
+        auto const results = sweep.Run(candidates);
+
+        for(auto const map : { Atmos::AccuracySweep::Map::TransmittanceTable, Atmos::AccuracySweep::Map::ScatteringMap,
+            Atmos::AccuracySweep::Map::IrradianceMap })
+        {
+            auto mapResults = std::vector<Atmos::AccuracySweep::Result>();
+            std::copy_if(results.begin(), results.end(), std::back_inserter(mapResults),
+                [&](Atmos::AccuracySweep::Result const& result) { return result.map == map; });
+            std::sort(mapResults.begin(), mapResults.end(),
+                [](Atmos::AccuracySweep::Result const& a, Atmos::AccuracySweep::Result const& b) { return a.seconds < b.seconds; });
+
+            std::cout << Atmos::AccuracySweep::GetMapName(map) << " (* on the Pareto frontier of time and RMS error)"
+                << std::endl;
+            std::cout << std::left << std::setw(40) << "  settings" << std::right << std::setw(12) << "ms"
+                << std::setw(14) << "evaluations" << std::setw(12) << "max abs" << std::setw(12) << "rms"
+                << std::setw(12) << "max rel" << std::endl;
+            for(auto const& result : mapResults)
+            {
+                std::cout << (result.paretoOptimal ? "* " : "  ") << std::left << std::setw(38) << result.name
+                    << std::right << std::setprecision(4)
+                    << std::setw(12) << result.seconds * 1e3 << std::setw(14) << result.evaluationCount
+                    << std::setprecision(3) << std::setw(12) << result.error.maxAbsolute << std::setw(12)
+                    << result.error.rms << std::setw(12) << result.error.maxRelative << std::endl;
+            }
+        }
+
+        // Bounds on the RMS error of the defaults, about 1.3 times what they measure for the planet. The maximum
+        // relative error is not bounded: it hinges on the probe of the scattering map that straddles the horizon,
+        // across which the scattering changes by orders of magnitude.
+        struct Bound final
+        {
+            Atmos::AccuracySweep::Map map;
+            std::string name;
+            double rms;
+        };
+        auto const mars = planet == "mars";
+        Bound const bounds[] = {
+            { Atmos::AccuracySweep::Map::TransmittanceTable, Describe(defaultTable), mars ? 3e-5 : 5.5e-5 },
+            { Atmos::AccuracySweep::Map::ScatteringMap, Describe(defaultScattering), mars ? 5.5e-5 : 5.5e-4 },
+            { Atmos::AccuracySweep::Map::IrradianceMap, Describe(defaultIrradiance), mars ? 5e-4 : 6e-4 },
+        };
+
+        auto passed = true;
+        for(auto const& bound : bounds)
+        {
+            auto const result = std::find_if(results.begin(), results.end(), [&](Atmos::AccuracySweep::Result const& r)
+            {
+                return r.map == bound.map && r.name == bound.name;
+            });
+            auto const error = result != results.end() ? result->error.rms : std::numeric_limits<double>::infinity();
+            passed = CheckBound(std::string(Atmos::AccuracySweep::GetMapName(bound.map)) + "/" + bound.name + " (rms)",
+                error, bound.rms) && passed;
+        }
+
+        // The reference moves by a few ulp between instruction sets, far below this bound.
+        auto const goldenProbes = GetGoldenProbes(planet);
+        auto goldenError = goldenProbes.empty() ? std::numeric_limits<double>::infinity() : 0.0;
+        for(auto const& probe : goldenProbes)
+        {
+            auto const value = sweep.GetReferenceProbes(probe.map)[probe.row][probe.column];
+            goldenError = std::max(goldenError, RelativeError(value, probe.value));
+        }
+        passed = CheckBound("Reference/" + planet + " (golden probes)", goldenError, 1e-3) && passed;
+        return passed;
+    }
+
+    auto ParseOptions(int const argc, char** const argv) -> Options
+    {
+        auto options = Options();
+        options.maxThreads = GetMaxThreads();
+
+        for(auto i = 1; i < argc; ++i)
+        {
+            auto const hasValue = i + 1 < argc;
+            if(std::strcmp(argv[i], "--quick") == 0)
+            {
+                options.quick = true;
+            }
+            else if(std::strcmp(argv[i], "--filter") == 0 && hasValue)
+            {
+                options.filter = argv[++i];
+            }
+            else if(std::strcmp(argv[i], "--repetitions") == 0 && hasValue)
+            {
+                options.repetitions = std::max(1, std::atoi(argv[++i]));
+            }
+            else if(std::strcmp(argv[i], "--threads") == 0 && hasValue)
+            {
+                options.maxThreads = std::max(1, std::atoi(argv[++i]));
+            }
+            else if(std::strcmp(argv[i], "--json") == 0 && hasValue)
+            {
+                options.jsonFileName = argv[++i];
+            }
+            else if(std::strcmp(argv[i], "--accuracy") == 0)
+            {
+                options.accuracy = true;
+            }
+            else if(std::strcmp(argv[i], "--planet") == 0 && hasValue)
+            {
+                options.planet = argv[++i];
+            }
+            else
+            {
+                std::cerr << "Unknown argument " << argv[i] << std::endl;
+            }
+        }
+
+        return options;
+    }
+}
+
+auto main(int argc, char** argv) -> int
+{
+    auto const options = ParseOptions(argc, argv);
+    auto suite = Suite(options);
+
+    std::cout << "Instruction set: " << Atmos::Simd::GetIsaName(Atmos::Simd::GetIsa()) << std::endl;
+
+    // The Earth defaults, with the transmittance table every scattering benchmark reads.
+    auto const pp = Atmos::PlanetProperties();
+    auto table = Atmos::TransmittanceTable(256, 64, pp,
+        { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+    table.Compute();
+
+    auto boundsPassed = CheckFastMath(pp, options.quick);
+    boundsPassed = CheckAnalyticTransmittance(options.quick) && boundsPassed;
+    boundsPassed = CheckKernels(options.quick) && boundsPassed;
+
+    if(options.accuracy)
+    {
+        auto const planet = GetPlanet(options.planet);
+        if(!planet)
+        {
+            std::cerr << "Unknown planet " << options.planet << std::endl;
+            return 1;
+        }
+
+        SetThreads(options.maxThreads);
+        auto const accuracyPassed = RunAccuracySweep(options.planet, *planet, options.quick);
+        return boundsPassed && accuracyPassed ? 0 : 1;
+    }
+
+    RunMicroBenchmarks(suite, table);
+    RunMapBenchmarks(suite, pp, table);
+
+    if(!options.jsonFileName.empty())
+    {
+        suite.WriteJson(options.jsonFileName);
+    }
+
+    return boundsPassed ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "TransmittanceTable.hpp"
+#include "ScatteringMap.hpp"
+#include "IrradianceMap.hpp"
+#include "ParameterSweep.hpp"
+#include "SkyRenderer.hpp"
+
+namespace Atmos
+{
+    // Measures what cheaper settings of the maps cost in accuracy. A reference of every map is baked once with many
+    // samples at a high resolution, then each candidate setting is baked, timed and compared with it at probes spread
+    // over the physical domain of the map, between the texels of either, so that settings of any resolution and
+    // parameterization are compared alike.
+    //
+    // The scattering and irradiance maps of a candidate read the reference transmittance table, so their error is
+    // their own and not that of a cheaper table.
+    class AccuracySweep final
+    {
+    public:
+        enum class Map
+        {
+            TransmittanceTable,
+            ScatteringMap,
+            IrradianceMap
+        };
+
+        // Settings of the maps to measure, those without a spec are not.
+        struct Candidate final
+        {
+            std::string name;
+            std::optional<ParameterSweep::TransmittanceTableSpec> transmittanceTable;
+            std::optional<ParameterSweep::ScatteringMapSpec> scatteringMap;
+            std::optional<ParameterSweep::IrradianceMapSpec> irradianceMap;
+        };
+
+        struct Result final
+        {
+            std::string name;
+            Map map = Map::TransmittanceTable;
+            // Wall time of making and computing the map.
+            double seconds = 0.0;
+            std::int64_t evaluationCount = 0;
+            SkyRenderer::Difference error;
+            // No other result of the same map is at least as fast and as accurate, and better in one of them. The
+            // RMS error is the accuracy compared, since the maximum errors hinge on a few probes near the horizon.
+            bool paretoOptimal = false;
+        };
+
+        // Probes per axis of the domain of each map, transmittance as zenith cosine x radius, single scattering as
+        // view x sun zenith cosine and irradiance as sun zenith cosine.
+        struct Probes final
+        {
+            int zenithCosCount = 255;
+            int radiusCount = 63;
+            int viewZenithCosCount = 255;
+            int sunZenithCosCount = 255;
+            int irradianceCount = 1023;
+        };
+
+        explicit AccuracySweep(PlanetProperties const& planetProperties, ParameterSweep::Specs const& reference)
+            : AccuracySweep(planetProperties, reference, Probes())
+        { }
+
+        explicit AccuracySweep(
+            PlanetProperties const& planetProperties,
+            ParameterSweep::Specs const& reference,
+            Probes const& probes)
+            : pp(planetProperties), reference(reference), probes(probes)
+        { }
+
+        // Bakes the reference maps and samples them at the probes. The reference needs no scattering or irradiance
+        // map spec for sweeps that leave out those maps.
+        auto ComputeReference() -> void
+        {
+            auto const start = std::chrono::steady_clock::now();
+
+            auto const& tableSpec = reference.transmittanceTable;
+            referenceTable.emplace(tableSpec.zenithCosResolution, tableSpec.radiusResolution, pp, tableSpec.params);
+            referenceTable->Compute();
+            referenceTransmittance = ProbeTransmittance(*referenceTable);
+
+            if(reference.scatteringMap)
+            {
+                referenceScattering = ProbeScattering(MakeScatteringMap(*reference.scatteringMap), *reference.scatteringMap);
+            }
+            if(reference.irradianceMap)
+            {
+                referenceIrradiance = ProbeIrradiance(MakeIrradianceMap(*reference.irradianceMap));
+            }
+
+            referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Bakes the maps of every candidate one after another, each over all threads, and marks the results on the
+        // Pareto frontier of their map. Results come in the order of the candidates, their maps in the order of Map.
+        [[nodiscard]]
+        auto Run(std::vector<Candidate> const& candidates) const -> std::vector<Result>
+        {
+            auto results = std::vector<Result>();
+            for(auto const& candidate : candidates)
+            {
+                if(candidate.transmittanceTable)
+                {
+                    auto const& spec = *candidate.transmittanceTable;
+                    auto result = MakeResult(candidate, Map::TransmittanceTable);
+                    auto const start = std::chrono::steady_clock::now();
+                    auto table = TransmittanceTable(spec.zenithCosResolution, spec.radiusResolution, pp, spec.params);
+                    table.Compute();
+                    Finish(result, start, table.GetEvaluationCount(), ProbeTransmittance(table), referenceTransmittance);
+                    results.push_back(result);
+                }
+                if(candidate.scatteringMap && reference.scatteringMap)
+                {
+                    auto const& spec = *candidate.scatteringMap;
+                    auto result = MakeResult(candidate, Map::ScatteringMap);
+                    auto const start = std::chrono::steady_clock::now();
+                    auto const map = MakeScatteringMap(spec);
+                    Finish(result, start, map.GetEvaluationCount(), ProbeScattering(map, spec), referenceScattering);
+                    results.push_back(result);
+                }
+                if(candidate.irradianceMap && reference.irradianceMap)
+                {
+                    auto result = MakeResult(candidate, Map::IrradianceMap);
+                    auto const start = std::chrono::steady_clock::now();
+                    auto const map = MakeIrradianceMap(*candidate.irradianceMap);
+                    Finish(result, start, map.GetEvaluationCount(), ProbeIrradiance(map), referenceIrradiance);
+                    results.push_back(result);
+                }
+            }
+
+            MarkParetoFrontier(results);
+            return results;
+        }
+
+        // Values of the reference at the probes of a map, row after row as the probe comment lists the axes. Empty for
+        // maps the reference has no spec for.
+        [[nodiscard]]
+        auto GetReferenceProbes(Map const map) const -> Texture2D<Vector3> const&
+        {
+            switch(map)
+            {
+            case Map::TransmittanceTable:
+                return referenceTransmittance;
+            case Map::ScatteringMap:
+                return referenceScattering;
+            case Map::IrradianceMap:
+                return referenceIrradiance;
+            }
+            return referenceTransmittance;
+        }
+
+        // Wall time of the last ComputeReference.
+        [[nodiscard]]
+        auto GetReferenceSeconds() const -> double
+        {
+            return referenceSeconds;
+        }
+
+        [[nodiscard]]
+        auto static GetMapName(Map const map) -> char const*
+        {
+            switch(map)
+            {
+            case Map::TransmittanceTable:
+                return "TransmittanceTable";
+            case Map::ScatteringMap:
+                return "ScatteringMap";
+            case Map::IrradianceMap:
+                return "IrradianceMap";
+            }
+            return "";
+        }
+
+    private:
+        PlanetProperties pp;
+        ParameterSweep::Specs reference;
+        Probes probes;
+        std::optional<TransmittanceTable> referenceTable;
+        Texture2D<Vector3> referenceTransmittance;
+        Texture2D<Vector3> referenceScattering;
+        Texture2D<Vector3> referenceIrradiance;
+        double referenceSeconds = 0.0;
+
+        [[nodiscard]]
+        auto MakeScatteringMap(ParameterSweep::ScatteringMapSpec const& spec) const -> ScatteringMap
+        {
+            auto map = ScatteringMap(spec.viewZenithCosResolution, spec.sunZenithCosResolution, *referenceTable,
+                spec.params);
+            map.Compute(spec.viewZenithMapping, spec.sunZenithMapping);
+            return map;
+        }
+
+        [[nodiscard]]
+        auto MakeIrradianceMap(ParameterSweep::IrradianceMapSpec const& spec) const -> IrradianceMap
+        {
+            auto map = IrradianceMap(spec.resolution, spec.samples, *referenceTable, spec.params);
+            map.Compute(spec.sampling);
+            return map;
+        }
+
+        // Transmittance of rays that leave the atmosphere without hitting the ground, the only ones the table holds.
+        [[nodiscard]]
+        auto ProbeTransmittance(TransmittanceTable const& table) const -> Texture2D<Vector3>
+        {
+            auto values = Texture2D<Vector3>(static_cast<std::size_t>(probes.zenithCosCount),
+                static_cast<std::size_t>(probes.radiusCount));
+            for(auto i = 0; i < probes.radiusCount; ++i)
+            {
+                auto const radius = pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * ProbeToUnit(i, probes.radiusCount);
+                auto const horizonRatio = pp.GetPlanetRadius() / radius;
+                auto const horizonCos = -std::sqrtf(std::max(0.0f, 1.0f - horizonRatio * horizonRatio));
+
+                for(auto j = 0; j < probes.zenithCosCount; ++j)
+                {
+                    auto const zenithCos = horizonCos + (1.0f - horizonCos) * ProbeToUnit(j, probes.zenithCosCount);
+                    values[i][j] = table.GetTransmittanceToAtmosphere(radius, zenithCos);
+                }
+            }
+            return values;
+        }
+
+        // Compute bakes texel i of an axis at its centre, (i + 0.5) / resolution, while Sample places it at
+        // i / (resolution - 1), so the mapped coordinates are moved onto the texel centres before sampling.
+        [[nodiscard]]
+        auto ProbeScattering(ScatteringMap const& map, ParameterSweep::ScatteringMapSpec const& spec) const
+            -> Texture2D<Vector3>
+        {
+            auto const& texture = map.GetTexture();
+            auto values = Texture2D<Vector3>(static_cast<std::size_t>(probes.viewZenithCosCount),
+                static_cast<std::size_t>(probes.sunZenithCosCount));
+            for(auto i = 0; i < probes.sunZenithCosCount; ++i)
+            {
+                auto const sunZenithCos = 1.0f - 2.0f * ProbeToUnit(i, probes.sunZenithCosCount);
+                auto const v = ToTexelCentres(ScatteringMap::SunZenithCosToV(spec.sunZenithMapping, sunZenithCos),
+                    texture.GetVResolution());
+
+                for(auto j = 0; j < probes.viewZenithCosCount; ++j)
+                {
+                    auto const viewZenithCos = -ProbeToUnit(j, probes.viewZenithCosCount);
+                    auto const u = ToTexelCentres(ScatteringMap::ViewZenithCosToU(spec.viewZenithMapping, viewZenithCos),
+                        texture.GetUResolution());
+                    values[i][j] = texture.Sample(u, v);
+                }
+            }
+            return values;
+        }
+
+        [[nodiscard]]
+        auto ProbeIrradiance(IrradianceMap const& map) const -> Texture2D<Vector3>
+        {
+            auto values = Texture2D<Vector3>(static_cast<std::size_t>(probes.irradianceCount), 1);
+            for(auto j = 0; j < probes.irradianceCount; ++j)
+            {
+                values[0][j] = map.GetIrradiance(1.0f - 2.0f * ProbeToUnit(j, probes.irradianceCount));
+            }
+            return values;
+        }
+
+        [[nodiscard]]
+        auto static MakeResult(Candidate const& candidate, Map const map) -> Result
+        {
+            return Result{ candidate.name, map, 0.0, 0, SkyRenderer::Difference(), false };
+        }
+
+        auto static Finish(
+            Result& result,
+            std::chrono::steady_clock::time_point const start,
+            std::int64_t const evaluationCount,
+            Texture2D<Vector3> const& values,
+            Texture2D<Vector3> const& referenceValues) -> void
+        {
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.evaluationCount = evaluationCount;
+            result.error = SkyRenderer::Compare(values, referenceValues);
+        }
+
+        auto static MarkParetoFrontier(std::vector<Result>& results) -> void
+        {
+            for(auto& result : results)
+            {
+                result.paretoOptimal = std::none_of(results.begin(), results.end(), [&](Result const& other)
+                {
+                    return other.map == result.map
+                        && other.seconds <= result.seconds
+                        && other.error.rms <= result.error.rms
+                        && (other.seconds < result.seconds || other.error.rms < result.error.rms);
+                });
+            }
+        }
+
+        // Coordinate of Sample at which a texture of the given resolution returns what Compute baked at unit.
+        [[nodiscard]]
+        auto static ToTexelCentres(float const unit, std::size_t const resolution) -> float
+        {
+            auto const texels = static_cast<float>(resolution);
+            return std::clamp((unit * texels - 0.5f) / (texels - 1.0f), 0.0f, 1.0f);
+        }
+
+        // Probe i of count sits at the middle of the i-th of count equal parts of [0, 1]. With linear mappings, a
+        // table whose resolution is a power of two never has a texel there.
+        [[nodiscard]]
+        auto static ProbeToUnit(int const index, int const count) -> float
+        {
+            return (static_cast<float>(index) + 0.5f) / static_cast<float>(count);
+        }
+    };
+}
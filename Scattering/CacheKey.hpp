@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "Vector3.hpp"
+#include "Spectrum.hpp"
+
+namespace Atmos
+{
+    // Stable 64-bit FNV-1a hash of everything a computed texture depends on. Values are fed byte by byte in a fixed
+    // little-endian order, so keys agree across compilers, runs and machines.
+    class CacheKey final
+    {
+        std::uint64_t value = 14695981039346656037ull;
+
+    public:
+        // Bump whenever a change to the computations alters the texels they produce, so stale cache entries are
+        // never returned.
+        std::uint32_t static constexpr CodeVersion = 6;
+
+        explicit CacheKey(char const* const name)
+        {
+            Add(name);
+            Add(CodeVersion);
+        }
+
+        template <typename T>
+        auto Add(T const value) -> CacheKey&
+        {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "Only numbers and enums are hashed directly.");
+
+            if constexpr(std::is_enum_v<T>)
+            {
+                return AddBits(static_cast<std::uint64_t>(value), 8);
+            }
+            else if constexpr(std::is_same_v<T, float>)
+            {
+                std::uint32_t bits;
+                std::memcpy(&bits, &value, sizeof bits);
+                return AddBits(bits, sizeof bits);
+            }
+            else if constexpr(std::is_same_v<T, double>)
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof bits);
+                return AddBits(bits, sizeof bits);
+            }
+            else
+            {
+                return AddBits(static_cast<std::uint64_t>(value), 8);
+            }
+        }
+
+        auto Add(Vector3 const& value) -> CacheKey&
+        {
+            return Add(value.x).Add(value.y).Add(value.z);
+        }
+
+        template <int N>
+        auto Add(Spectrum<N> const& value) -> CacheKey&
+        {
+            for(auto const sample : value.values)
+            {
+                Add(sample);
+            }
+            return *this;
+        }
+
+        // The terminating zero is hashed as well, so consecutive strings cannot run into each other.
+        auto Add(char const* const value) -> CacheKey&
+        {
+            for(auto c = value; ; ++c)
+            {
+                AddByte(static_cast<unsigned char>(*c));
+                if(*c == '\0')
+                {
+                    return *this;
+                }
+            }
+        }
+
+        auto Add(CacheKey const& key) -> CacheKey&
+        {
+            return Add(key.value);
+        }
+
+        [[nodiscard]]
+        auto GetValue() const -> std::uint64_t
+        {
+            return value;
+        }
+
+        // Sixteen lowercase hexadecimal digits, used as the file name of the entry.
+        [[nodiscard]]
+        auto ToString() const -> std::string
+        {
+            char const* const digits = "0123456789abcdef";
+
+            auto text = std::string(16, '0');
+            for(auto i = 0; i < 16; ++i)
+            {
+                text[15 - i] = digits[(value >> (4 * i)) & 0xf];
+            }
+            return text;
+        }
+
+    private:
+        auto AddBits(std::uint64_t const bits, std::size_t const byteCount) -> CacheKey&
+        {
+            for(std::size_t i = 0; i < byteCount; ++i)
+            {
+                AddByte(static_cast<unsigned char>(bits >> (8 * i)));
+            }
+            return *this;
+        }
+
+        auto AddByte(unsigned char const byte) -> void
+        {
+            value ^= byte;
+            value *= 1099511628211ull;
+        }
+    };
+}
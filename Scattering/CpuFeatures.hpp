@@ -0,0 +1,162 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace Atmos::Simd
+{
+    // Instruction sets the kernels are compiled for, in increasing order of width.
+    enum class Isa
+    {
+        Sse2,
+        Avx2,
+        Avx512
+    };
+
+    // What the processor and the operating system support, read once through CPUID and XGETBV. Features count as
+    // supported only if the operating system saves the registers they use.
+    class CpuFeatures final
+    {
+    public:
+        bool avx2 = false;
+        bool f16c = false;
+        bool avx512 = false;
+
+        [[nodiscard]]
+        static auto Get() -> CpuFeatures const&
+        {
+            static auto const features = Detect();
+            return features;
+        }
+
+        [[nodiscard]]
+        auto Supports(Isa const isa) const -> bool
+        {
+            switch(isa)
+            {
+            case Isa::Sse2:
+                return true;
+            case Isa::Avx2:
+                return avx2;
+            case Isa::Avx512:
+                return avx512;
+            }
+            return false;
+        }
+
+    private:
+        struct Registers final
+        {
+            std::uint32_t eax;
+            std::uint32_t ebx;
+            std::uint32_t ecx;
+            std::uint32_t edx;
+        };
+
+        [[nodiscard]]
+        static auto Detect() -> CpuFeatures
+        {
+            auto features = CpuFeatures();
+
+            if(Cpuid(0, 0).eax < 7)
+            {
+                return features;
+            }
+
+            auto const leaf1 = Cpuid(1, 0);
+            auto const leaf7 = Cpuid(7, 0);
+
+            auto const osxsave = (leaf1.ecx & (1u << 27)) != 0;
+            auto const xcr0 = osxsave ? GetXcr0() : 0;
+            auto const avxState = (xcr0 & 0x6) == 0x6;
+            auto const avx512State = (xcr0 & 0xe6) == 0xe6;
+
+            auto const avx = (leaf1.ecx & (1u << 28)) != 0;
+            features.avx2 = avxState && avx && (leaf7.ebx & (1u << 5)) != 0;
+            features.f16c = avxState && avx && (leaf1.ecx & (1u << 29)) != 0;
+            features.avx512 = avx512State && features.avx2 && (leaf7.ebx & (1u << 16)) != 0;
+
+            return features;
+        }
+
+        [[nodiscard]]
+        static auto Cpuid(std::uint32_t const leaf, std::uint32_t const subleaf) -> Registers
+        {
+#if defined(_MSC_VER)
+            int values[4];
+            __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+            return {
+                static_cast<std::uint32_t>(values[0]), static_cast<std::uint32_t>(values[1]),
+                static_cast<std::uint32_t>(values[2]), static_cast<std::uint32_t>(values[3])
+            };
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            auto registers = Registers();
+            __cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx, registers.edx);
+            return registers;
+#else
+            static_cast<void>(leaf);
+            static_cast<void>(subleaf);
+            return {};
+#endif
+        }
+
+        [[nodiscard]]
+        static auto GetXcr0() -> std::uint64_t
+        {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            std::uint32_t eax;
+            std::uint32_t edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#else
+            return 0;
+#endif
+        }
+    };
+
+    [[nodiscard]]
+    inline auto GetIsaName(Isa const isa) -> char const*
+    {
+        switch(isa)
+        {
+        case Isa::Sse2:
+            return "sse2";
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Avx512:
+            return "avx512";
+        }
+        return "";
+    }
+
+    // Value of the ATMOS_ISA environment variable, empty when it is not set.
+    [[nodiscard]]
+    inline auto GetIsaOverride() -> std::string
+    {
+#if defined(_MSC_VER)
+        char* value = nullptr;
+        std::size_t size = 0;
+        if(_dupenv_s(&value, &size, "ATMOS_ISA") != 0 || value == nullptr)
+        {
+            return {};
+        }
+
+        auto const text = std::string(value);
+        std::free(value);
+        return text;
+#else
+        auto const value = std::getenv("ATMOS_ISA");
+        return value ? std::string(value) : std::string();
+#endif
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Atmos
+{
+    enum class MathMode
+    {
+        // The standard library functions.
+        Exact,
+        // The lookup tables of FastMath, within the error bounds documented there.
+        Fast
+    };
+}
+
+// Lookup tables standing in for functions of the per-sample paths. Every table states the largest error against the
+// function it samples; the benchmark tool checks them.
+namespace Atmos::FastMath
+{
+    // Samples of a function at evenly spaced points of [first, last], read back with linear interpolation and clamped
+    // to the range. The error is below spacing^2 max|f''| / 8.
+    class LookupTable final
+    {
+        // One extra copy of the last sample so that the upper neighbour of the last interval needs no clamping.
+        std::vector<float> values;
+        float first = 0.0f;
+        float scale = 0.0f;
+        float lastIndex = 0.0f;
+
+    public:
+        LookupTable() = default;
+
+        template <typename Function>
+        LookupTable(std::size_t const size, float const first, float const last, Function const& function)
+            : values(size + 1), first(first), scale(static_cast<float>(size - 1) / (last - first)),
+            lastIndex(static_cast<float>(size - 1))
+        {
+            for(std::size_t i = 0; i < size; ++i)
+            {
+                auto const t = static_cast<double>(i) / static_cast<double>(size - 1);
+                values[i] = static_cast<float>(function(first + (last - first) * t));
+            }
+            values[size] = values[size - 1];
+        }
+
+        [[nodiscard]]
+        auto operator()(float const x) const -> float
+        {
+            auto const t = std::min(std::max((x - first) * scale, 0.0f), lastIndex);
+            auto const i = static_cast<std::size_t>(t);
+            auto const f = t - static_cast<float>(i);
+
+            return values[i] + (values[i + 1] - values[i]) * f;
+        }
+
+        // The same for every lane of a Simd pack, the two neighbours gathered lane by lane.
+        template <typename Pack>
+        [[nodiscard]]
+        auto operator()(Pack const& x) const -> Pack
+        {
+            auto const t = Min(Max((x - Pack(first)) * Pack(scale), Pack(0.0f)), Pack(lastIndex));
+            auto const i = Floor(t);
+
+            alignas(64) std::int32_t offsets[Pack::Width];
+            i.StoreInt32(offsets);
+            auto const lower = Pack::Gather(values.data(), offsets);
+            auto const upper = Pack::Gather(values.data() + 1, offsets);
+
+            return lower + (upper - lower) * (t - i);
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return values.empty() ? 0 : values.size() - 1;
+        }
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "Vector3.hpp"
+#include "SimdPack.hpp"
+
+namespace Atmos
+{
+    // IEEE 754 binary16 conversion, rounding to nearest even like the F16C instructions, which are used when the
+    // processor has them.
+    class Half final
+    {
+    public:
+        [[nodiscard]]
+        static auto FromFloat(float const value) -> std::uint16_t
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof bits);
+
+            auto const sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+            auto const exponent = static_cast<int>((bits >> 23) & 0xffu);
+            auto mantissa = bits & 0x7fffffu;
+
+            if(exponent == 0xff)
+            {
+                return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+            }
+
+            auto const halfExponent = exponent - 127 + 15;
+            if(halfExponent >= 0x1f)
+            {
+                return static_cast<std::uint16_t>(sign | 0x7c00u);
+            }
+
+            if(halfExponent <= 0)
+            {
+                if(halfExponent < -10)
+                {
+                    return sign;
+                }
+
+                mantissa |= 0x800000u;
+                auto const shift = static_cast<std::uint32_t>(14 - halfExponent);
+                return static_cast<std::uint16_t>(sign | RoundShift(mantissa, shift));
+            }
+
+            // A mantissa rounding up carries into the exponent, which also turns the largest values into infinity.
+            return static_cast<std::uint16_t>(sign
+                | RoundShift((static_cast<std::uint32_t>(halfExponent) << 23) | mantissa, 13));
+        }
+
+        // Four halves per texel, the fourth being zero, as stored by the binary exporter.
+        static auto FromVector3(Vector3 const* const texels, std::size_t const count, std::uint16_t* const halves) -> void
+        {
+#if defined(ATMOS_SIMD_F16C)
+            if(Simd::UseF16C())
+            {
+                FromVector3F16C(texels, count, halves);
+                return;
+            }
+#endif
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                halves[4 * i + 0] = FromFloat(texels[i].x);
+                halves[4 * i + 1] = FromFloat(texels[i].y);
+                halves[4 * i + 2] = FromFloat(texels[i].z);
+                halves[4 * i + 3] = 0;
+            }
+        }
+
+    private:
+#if defined(ATMOS_SIMD_F16C)
+        ATMOS_SIMD_TARGET("f16c")
+        static auto FromVector3F16C(Vector3 const* const texels, std::size_t const count, std::uint16_t* const halves)
+            -> void
+        {
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                auto const packed = _mm_cvtps_ph(_mm_set_ps(0.0f, texels[i].z, texels[i].y, texels[i].x), _MM_FROUND_TO_NEAREST_INT);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(halves + 4 * i), packed);
+            }
+        }
+#endif
+
+        [[nodiscard]]
+        static auto RoundShift(std::uint32_t const value, std::uint32_t const shift) -> std::uint32_t
+        {
+            auto const shifted = value >> shift;
+            auto const remainder = value & ((1u << shift) - 1u);
+            auto const halfway = 1u << (shift - 1u);
+
+            return remainder > halfway || (remainder == halfway && (shifted & 1u)) ? shifted + 1u : shifted;
+        }
+    };
+}
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include "Vector2.hpp"
-#include <random>
+#include "Quadrature.hpp"
 #include "Scattering.hpp"
+#include "TextureCache.hpp"
+#include "Scheduler.hpp"
 
 namespace Atmos
 {
@@ -13,39 +16,111 @@ namespace Atmos
         Texture1D<Vector3> tex;
         int semisphereSamples = 512;
 
-        Transmittance::IntegrationParameters tParams;
+        TransmittanceTable transmittanceTable;
         Scattering::IntegrationParams sParams;
+        std::int64_t evaluationCount = 0;
         
     public:
         explicit IrradianceMap(
             std::size_t const resolution,
             int samples,
-            PlanetProperties const& plantetProperties,
-            Transmittance::IntegrationParameters const& tParams,
+            TransmittanceTable const& transmittanceTable,
             Scattering::IntegrationParams const& sParams)
-            : tex(resolution), semisphereSamples(samples), pp(plantetProperties), tParams(tParams), sParams(sParams)
+            : pp(transmittanceTable.GetPlanetProperties()), tex(resolution), semisphereSamples(samples),
+            transmittanceTable(transmittanceTable), sParams(sParams)
         { }
         
-        auto Compute() -> void
+        enum class HemisphereSampling
         {
-            auto const dw = 2.0f * PI / static_cast<float>(semisphereSamples);
-            auto directions = GenerateSemisphereDirections(semisphereSamples);
+            // Gauss-Legendre in the squared zenith sine times midpoints in azimuth.
+            GaussProduct,
+            // First points of the Halton sequence in bases 2 and 3.
+            Halton
+        };
 
-            #pragma omp parallel for
-            for(auto i = 0; i < static_cast<int>(tex.GetUResolution()); ++i)
+        // Directions are cosine distributed, with squared zenith sine and azimuth as the integration variables, and
+        // the sum is scaled by 2 pi like the Monte Carlo estimator it replaces. The sun stays in the xy-plane, so only
+        // directions with z >= 0 are traced and their weights are doubled. Every (texel, block of directions) pair is
+        // its own work item.
+        auto Compute(HemisphereSampling const sampling = HemisphereSampling::GaussProduct) -> void
+        {
+            std::vector<Vector3> directions;
+            std::vector<float> weights;
+            GenerateSemisphereDirections(sampling, semisphereSamples, directions, weights);
+
+            auto const pathEnterPoint = GetPathEnterPoint();
+
+            auto pathExitPoints = std::vector<Vector3>(directions.size());
+            for(std::size_t k = 0; k < directions.size(); ++k)
+            {
+                pathExitPoints[k] = RayCircleIntersection(pathEnterPoint, directions[k], pp.GetAtmosphereRadius()).value();
+            }
+
+            auto const texelCount = static_cast<int>(tex.GetUResolution());
+            auto const directionCount = static_cast<int>(directions.size());
+            auto const blockSize = 4 * Simd::GetWidth();
+            auto const blockCount = (directionCount + blockSize - 1) / blockSize;
+
+            // Each work item sums its own block into its own entry, and the entries of a texel are added in a fixed order
+            // afterwards, so no two threads write the same cache line and the result does not depend on the schedule.
+            auto partialSums = std::vector<Vector3>(static_cast<std::size_t>(texelCount) * blockCount);
+
+            evaluationCount = Scheduler::ForEach(texelCount * blockCount, 1, [&](int const item)
             {
-                auto const u = tex.IndexToU(i);
-                    
-                auto const zenithCos = UToZenithCos(u);
-                auto const zenithSin = std::sinf(std::acosf(zenithCos));
-                auto const sunDir = Vector3(zenithSin, zenithCos, 0.0f);
+                auto const i = item / blockCount;
+                auto const first = (item % blockCount) * blockSize;
+                auto const count = std::min(blockSize, directionCount - first);
+
+                thread_local auto light = std::vector<Vector3>();
+                light.resize(count);
+                Scattering::GetPathScatteringPacket(pathEnterPoint, pathExitPoints.data() + first, count,
+                    GetSunDirection(i), transmittanceTable, sParams, light.data());
 
-                for(auto const& dir : directions)
+                auto sum = Vector3();
+                for(auto k = 0; k < count; ++k)
                 {
-                    auto const light = Calculate(dir, sunDir);
-                    tex[i] += light * dw;
+                    sum += light[k] * weights[first + k];
                 }
+                partialSums[item] = sum;
+            });
+
+            Scheduler::ForEach(texelCount, 64, [&](int const i)
+            {
+                auto irradiance = Vector3();
+                for(auto block = 0; block < blockCount; ++block)
+                {
+                    irradiance += partialSums[static_cast<std::size_t>(i) * blockCount + block];
+                }
+
+                tex[i] = irradiance;
+            });
+        }
+
+        // Reads the texture from the cache, or computes it and stores it there. Reports whether it was a hit, which
+        // leaves the evaluation count at zero.
+        auto Compute(TextureCache const& cache, HemisphereSampling const sampling = HemisphereSampling::GaussProduct) -> bool
+        {
+            auto const key = GetCacheKey(sampling);
+            if(cache.Load(key, tex))
+            {
+                evaluationCount = 0;
+                return true;
             }
+
+            Compute(sampling);
+            cache.Store(key, tex);
+            return false;
+        }
+
+        // Everything the texture depends on.
+        [[nodiscard]]
+        auto GetCacheKey(HemisphereSampling const sampling = HemisphereSampling::GaussProduct) const -> CacheKey
+        {
+            auto key = CacheKey("IrradianceMap");
+            key.Add(tex.GetUResolution()).Add(semisphereSamples).Add(sampling);
+            key.Add(transmittanceTable.GetCacheKey());
+            sParams.AddTo(key);
+            return key;
         }
 
         [[nodiscard]]
@@ -54,31 +129,81 @@ namespace Atmos
             return tex;
         }
 
-    private:
+        // Irradiance of the sky on a horizontal surface with the sun at the given zenith cosine, without the sun itself.
         [[nodiscard]]
-        auto GenerateSemisphereDirections(int const number) -> std::vector<Vector3>
+        auto GetIrradiance(float const sunZenithCos) const -> Vector3
         {
-            std::random_device rd;
-            std::mt19937 gen(rd());
-
-            auto result = std::vector<Vector3>();
-            result.reserve(number);
+            return tex.Sample(std::clamp(ZenithCosToU(sunZenithCos), 0.0f, 1.0f));
+        }
 
-            for(auto i = 0; i < number; ++i)
-            {
-                result.push_back(UniformSemispherePoint(gen));
-            }
+        // Density evaluations made by the last Compute, summed over all threads.
+        [[nodiscard]]
+        auto GetEvaluationCount() const -> std::int64_t
+        {
+            return evaluationCount;
+        }
 
-            return result;
+    private:
+        [[nodiscard]]
+        auto GetPathEnterPoint() const -> Vector3
+        {
+            return Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * 0.01f, 0.0f);
         }
 
         [[nodiscard]]
-        auto Calculate(Vector3 const& dir, Vector3 const& sunDir) const -> Vector3
+        auto GetSunDirection(int const index) const -> Vector3
         {
-            auto const pathEnterPoint = Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * 0.01f, 0.0f);
-            auto const pathExitPoint = RayCircleIntersection(pathEnterPoint, dir, pp.GetAtmosphereRadius()).value();
+            auto const zenithCos = UToZenithCos(tex.IndexToU(index));
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+            return Vector3(zenithSin, zenithCos, 0.0f);
+        }
+
+        // Half of the given number of samples is spent on the z >= 0 half of the hemisphere.
+        auto static GenerateSemisphereDirections(
+            HemisphereSampling const sampling,
+            int const number,
+            std::vector<Vector3>& directions,
+            std::vector<float>& weights) -> void
+        {
+            auto const halfNumber = std::max(1, number / 2);
+
+            directions.clear();
+            weights.clear();
+
+            switch(sampling)
+            {
+            case HemisphereSampling::GaussProduct:
+            {
+                auto const zenithCount = std::max(1, static_cast<int>(std::lround(std::sqrt(halfNumber / 2.0))));
+                auto const azimuthCount = std::max(1, halfNumber / zenithCount);
+
+                std::vector<float> nodes;
+                std::vector<float> nodeWeights;
+                Quadrature::GaussLegendre(zenithCount, nodes, nodeWeights);
 
-            return Scattering::GetPathScattering(pathEnterPoint, pathExitPoint, sunDir, pp, tParams, sParams);
+                for(auto i = 0; i < zenithCount; ++i)
+                {
+                    for(auto j = 0; j < azimuthCount; ++j)
+                    {
+                        auto const azimuth = PI * (static_cast<float>(j) + 0.5f) / static_cast<float>(azimuthCount);
+                        directions.push_back(SemispherePoint(nodes[i], azimuth));
+                        weights.push_back(2.0f * nodeWeights[i] * PI / static_cast<float>(azimuthCount));
+                    }
+                }
+                break;
+            }
+            case HemisphereSampling::Halton:
+            {
+                for(auto i = 0; i < halfNumber; ++i)
+                {
+                    auto const zenithSin2 = Quadrature::RadicalInverse(i + 1, 2);
+                    auto const azimuth = PI * Quadrature::RadicalInverse(i + 1, 3);
+                    directions.push_back(SemispherePoint(zenithSin2, azimuth));
+                    weights.push_back(2.0f * PI / static_cast<float>(halfNumber));
+                }
+                break;
+            }
+            }
         }
 
         [[nodiscard]]
@@ -92,19 +217,17 @@ namespace Atmos
         {
             return (1.0f - zenithCos) / 2.0f;
         }
-        
-        template <typename Engine>
-        auto static UniformSemispherePoint(Engine& engine) -> Vector3
+
+        [[nodiscard]]
+        auto static SemispherePoint(float const zenithSin2, float const azimuth) -> Vector3
         {
-            auto dis = std::uniform_real_distribution<float>(0.0f, 1.0f);
-            
-            auto azimuth = 2.0f * PI * dis(engine);
-            auto zenith = std::asinf(std::sqrtf(dis(engine)));
+            auto const zenithSin = std::sqrtf(zenithSin2);
+            auto const zenithCos = std::sqrtf(1.0f - zenithSin2);
 
             return {
-                std::sin(zenith) * std::cos(azimuth),
-                std::cos(zenith),
-                std::sin(zenith) * std::sin(azimuth)
+                zenithSin * std::cos(azimuth),
+                zenithCos,
+                zenithSin * std::sin(azimuth)
             };
         }
     };
@@ -0,0 +1,585 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Texture.hpp"
+#include "TextureSampler.hpp"
+#include "Quadrature.hpp"
+#include "TransmittanceTable.hpp"
+#include "Scattering.hpp"
+#include "TextureCache.hpp"
+#include "Scheduler.hpp"
+
+namespace Atmos
+{
+    // Scattering of every order, computed order by order in the manner of Bruneton's and Elek's precomputed
+    // atmospheres. Tables are indexed by radius, view zenith cosine and sun zenith cosine with the sun in the vertical
+    // plane of the view. Single scattering is stored without its phase functions, which are applied at lookup with
+    // the true angle between view and sun. Higher orders are stored with them and ignore the azimuth of the sun.
+    //
+    // Order n + 1 comes from order n in two steps. The scattering density is the light of order n arriving at a point
+    // from the whole sphere, scattered towards a direction. The radiance is that density integrated along the view
+    // ray. The ground is black, like in the rest of the tree.
+    class MultipleScattering final
+    {
+    public:
+        struct Parameters final
+        {
+            // Incoming directions of the sphere integral of the scattering density.
+            int sphereSampleCount = 128;
+            // Highest order computed, single scattering being the first.
+            int maxOrder = 8;
+            // Orders stop once the largest radiance an order adds drops below this fraction of the largest single
+            // scattering radiance.
+            float threshold = 1e-3f;
+
+            auto AddTo(CacheKey& key) const -> void
+            {
+                key.Add(sphereSampleCount).Add(maxOrder).Add(threshold);
+            }
+        };
+
+    private:
+        PlanetProperties pp;
+        TransmittanceTable transmittanceTable;
+        Scattering::IntegrationParams sParams;
+        Parameters params;
+
+        Texture3D<Vector3> rayleightSingle;
+        Texture3D<Vector3> mieSingle;
+        Texture3D<Vector3> multiple;
+
+        std::vector<float> orderContributions;
+        std::int64_t evaluationCount = 0;
+
+    public:
+        explicit MultipleScattering(
+            std::size_t const viewZenithCosResolution,
+            std::size_t const sunZenithCosResolution,
+            std::size_t const radiusResolution,
+            TransmittanceTable const& transmittanceTable,
+            Scattering::IntegrationParams const& sParams,
+            Parameters const& params)
+            : pp(transmittanceTable.GetPlanetProperties()), transmittanceTable(transmittanceTable), sParams(sParams),
+            params(params),
+            rayleightSingle(viewZenithCosResolution, sunZenithCosResolution, radiusResolution),
+            mieSingle(viewZenithCosResolution, sunZenithCosResolution, radiusResolution),
+            multiple(viewZenithCosResolution, sunZenithCosResolution, radiusResolution)
+        { }
+
+        auto Compute() -> void
+        {
+            evaluationCount = 0;
+            orderContributions.clear();
+
+            ForEachTexel([&](std::size_t const i, std::size_t const j, std::size_t const k,
+                float const radius, float const viewZenithCos, float const sunZenithCos)
+            {
+                Vector3 rayleight;
+                Vector3 mie;
+                IntegrateSingleScattering(radius, viewZenithCos, sunZenithCos, rayleight, mie);
+
+                rayleightSingle[k][j][i] = rayleight;
+                mieSingle[k][j][i] = mie;
+            });
+
+            auto const singleMaximum = GetSingleScatteringMaximum();
+            orderContributions.push_back(1.0f);
+
+            std::vector<Vector3> directions;
+            std::vector<float> weights;
+            GenerateSphereDirections(params.sphereSampleCount, directions, weights);
+
+            auto const makeTable = [&]
+            {
+                return Texture3D<Vector3>(multiple.GetUResolution(), multiple.GetVResolution(), multiple.GetWResolution());
+            };
+
+            multiple = makeTable();
+            auto previousOrder = makeTable();
+            auto density = makeTable();
+            auto order = makeTable();
+
+            for(auto n = 2; n <= params.maxOrder; ++n)
+            {
+                auto const firstOrder = n == 2;
+
+                ForEachTexel([&](std::size_t const i, std::size_t const j, std::size_t const k,
+                    float const radius, float const viewZenithCos, float const sunZenithCos)
+                {
+                    density[k][j][i] = GetScatteringDensity(firstOrder ? nullptr : &previousOrder, directions, weights,
+                        radius, viewZenithCos, sunZenithCos);
+                });
+
+                auto orderMaximum = 0.0f;
+                ForEachTexel([&](std::size_t const i, std::size_t const j, std::size_t const k,
+                    float const radius, float const viewZenithCos, float const sunZenithCos)
+                {
+                    order[k][j][i] = IntegrateScatteringDensity(density, radius, viewZenithCos, sunZenithCos);
+                });
+
+                for(std::size_t k = 0; k < order.GetWResolution(); ++k)
+                {
+                    for(std::size_t j = 0; j < order.GetVResolution(); ++j)
+                    {
+                        for(std::size_t i = 0; i < order.GetUResolution(); ++i)
+                        {
+                            auto const radiance = order[k][j][i];
+                            multiple[k][j][i] += radiance;
+                            orderMaximum = std::max({ orderMaximum, radiance.x, radiance.y, radiance.z });
+                        }
+                    }
+                }
+
+                orderContributions.push_back(singleMaximum > 0.0f ? orderMaximum / singleMaximum : 0.0f);
+                if(orderContributions.back() < params.threshold)
+                {
+                    break;
+                }
+
+                std::swap(previousOrder, order);
+            }
+        }
+
+        // Reads the three tables and the order contributions from the cache, or computes them and stores them there.
+        // Orders that were not computed are stored as -1. Reports whether all of them were hits, which leaves the
+        // evaluation count at zero.
+        auto Compute(TextureCache const& cache) -> bool
+        {
+            auto const key = GetCacheKey();
+            auto contributions = Texture1D<float>(static_cast<std::size_t>(params.maxOrder));
+            std::fill(contributions.data(), contributions.data() + contributions.GetUResolution(), -1.0f);
+
+            if(cache.Load(CacheKey(key).Add("rayleightSingle"), rayleightSingle)
+                && cache.Load(CacheKey(key).Add("mieSingle"), mieSingle)
+                && cache.Load(CacheKey(key).Add("multiple"), multiple)
+                && cache.Load(CacheKey(key).Add("orderContributions"), contributions))
+            {
+                orderContributions.assign(contributions.data(), contributions.data() + contributions.GetUResolution());
+                orderContributions.erase(std::find(orderContributions.begin(), orderContributions.end(), -1.0f),
+                    orderContributions.end());
+                evaluationCount = 0;
+                return true;
+            }
+
+            Compute();
+
+            std::copy(orderContributions.begin(), orderContributions.end(), contributions.data());
+            cache.Store(CacheKey(key).Add("rayleightSingle"), rayleightSingle);
+            cache.Store(CacheKey(key).Add("mieSingle"), mieSingle);
+            cache.Store(CacheKey(key).Add("multiple"), multiple);
+            cache.Store(CacheKey(key).Add("orderContributions"), contributions);
+            return false;
+        }
+
+        // Everything the tables depend on.
+        [[nodiscard]]
+        auto GetCacheKey() const -> CacheKey
+        {
+            auto key = CacheKey("MultipleScattering");
+            key.Add(multiple.GetUResolution()).Add(multiple.GetVResolution()).Add(multiple.GetWResolution());
+            key.Add(transmittanceTable.GetCacheKey());
+            sParams.AddTo(key);
+            params.AddTo(key);
+            return key;
+        }
+
+        // Radiance seen from the given radius along a direction with the given zenith cosine, with the sun at the
+        // given zenith cosine and viewSunCos between the view and the sun.
+        [[nodiscard]]
+        auto GetScattering(
+            float const radius,
+            float const viewZenithCos,
+            float const sunZenithCos,
+            float const viewSunCos) const -> Vector3
+        {
+            auto const u = ViewZenithCosToUnit(radius, viewZenithCos);
+            auto const v = SunZenithCosToUnit(sunZenithCos);
+            auto const w = RadiusToUnit(radius);
+
+            return rayleightSingle.Sample(u, v, w) * pp.RayleightPhaseCos(viewSunCos)
+                + mieSingle.Sample(u, v, w) * pp.MiePhaseCos(viewSunCos)
+                + multiple.Sample(u, v, w);
+        }
+
+        // Orders above the first only.
+        [[nodiscard]]
+        auto GetMultipleScattering(float const radius, float const viewZenithCos, float const sunZenithCos) const -> Vector3
+        {
+            return multiple.Sample(ViewZenithCosToUnit(radius, viewZenithCos), SunZenithCosToUnit(sunZenithCos),
+                RadiusToUnit(radius));
+        }
+
+        // GetScattering for count queries at once, for lighting code that makes many lookups. The queries are mapped
+        // to table coordinates with the parameterizations below and the three tables filtered by TextureSampler.
+        auto GetScattering(
+            std::size_t const count,
+            float const* const radii,
+            float const* const viewZenithCos,
+            float const* const sunZenithCos,
+            float const* const viewSunCos,
+            Vector3* const scattering) const -> void
+        {
+            float u[QueryBlockSize];
+            float v[QueryBlockSize];
+            float w[QueryBlockSize];
+            Vector3 rayleight[QueryBlockSize];
+            Vector3 mie[QueryBlockSize];
+            for(std::size_t first = 0; first < count; first += QueryBlockSize)
+            {
+                auto const blockCount = std::min(count - first, QueryBlockSize);
+                for(std::size_t i = 0; i < blockCount; ++i)
+                {
+                    u[i] = ViewZenithCosToUnit(radii[first + i], viewZenithCos[first + i]);
+                    v[i] = SunZenithCosToUnit(sunZenithCos[first + i]);
+                    w[i] = RadiusToUnit(radii[first + i]);
+                }
+
+                TextureSampler::Sample(rayleightSingle.GetView(), blockCount, u, v, w, rayleight);
+                TextureSampler::Sample(mieSingle.GetView(), blockCount, u, v, w, mie);
+                TextureSampler::Sample(multiple.GetView(), blockCount, u, v, w, scattering + first);
+
+                for(std::size_t i = 0; i < blockCount; ++i)
+                {
+                    scattering[first + i] = rayleight[i] * pp.RayleightPhaseCos(viewSunCos[first + i])
+                        + mie[i] * pp.MiePhaseCos(viewSunCos[first + i])
+                        + scattering[first + i];
+                }
+            }
+        }
+
+        [[nodiscard]]
+        auto GetRayleightSingleTexture() const -> Texture3D<Vector3> const&
+        {
+            return rayleightSingle;
+        }
+
+        [[nodiscard]]
+        auto GetMieSingleTexture() const -> Texture3D<Vector3> const&
+        {
+            return mieSingle;
+        }
+
+        [[nodiscard]]
+        auto GetMultipleTexture() const -> Texture3D<Vector3> const&
+        {
+            return multiple;
+        }
+
+        // Largest radiance added by every computed order relative to the largest single scattering radiance, the
+        // first entry being single scattering itself.
+        [[nodiscard]]
+        auto GetOrderContributions() const -> std::vector<float> const&
+        {
+            return orderContributions;
+        }
+
+        // Density evaluations made by the last Compute, summed over all threads.
+        [[nodiscard]]
+        auto GetEvaluationCount() const -> std::int64_t
+        {
+            return evaluationCount;
+        }
+
+        // The radius is mapped through the distance to the horizon, as in the transmittance table, and the sun zenith
+        // cosine linearly. The view zenith cosine is split at the horizon, rays that hit the ground taking the lower
+        // half, and each half is spaced quadratically away from it, where the radiance changes the fastest. Public so
+        // that callers sampling the textures themselves map their queries the way the tables were computed.
+
+        [[nodiscard]]
+        auto HorizonDistance(float const radius) const -> float
+        {
+            auto const planetRadius = pp.GetPlanetRadius();
+            return std::sqrtf(std::max(0.0f, radius * radius - planetRadius * planetRadius));
+        }
+
+        [[nodiscard]]
+        auto UnitToRadius(float const w) const -> float
+        {
+            auto const rho = HorizonDistance(pp.GetAtmosphereRadius()) * w;
+            return std::sqrtf(rho * rho + pp.GetPlanetRadius() * pp.GetPlanetRadius());
+        }
+
+        [[nodiscard]]
+        auto RadiusToUnit(float const radius) const -> float
+        {
+            return std::clamp(HorizonDistance(radius) / HorizonDistance(pp.GetAtmosphereRadius()), 0.0f, 1.0f);
+        }
+
+        [[nodiscard]]
+        auto HorizonZenithCos(float const radius) const -> float
+        {
+            auto const planetRadius = pp.GetPlanetRadius();
+            return -std::sqrtf(std::max(0.0f, 1.0f - planetRadius * planetRadius / (radius * radius)));
+        }
+
+        [[nodiscard]]
+        auto UnitToViewZenithCos(float const radius, float const u) const -> float
+        {
+            auto const horizonZenithCos = HorizonZenithCos(radius);
+            if(u < 0.5f)
+            {
+                auto const t = 1.0f - 2.0f * u;
+                return horizonZenithCos - (horizonZenithCos + 1.0f) * t * t;
+            }
+
+            auto const t = 2.0f * u - 1.0f;
+            return horizonZenithCos + (1.0f - horizonZenithCos) * t * t;
+        }
+
+        [[nodiscard]]
+        auto ViewZenithCosToUnit(float const radius, float const zenithCos) const -> float
+        {
+            auto const horizonZenithCos = HorizonZenithCos(radius);
+            if(transmittanceTable.RayIntersectsGround(radius, zenithCos))
+            {
+                auto const t = std::sqrtf(std::clamp((horizonZenithCos - zenithCos) / (horizonZenithCos + 1.0f), 0.0f, 1.0f));
+                return (1.0f - t) / 2.0f;
+            }
+
+            auto const t = std::sqrtf(std::clamp((zenithCos - horizonZenithCos) / (1.0f - horizonZenithCos), 0.0f, 1.0f));
+            return (1.0f + t) / 2.0f;
+        }
+
+        [[nodiscard]]
+        auto static UnitToSunZenithCos(float const v) -> float
+        {
+            return 2.0f * v - 1.0f;
+        }
+
+        [[nodiscard]]
+        auto static SunZenithCosToUnit(float const zenithCos) -> float
+        {
+            return std::clamp((zenithCos + 1.0f) / 2.0f, 0.0f, 1.0f);
+        }
+
+    private:
+        // Queries of the bulk GetScattering are mapped to table coordinates this many at a time.
+        static constexpr std::size_t QueryBlockSize = 256;
+
+        // Every table is computed in parallel, with tiles of view and sun zenith cosines at one altitude as work items.
+        template <typename Function>
+        auto ForEachTexel(Function const& function) -> void
+        {
+            auto const uResolution = multiple.GetUResolution();
+            auto const vResolution = multiple.GetVResolution();
+            auto const wResolution = multiple.GetWResolution();
+
+            evaluationCount += Scheduler::ForEachTile(static_cast<int>(uResolution), static_cast<int>(vResolution),
+                static_cast<int>(wResolution), 16, 4, 1, [&](Scheduler::Tile const& tile)
+            {
+                auto const k = static_cast<std::size_t>(tile.w0);
+                auto const radius = UnitToRadius(IndexToUnit(k, wResolution));
+
+                for(auto j = static_cast<std::size_t>(tile.v0); j < static_cast<std::size_t>(tile.v1); ++j)
+                {
+                    auto const sunZenithCos = UnitToSunZenithCos(IndexToUnit(j, vResolution));
+
+                    for(auto i = static_cast<std::size_t>(tile.u0); i < static_cast<std::size_t>(tile.u1); ++i)
+                    {
+                        function(i, j, k, radius, UnitToViewZenithCos(radius, IndexToUnit(i, uResolution)), sunZenithCos);
+                    }
+                }
+            });
+        }
+
+        // Rayleigh and Mie single scattering without the phase functions.
+        auto IntegrateSingleScattering(
+            float const radius,
+            float const viewZenithCos,
+            float const sunZenithCos,
+            Vector3& rayleight,
+            Vector3& mie) const -> void
+        {
+            auto const point = Vector3(0.0f, radius, 0.0f);
+            auto const sunDir = ZenithCosToDirection(sunZenithCos);
+            auto const path = ZenithCosToDirection(viewZenithCos) * DistanceToBoundary(radius, viewZenithCos);
+            auto const& nodes = GetNodes(point, point + path);
+
+            rayleight = Vector3();
+            mie = Vector3();
+            for(auto n = 0; n < nodes.count; ++n)
+            {
+                auto const pathPoint = point + path * nodes.positions[n];
+                auto const pointRadius = pathPoint.Length();
+                auto const pointSunZenithCos = Dot(pathPoint, sunDir) / pointRadius;
+
+                if(transmittanceTable.RayIntersectsGround(pointRadius, pointSunZenithCos))
+                {
+                    continue;
+                }
+
+                auto const transmittance = transmittanceTable.GetTransmittance(point, pathPoint)
+                    * transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, pointSunZenithCos) * nodes.weights[n];
+
+                rayleight += transmittance * pp.RayleightDensityRadius(pointRadius);
+                mie += transmittance * pp.MieDensityRadius(pointRadius);
+            }
+
+            Quadrature::EvaluationCount() += nodes.count;
+
+            auto const pathLength = path.Length();
+            rayleight = rayleight * pp.GetRayleightScatteringCoef() * pathLength;
+            mie = mie * pp.GetMieScatteringCoef() * pathLength;
+        }
+
+        // Light of the previous order arriving from the sphere of directions and scattered into the reversed view
+        // direction. Without a previous order table the single scattering tables are used with their phase functions.
+        [[nodiscard]]
+        auto GetScatteringDensity(
+            Texture3D<Vector3> const* const previousOrder,
+            std::vector<Vector3> const& directions,
+            std::vector<float> const& weights,
+            float const radius,
+            float const viewZenithCos,
+            float const sunZenithCos) const -> Vector3
+        {
+            auto const viewDir = ZenithCosToDirection(viewZenithCos);
+            auto const sunDir = ZenithCosToDirection(sunZenithCos);
+            auto const v = SunZenithCosToUnit(sunZenithCos);
+            auto const w = RadiusToUnit(radius);
+
+            auto rayleight = Vector3();
+            auto mie = Vector3();
+            for(std::size_t d = 0; d < directions.size(); ++d)
+            {
+                auto const& direction = directions[d];
+                auto const u = ViewZenithCosToUnit(radius, direction.y);
+
+                Vector3 incoming;
+                if(previousOrder)
+                {
+                    incoming = previousOrder->Sample(u, v, w);
+                }
+                else
+                {
+                    auto const incomingSunCos = Dot(direction, sunDir);
+                    incoming = rayleightSingle.Sample(u, v, w) * pp.RayleightPhaseCos(incomingSunCos)
+                        + mieSingle.Sample(u, v, w) * pp.MiePhaseCos(incomingSunCos);
+                }
+
+                auto const scatteringCos = Dot(viewDir, direction);
+                rayleight += incoming * (weights[d] * pp.RayleightPhaseCos(scatteringCos));
+                mie += incoming * (weights[d] * pp.MiePhaseCos(scatteringCos));
+            }
+
+            Quadrature::EvaluationCount() += 1;
+
+            return rayleight * pp.GetRayleightScatteringCoef() * pp.RayleightDensityRadius(radius)
+                + mie * pp.GetMieScatteringCoef() * pp.MieDensityRadius(radius);
+        }
+
+        [[nodiscard]]
+        auto IntegrateScatteringDensity(
+            Texture3D<Vector3> const& density,
+            float const radius,
+            float const viewZenithCos,
+            float const sunZenithCos) const -> Vector3
+        {
+            auto const point = Vector3(0.0f, radius, 0.0f);
+            auto const viewDir = ZenithCosToDirection(viewZenithCos);
+            auto const sunDir = ZenithCosToDirection(sunZenithCos);
+            auto const path = viewDir * DistanceToBoundary(radius, viewZenithCos);
+            auto const& nodes = GetNodes(point, point + path);
+
+            auto radiance = Vector3();
+            for(auto n = 0; n < nodes.count; ++n)
+            {
+                auto const pathPoint = point + path * nodes.positions[n];
+                auto const pointRadius = pathPoint.Length();
+                auto const pointDensity = density.Sample(
+                    ViewZenithCosToUnit(pointRadius, Dot(pathPoint, viewDir) / pointRadius),
+                    SunZenithCosToUnit(Dot(pathPoint, sunDir) / pointRadius),
+                    RadiusToUnit(pointRadius));
+
+                radiance += transmittanceTable.GetTransmittance(point, pathPoint) * pointDensity * nodes.weights[n];
+            }
+
+            return radiance * path.Length();
+        }
+
+        // Nodes of the rule of the integration parameters, the midpoint rule standing in for the adaptive one.
+        [[nodiscard]]
+        auto GetNodes(Vector3 const& a, Vector3 const& b) const -> Quadrature::Nodes const&
+        {
+            auto const rule = Quadrature::HasNodes(sParams.rule) ? sParams.rule : QuadratureRule::Midpoint;
+            return Quadrature::GetNodes(rule, sParams.sampleCount, a, b, pp);
+        }
+
+        [[nodiscard]]
+        auto GetSingleScatteringMaximum() const -> float
+        {
+            auto maximum = 0.0f;
+            for(std::size_t k = 0; k < multiple.GetWResolution(); ++k)
+            {
+                auto const radius = UnitToRadius(IndexToUnit(k, multiple.GetWResolution()));
+                for(std::size_t j = 0; j < multiple.GetVResolution(); ++j)
+                {
+                    auto const sunDir = ZenithCosToDirection(UnitToSunZenithCos(IndexToUnit(j, multiple.GetVResolution())));
+                    for(std::size_t i = 0; i < multiple.GetUResolution(); ++i)
+                    {
+                        auto const viewZenithCos = UnitToViewZenithCos(radius, IndexToUnit(i, multiple.GetUResolution()));
+                        auto const viewSunCos = Dot(ZenithCosToDirection(viewZenithCos), sunDir);
+                        auto const radiance = rayleightSingle[k][j][i] * pp.RayleightPhaseCos(viewSunCos)
+                            + mieSingle[k][j][i] * pp.MiePhaseCos(viewSunCos);
+                        maximum = std::max({ maximum, radiance.x, radiance.y, radiance.z });
+                    }
+                }
+            }
+            return maximum;
+        }
+
+        // Gauss-Legendre in the zenith cosine times midpoints in azimuth. View and sun stay in the xy-plane, so only
+        // directions with z >= 0 are used and their weights are doubled.
+        auto static GenerateSphereDirections(int const number, std::vector<Vector3>& directions, std::vector<float>& weights) -> void
+        {
+            auto const halfNumber = std::max(1, number / 2);
+            auto const zenithCount = std::max(1, static_cast<int>(std::lround(std::sqrt(halfNumber / 2.0))));
+            auto const azimuthCount = std::max(1, halfNumber / zenithCount);
+
+            std::vector<float> nodes;
+            std::vector<float> nodeWeights;
+            Quadrature::GaussLegendre(zenithCount, nodes, nodeWeights);
+
+            directions.clear();
+            weights.clear();
+            for(auto i = 0; i < zenithCount; ++i)
+            {
+                auto const zenithCos = 2.0f * nodes[i] - 1.0f;
+                auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+
+                for(auto j = 0; j < azimuthCount; ++j)
+                {
+                    auto const azimuth = PI * (static_cast<float>(j) + 0.5f) / static_cast<float>(azimuthCount);
+                    directions.emplace_back(zenithSin * std::cos(azimuth), zenithCos, zenithSin * std::sin(azimuth));
+                    weights.push_back(2.0f * nodeWeights[i] * 2.0f * PI / static_cast<float>(azimuthCount));
+                }
+            }
+        }
+
+        [[nodiscard]]
+        auto DistanceToBoundary(float const radius, float const zenithCos) const -> float
+        {
+            auto const intersectsGround = transmittanceTable.RayIntersectsGround(radius, zenithCos);
+            auto const boundaryRadius = intersectsGround ? pp.GetPlanetRadius() : pp.GetAtmosphereRadius();
+            auto const d = radius * radius * (zenithCos * zenithCos - 1.0f) + boundaryRadius * boundaryRadius;
+            auto const root = std::sqrtf(std::max(0.0f, d));
+
+            return std::max(0.0f, intersectsGround ? -radius * zenithCos - root : -radius * zenithCos + root);
+        }
+
+        [[nodiscard]]
+        auto static ZenithCosToDirection(float const zenithCos) -> Vector3
+        {
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+            return Vector3(zenithSin, zenithCos, 0.0f);
+        }
+
+        // Texture3D::Sample places texel i at i / (resolution - 1), so texels are computed at the same coordinates.
+        [[nodiscard]]
+        auto static IndexToUnit(std::size_t const index, std::size_t const resolution) -> float
+        {
+            return static_cast<float>(index) / static_cast<float>(resolution - 1);
+        }
+    };
+}
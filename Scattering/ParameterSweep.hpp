@@ -0,0 +1,213 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include "TransmittanceTable.hpp"
+#include "ScatteringMap.hpp"
+#include "IrradianceMap.hpp"
+#include "TextureCache.hpp"
+
+namespace Atmos
+{
+    // Bakes the same maps for many atmospheres in one process. Work is scheduled in two stages, the transmittance
+    // tables and then every (variant, map) pair, since the maps of a variant read its table. Quadrature nodes are
+    // cached per thread and shared by all variants, and with a TextureCache only the variants that changed are
+    // computed again.
+    class ParameterSweep final
+    {
+    public:
+        struct Variant final
+        {
+            std::string name;
+            PlanetProperties planetProperties;
+        };
+
+        struct TransmittanceTableSpec final
+        {
+            std::size_t zenithCosResolution = 256;
+            std::size_t radiusResolution = 64;
+            Transmittance::IntegrationParameters params = {
+                32, Transmittance::Method::Numeric, Kernel::Packet, QuadratureRule::GaussLegendre
+            };
+        };
+
+        struct ScatteringMapSpec final
+        {
+            std::size_t viewZenithCosResolution = 512;
+            std::size_t sunZenithCosResolution = 512;
+            // Cubic costs no more than Linear and spends more texels on the horizon, where the scattering changes most.
+            ScatteringMap::Mapping viewZenithMapping = ScatteringMap::Mapping::Cubic;
+            ScatteringMap::Mapping sunZenithMapping = ScatteringMap::Mapping::Linear;
+            Scattering::IntegrationParams params = { 64, Kernel::Packet, QuadratureRule::AltitudeAdapted };
+        };
+
+        struct IrradianceMapSpec final
+        {
+            std::size_t resolution = 512;
+            int samples = 128;
+            IrradianceMap::HemisphereSampling sampling = IrradianceMap::HemisphereSampling::GaussProduct;
+            Scattering::IntegrationParams params = { 32, Kernel::Packet, QuadratureRule::GaussLegendre };
+        };
+
+        // Maps without a spec are skipped, the transmittance table is always computed.
+        struct Specs final
+        {
+            TransmittanceTableSpec transmittanceTable;
+            std::optional<ScatteringMapSpec> scatteringMap = ScatteringMapSpec();
+            std::optional<IrradianceMapSpec> irradianceMap = IrradianceMapSpec();
+        };
+
+        struct Result final
+        {
+            std::string name;
+            TransmittanceTable transmittanceTable;
+            std::optional<ScatteringMap> scatteringMap;
+            std::optional<IrradianceMap> irradianceMap;
+            // Density evaluations of all maps of the variant, zero for those read from the cache.
+            std::int64_t evaluationCount = 0;
+            int cacheHits = 0;
+        };
+
+        explicit ParameterSweep(Specs const& specs, TextureCache const* const cache = nullptr)
+            : specs(specs), cache(cache)
+        { }
+
+        auto Run(std::vector<Variant> const& variants) -> std::vector<Result>
+        {
+            auto const start = std::chrono::steady_clock::now();
+            auto const variantCount = static_cast<int>(variants.size());
+
+            auto results = std::vector<Result>();
+            results.reserve(variants.size());
+            for(auto const& variant : variants)
+            {
+                auto const& spec = specs.transmittanceTable;
+                results.push_back(Result{
+                    variant.name,
+                    TransmittanceTable(spec.zenithCosResolution, spec.radiusResolution, variant.planetProperties,
+                        spec.params),
+                    std::nullopt,
+                    std::nullopt,
+                    0,
+                    0 });
+            }
+
+            auto tableHits = std::vector<std::uint8_t>(variants.size());
+            RunItems(variantCount, [&](int const item)
+            {
+                tableHits[item] = ComputeMap(results[item].transmittanceTable);
+            });
+
+            for(auto& result : results)
+            {
+                if(specs.scatteringMap)
+                {
+                    auto const& spec = *specs.scatteringMap;
+                    result.scatteringMap.emplace(spec.viewZenithCosResolution, spec.sunZenithCosResolution,
+                        result.transmittanceTable, spec.params);
+                }
+                if(specs.irradianceMap)
+                {
+                    auto const& spec = *specs.irradianceMap;
+                    result.irradianceMap.emplace(spec.resolution, spec.samples, result.transmittanceTable, spec.params);
+                }
+            }
+
+            // Item 2 v is the scattering map of variant v and item 2 v + 1 its irradiance map.
+            auto mapHits = std::vector<std::uint8_t>(2 * variants.size());
+            RunItems(2 * variantCount, [&](int const item)
+            {
+                auto& result = results[item / 2];
+                if(item % 2 == 0 && result.scatteringMap)
+                {
+                    auto const& spec = *specs.scatteringMap;
+                    mapHits[item] = ComputeMap(*result.scatteringMap, spec.viewZenithMapping, spec.sunZenithMapping);
+                }
+                else if(item % 2 == 1 && result.irradianceMap)
+                {
+                    mapHits[item] = ComputeMap(*result.irradianceMap, specs.irradianceMap->sampling);
+                }
+            });
+
+            auto const mapCount = 1 + (specs.scatteringMap ? 1 : 0) + (specs.irradianceMap ? 1 : 0);
+            auto computedVariantCount = 0;
+            for(std::size_t v = 0; v < results.size(); ++v)
+            {
+                auto& result = results[v];
+                result.evaluationCount = result.transmittanceTable.GetEvaluationCount()
+                    + (result.scatteringMap ? result.scatteringMap->GetEvaluationCount() : 0)
+                    + (result.irradianceMap ? result.irradianceMap->GetEvaluationCount() : 0);
+                result.cacheHits = tableHits[v] + mapHits[2 * v] + mapHits[2 * v + 1];
+                computedVariantCount += result.cacheHits < mapCount ? 1 : 0;
+            }
+
+            elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            lastComputedVariantCount = computedVariantCount;
+
+            return results;
+        }
+
+        // Wall time of the last Run.
+        [[nodiscard]]
+        auto GetElapsedSeconds() const -> double
+        {
+            return elapsedSeconds;
+        }
+
+        // Variants of the last Run with at least one map computed rather than read from the cache, per hour of its
+        // wall time. Zero when every map was a cache hit.
+        [[nodiscard]]
+        auto GetComputedVariantsPerHour() const -> double
+        {
+            return elapsedSeconds > 0.0 ? 3600.0 * lastComputedVariantCount / elapsedSeconds : 0.0;
+        }
+
+    private:
+        Specs specs;
+        TextureCache const* cache;
+        double elapsedSeconds = 0.0;
+        int lastComputedVariantCount = 0;
+
+        // Computes through the cache when there is one and reports a hit.
+        template <typename Map, typename... Args>
+        auto ComputeMap(Map& map, Args const&... args) const -> bool
+        {
+            if(cache)
+            {
+                return map.Compute(*cache, args...);
+            }
+
+            map.Compute(args...);
+            return false;
+        }
+
+        // With at least as many items as threads the items run side by side, each computing its texels on the one
+        // thread it got since the parallel loops of the maps do not nest. Fewer items run one after another with
+        // their texels spread over all threads.
+        template <typename Function>
+        auto static RunItems(int const count, Function const& function) -> void
+        {
+#if defined(_OPENMP)
+            if(count >= omp_get_max_threads())
+            {
+                #pragma omp parallel for schedule(dynamic)
+                for(auto item = 0; item < count; ++item)
+                {
+                    function(item);
+                }
+                return;
+            }
+#endif
+            for(auto item = 0; item < count; ++item)
+            {
+                function(item);
+            }
+        }
+    };
+}
@@ -1,33 +1,106 @@
 #pragma once
+#include <memory>
+#include <type_traits>
 #include "Vector3.hpp"
 #include "Vector2.hpp"
+#include "Spectrum.hpp"
+#include "CacheKey.hpp"
+#include "FastMath.hpp"
+#include "SimdPack.hpp"
 
 
 namespace Atmos
 {
-    class PlanetProperties final
+    // Color is the type of the coefficients, the RGB Vector3 or a Spectrum. The RGB channels are samples at 680, 550
+    // and 440 nm.
+    template <typename Color>
+    class BasicPlanetProperties final
     {
     private:
         // Default Earth parameters
         float planetRadius = 6360.0f;
         float atmosphereHeight = 100.0f;
 
-        Vector3 rayleightScatteringCoef = Vector3(0.0058f, 0.0135f, 0.0331f);
-        Vector3 rayleightExtinctionCoef = Vector3(0.0058f, 0.0135f, 0.0331f);
+        Color rayleightScatteringCoef = FromRgb(Vector3(0.0058f, 0.0135f, 0.0331f));
+        Color rayleightExtinctionCoef = FromRgb(Vector3(0.0058f, 0.0135f, 0.0331f));
     
         
-        Vector3 mieScatteringCoef = Vector3(0.004f, 0.004f, 0.004f);
-        Vector3 mieExtinctionCoef = Vector3(0.004f, 0.004f, 0.004f) / 0.9f;
+        Color mieScatteringCoef = FromRgb(Vector3(0.004f, 0.004f, 0.004f));
+        Color mieExtinctionCoef = FromRgb(Vector3(0.004f, 0.004f, 0.004f) / 0.9f);
 
         float rayleightScaleHeight = 8.0f;
         float mieScaleHeight = 1.2f;
         
         float miePhaseG = 0.8f;
 
+        // Densities over the radius from the ground to the top of the atmosphere, relative error below
+        // (spacing / scale height)^2 / 8 plus 1e-5 for the rounding of the index, 6e-5 for the Earth's Mie layer.
+        struct Tables final
+        {
+            static constexpr std::size_t DensitySize = 4096;
+
+            FastMath::LookupTable rayleightDensity;
+            FastMath::LookupTable mieDensity;
+        };
+
+        MathMode mathMode = MathMode::Exact;
+        // Built for MathMode::Fast only, and shared between copies.
+        std::shared_ptr<Tables const> tables;
+
     public:
+        BasicPlanetProperties() = default;
+
+        // The spectral counterpart of RGB properties, the coefficients passing through Spectrum::FromRgb.
+        template <typename Rgb = Color, typename = std::enable_if_t<!std::is_same_v<Rgb, Vector3>>>
+        explicit BasicPlanetProperties(BasicPlanetProperties<Vector3> const& rgb)
+            : planetRadius(rgb.GetPlanetRadius()), atmosphereHeight(rgb.GetAtmosphereHeight()),
+            rayleightScatteringCoef(FromRgb(rgb.GetRayleightScatteringCoef())),
+            rayleightExtinctionCoef(FromRgb(rgb.GetRayleightExtinctionCoef())),
+            mieScatteringCoef(FromRgb(rgb.GetMieScatteringCoef())), mieExtinctionCoef(FromRgb(rgb.GetMieExtinctionCoef())),
+            rayleightScaleHeight(rgb.GetRayleightScaleHeight()), mieScaleHeight(rgb.GetMieScaleHeight()),
+            miePhaseG(rgb.GetMieAsymmetryCoef()), mathMode(rgb.GetMathMode())
+        {
+            UpdateTables();
+        }
+
+        auto AddTo(CacheKey& key) const -> void
+        {
+            key.Add(planetRadius).Add(atmosphereHeight);
+            key.Add(rayleightScatteringCoef).Add(rayleightExtinctionCoef);
+            key.Add(mieScatteringCoef).Add(mieExtinctionCoef);
+            key.Add(rayleightScaleHeight).Add(mieScaleHeight).Add(miePhaseG);
+            key.Add(mathMode);
+        }
+
+        // All but the scattering coefficients and the Mie asymmetry, which shape the light scattered towards the viewer
+        // but not the medium it crosses.
+        auto AddMediumTo(CacheKey& key) const -> void
+        {
+            key.Add(planetRadius).Add(atmosphereHeight);
+            key.Add(rayleightExtinctionCoef).Add(mieExtinctionCoef);
+            key.Add(rayleightScaleHeight).Add(mieScaleHeight);
+            key.Add(mathMode);
+        }
+
+        // Fast replaces the exponentials of the densities with lookup tables over the radius, in every kernel. The phase
+        // functions are already free of them. Only the scalar paths gain speed: the vectorized kernels gather the two
+        // neighbours of every lane, which costs about as much as Simd::Exp.
+        auto SetMathMode(MathMode const mode) -> void
+        {
+            mathMode = mode;
+            UpdateTables();
+        }
+
+        [[nodiscard]]
+        auto GetMathMode() const -> MathMode
+        {
+            return mathMode;
+        }
+
         auto SetPlanetRadius(float const radius) -> void
         {
             planetRadius = radius;
+            UpdateTables();
         }
 
         [[nodiscard]]
@@ -39,6 +112,7 @@ namespace Atmos
         auto SetAtmosphereHeight(float const height) -> void
         {
             atmosphereHeight = height;
+            UpdateTables();
         }
         
         [[nodiscard]]
@@ -53,47 +127,47 @@ namespace Atmos
             return planetRadius + atmosphereHeight;
         }
 
-        auto SetRayleightScatteringCoef(Vector3 const& scatteringCoef) -> void
+        auto SetRayleightScatteringCoef(Color const& scatteringCoef) -> void
         {
             rayleightScatteringCoef = scatteringCoef;
         }
         
         [[nodiscard]]
-        auto GetRayleightScatteringCoef() const -> Vector3 const&
+        auto GetRayleightScatteringCoef() const -> Color const&
         {
             return rayleightScatteringCoef;
         }
 
-        auto SetRayleightExtinctionCoef(Vector3 const& extinctionCoef) -> void
+        auto SetRayleightExtinctionCoef(Color const& extinctionCoef) -> void
         {
             rayleightExtinctionCoef = extinctionCoef;
         }
         
         [[nodiscard]]
-        auto GetRayleightExtinctionCoef() const -> Vector3 const&
+        auto GetRayleightExtinctionCoef() const -> Color const&
         {
             return rayleightExtinctionCoef;
         }
 
 
-        auto SetMieScatteringCoef(Vector3 const& scatteringCoef) -> void
+        auto SetMieScatteringCoef(Color const& scatteringCoef) -> void
         {
             mieScatteringCoef = scatteringCoef;
         }
 
         [[nodiscard]]
-        auto GetMieScatteringCoef() const -> Vector3 const&
+        auto GetMieScatteringCoef() const -> Color const&
         {
             return mieScatteringCoef;
         }
 
-        auto SetMieExtinctionCoef(Vector3 const& extinctionCoef) -> void
+        auto SetMieExtinctionCoef(Color const& extinctionCoef) -> void
         {
             mieExtinctionCoef = extinctionCoef;
         }
 
         [[nodiscard]]
-        auto GetMieExtinctionCoef() const -> Vector3 const&
+        auto GetMieExtinctionCoef() const -> Color const&
         {
             return mieExtinctionCoef;
         }
@@ -102,6 +176,7 @@ namespace Atmos
         auto SetRayleightScaleHeight(float const value) -> void
         {
             rayleightScaleHeight = value;
+            UpdateTables();
         }
         
         [[nodiscard]]
@@ -113,6 +188,7 @@ namespace Atmos
         auto SetMieScaleHeight(float const value) -> void
         {
             mieScaleHeight = value;
+            UpdateTables();
         }
 
         [[nodiscard]]
@@ -138,10 +214,15 @@ namespace Atmos
             return std::expf(-altitude / rayleightScaleHeight);
         }
 
+        // With MathMode::Fast the radius is clamped to the atmosphere.
         [[nodiscard]]
         auto RayleightDensityRadius(float const radius) const -> float
         {
-            return  RayleightDensityAltitude(radius - planetRadius);
+            if(tables)
+            {
+                return tables->rayleightDensity(radius);
+            }
+            return RayleightDensityAltitude(radius - planetRadius);
         }
 
 
@@ -154,9 +235,36 @@ namespace Atmos
         [[nodiscard]]
         auto MieDensityRadius(float const radius) const -> float
         {
+            if(tables)
+            {
+                return tables->mieDensity(radius);
+            }
             return MieDensityAltitude(radius - planetRadius);
         }
 
+        // The densities at the radii in the lanes of a Simd pack, for the vectorized kernels.
+        template <typename Pack>
+        [[nodiscard]]
+        auto RayleightDensityRadius(Pack const& radius) const -> Pack
+        {
+            if(tables)
+            {
+                return tables->rayleightDensity(radius);
+            }
+            return Simd::Exp((radius - Pack(planetRadius)) * Pack(-1.0f / rayleightScaleHeight));
+        }
+
+        template <typename Pack>
+        [[nodiscard]]
+        auto MieDensityRadius(Pack const& radius) const -> Pack
+        {
+            if(tables)
+            {
+                return tables->mieDensity(radius);
+            }
+            return Simd::Exp((radius - Pack(planetRadius)) * Pack(-1.0f / mieScaleHeight));
+        }
+
 
         [[nodiscard]]
         auto RayleightPhase(float const angle) const -> float
@@ -174,16 +282,56 @@ namespace Atmos
         [[nodiscard]]
         auto MiePhase(float const angle) const -> float
         {
-            auto const g2 = miePhaseG * miePhaseG;
-            auto const cos = std::cosf(angle);
-            return 3.0f / 8.0f / PI * (1.0f - g2) * (1.0f + cos * cos) / (2.0f + g2) / std::powf(1.0f + g2 - 2.0f * miePhaseG * cos, 1.5f);
+            return MiePhaseCos(std::cosf(angle));
         }
 
+        // The power of 1.5 as a product with the square root, which is exact and cheaper than std::powf or a lookup
+        // table.
         [[nodiscard]]
         auto MiePhaseCos(float const cos) const -> float
         {
             auto const g2 = miePhaseG * miePhaseG;
-            return 3.0f / 8.0f / PI * (1.0f - g2) * (1.0f + cos * cos) / (2.0f + g2) / std::powf(1.0f + g2 - 2.0f * miePhaseG * cos, 1.5f);
+            auto const denominator = 1.0f + g2 - 2.0f * miePhaseG * cos;
+            return 3.0f / 8.0f / PI * (1.0f - g2) * (1.0f + cos * cos) / (2.0f + g2) / (denominator * std::sqrtf(denominator));
+        }
+
+    private:
+        [[nodiscard]]
+        static auto FromRgb(Vector3 const& rgb) -> Color
+        {
+            if constexpr(std::is_same_v<Color, Vector3>)
+            {
+                return rgb;
+            }
+            else
+            {
+                return Color::FromRgb(rgb);
+            }
+        }
+
+        // The tables are sampled in double precision.
+        auto UpdateTables() -> void
+        {
+            if(mathMode != MathMode::Fast)
+            {
+                tables.reset();
+                return;
+            }
+
+            auto const rayleightExponent = -1.0 / rayleightScaleHeight;
+            auto const mieExponent = -1.0 / mieScaleHeight;
+
+            auto updated = std::make_shared<Tables>();
+            updated->rayleightDensity = FastMath::LookupTable(Tables::DensitySize, planetRadius, GetAtmosphereRadius(),
+                [&](double const radius) { return std::exp((radius - planetRadius) * rayleightExponent); });
+            updated->mieDensity = FastMath::LookupTable(Tables::DensitySize, planetRadius, GetAtmosphereRadius(),
+                [&](double const radius) { return std::exp((radius - planetRadius) * mieExponent); });
+            tables = std::move(updated);
         }
     };
+
+    using PlanetProperties = BasicPlanetProperties<Vector3>;
+
+    template <int N>
+    using SpectralPlanetProperties = BasicPlanetProperties<Spectrum<N>>;
 }
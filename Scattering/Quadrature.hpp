@@ -0,0 +1,410 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "Vector3.hpp"
+#include "PlanetProperties.hpp"
+
+namespace Atmos
+{
+    enum class QuadratureRule
+    {
+        // Uniform steps sampled at their centres.
+        Midpoint,
+        // Composite Simpson rule on an odd number of points including both ends.
+        Simpson,
+        // Gauss-Legendre rule over the whole path.
+        GaussLegendre,
+        // Midpoints in a variable that follows the Rayleigh density along the path, so that every step holds about
+        // the same amount of air and steps are short close to the ground.
+        AltitudeAdapted,
+        // Adaptive Simpson subdivision until the estimated relative error drops below the tolerance, with sampleCount
+        // as the budget of evaluations.
+        Adaptive
+    };
+
+    class Quadrature final
+    {
+    public:
+        // Nodes as increasing fractions of the path and their weights in the integral over [0, 1]. Both arrays are
+        // padded with zero weights up to a multiple of the widest pack, so they can be loaded a pack at a time.
+        struct Nodes final
+        {
+            std::vector<float> positions;
+            std::vector<float> weights;
+            int count = 0;
+        };
+
+        static constexpr int Padding = 16;
+
+        // The rule has the same nodes on every path.
+        [[nodiscard]]
+        static auto IsPathIndependent(QuadratureRule const rule) -> bool
+        {
+            return rule == QuadratureRule::Midpoint || rule == QuadratureRule::Simpson || rule == QuadratureRule::GaussLegendre;
+        }
+
+        // The rule can be expressed as a list of nodes, which all rules except the adaptive one can.
+        [[nodiscard]]
+        static auto HasNodes(QuadratureRule const rule) -> bool
+        {
+            return rule != QuadratureRule::Adaptive;
+        }
+
+        // Density evaluations made by the integrators on the calling thread. Maps sum the difference over their
+        // work items to report how many samples a compute actually took.
+        [[nodiscard]]
+        static auto EvaluationCount() -> std::int64_t&
+        {
+            thread_local std::int64_t count = 0;
+            return count;
+        }
+
+        // Nodes of the rule on the path from a to b. Path independent rules are cached per thread, the altitude
+        // adapted rule is rebuilt in a per thread buffer that stays valid until the next call.
+        [[nodiscard]]
+        static auto GetNodes(
+            QuadratureRule const rule,
+            int const sampleCount,
+            Vector3 const& a,
+            Vector3 const& b,
+            PlanetProperties const& pp) -> Nodes const&
+        {
+            if(rule == QuadratureRule::AltitudeAdapted)
+            {
+                thread_local Nodes nodes;
+                GenerateAltitudeAdapted(sampleCount, a, b, pp, nodes);
+                return nodes;
+            }
+
+            thread_local std::map<std::pair<QuadratureRule, int>, Nodes> cache;
+            auto const key = std::make_pair(rule, sampleCount);
+            auto entry = cache.find(key);
+            if(entry == cache.end())
+            {
+                entry = cache.emplace(key, GenerateFixed(rule, sampleCount)).first;
+            }
+
+            return entry->second;
+        }
+
+        // Integral over [0, 1] of integrand(s), the point a + (b - a) s, with the given rule.
+        template <typename Integrand>
+        [[nodiscard]]
+        static auto Integrate(
+            QuadratureRule const rule,
+            int const sampleCount,
+            float const tolerance,
+            Vector3 const& a,
+            Vector3 const& b,
+            PlanetProperties const& pp,
+            Integrand const& integrand) -> Vector3
+        {
+            if(rule == QuadratureRule::Adaptive)
+            {
+                return IntegrateAdaptive(sampleCount, tolerance, integrand);
+            }
+
+            // The integrand may integrate paths of its own, so the shared buffer of GetNodes is not used here.
+            if(rule == QuadratureRule::AltitudeAdapted)
+            {
+                Nodes nodes;
+                GenerateAltitudeAdapted(sampleCount, a, b, pp, nodes);
+                return Sum(nodes, integrand);
+            }
+
+            return Sum(GetNodes(rule, sampleCount, a, b, pp), integrand);
+        }
+
+        // Nodes and weights of the n-point Gauss-Legendre rule on [0, 1], found by Newton iteration on the Legendre
+        // polynomial in double precision.
+        static auto GaussLegendre(int const n, std::vector<float>& nodes, std::vector<float>& weights) -> void
+        {
+            nodes.resize(n);
+            weights.resize(n);
+
+            for(auto i = 0; i < (n + 1) / 2; ++i)
+            {
+                auto x = std::cos(3.14159265358979323846 * (i + 0.75) / (n + 0.5));
+                auto derivative = 0.0;
+
+                for(auto iteration = 0; iteration < 100; ++iteration)
+                {
+                    auto p0 = 1.0;
+                    auto p1 = 0.0;
+                    for(auto k = 1; k <= n; ++k)
+                    {
+                        auto const p2 = p1;
+                        p1 = p0;
+                        p0 = ((2.0 * k - 1.0) * x * p1 - (k - 1.0) * p2) / k;
+                    }
+
+                    derivative = n * (x * p0 - p1) / (x * x - 1.0);
+                    auto const step = p0 / derivative;
+                    x -= step;
+
+                    if(std::abs(step) < 1e-15)
+                    {
+                        break;
+                    }
+                }
+
+                auto const weight = 1.0 / ((1.0 - x * x) * derivative * derivative);
+
+                nodes[i] = static_cast<float>((1.0 - x) / 2.0);
+                nodes[n - 1 - i] = static_cast<float>((1.0 + x) / 2.0);
+                weights[i] = static_cast<float>(weight);
+                weights[n - 1 - i] = static_cast<float>(weight);
+            }
+        }
+
+        // Van der Corput sequence in the given base, the coordinates of the Halton sequence.
+        [[nodiscard]]
+        static auto RadicalInverse(unsigned index, unsigned const base) -> float
+        {
+            auto const inverseBase = 1.0 / base;
+            auto factor = inverseBase;
+            auto result = 0.0;
+
+            while(index > 0)
+            {
+                result += (index % base) * factor;
+                index /= base;
+                factor *= inverseBase;
+            }
+
+            return static_cast<float>(result);
+        }
+
+    private:
+        [[nodiscard]]
+        static auto GenerateFixed(QuadratureRule const rule, int const sampleCount) -> Nodes
+        {
+            Nodes nodes;
+
+            switch(rule)
+            {
+            case QuadratureRule::Simpson:
+            {
+                auto const count = std::max(3, sampleCount | 1);
+                auto const step = 1.0f / static_cast<float>(count - 1);
+                for(auto i = 0; i < count; ++i)
+                {
+                    auto const factor = i == 0 || i == count - 1 ? 1.0f : (i % 2 == 1 ? 4.0f : 2.0f);
+                    nodes.positions.push_back(static_cast<float>(i) * step);
+                    nodes.weights.push_back(factor * step / 3.0f);
+                }
+                break;
+            }
+            case QuadratureRule::GaussLegendre:
+                GaussLegendre(std::max(1, sampleCount), nodes.positions, nodes.weights);
+                break;
+            default:
+                AppendMidpoints(std::max(1, sampleCount), nodes);
+                break;
+            }
+
+            Pad(nodes);
+            return nodes;
+        }
+
+        // The path is split at its lowest point into two parts along which the altitude grows monotonically. On each
+        // part the altitude is taken as linear in the distance, which makes the Rayleigh density exponential, and the
+        // midpoints are placed at equal increments of its integral. Samples are shared between the parts in proportion
+        // to the air they hold.
+        static auto GenerateAltitudeAdapted(
+            int const sampleCount,
+            Vector3 const& a,
+            Vector3 const& b,
+            PlanetProperties const& pp,
+            Nodes& nodes) -> void
+        {
+            nodes.positions.clear();
+            nodes.weights.clear();
+
+            auto const path = b - a;
+            auto const pathLength = path.Length();
+            auto const count = std::max(1, sampleCount);
+            if(pathLength <= 0.0f || count == 1)
+            {
+                AppendMidpoints(count, nodes);
+                Pad(nodes);
+                return;
+            }
+
+            auto const scaleHeight = std::max(pp.GetRayleightScaleHeight(), pp.GetMieScaleHeight());
+            auto const lowest = std::clamp(-Dot(a, path) / (pathLength * pathLength), 0.0f, 1.0f);
+            auto const lowestRadius = (a + path * lowest).Length();
+
+            struct Part final
+            {
+                float length;
+                float rise;
+                float mass;
+                float direction;
+            };
+
+            auto const makePart = [&](float const length, Vector3 const& end, float const direction)
+            {
+                auto const rise = std::max(0.0f, (end.Length() - lowestRadius) / scaleHeight);
+                auto const mass = rise > 1e-4f ? length * -std::expm1(-rise) / rise : length;
+                return Part{ length, rise, mass, direction };
+            };
+
+            Part const parts[2] = {
+                makePart(lowest, a, -1.0f),
+                makePart(1.0f - lowest, b, 1.0f)
+            };
+
+            auto const totalMass = parts[0].mass + parts[1].mass;
+            // A part of no length gets no samples, any other at least one.
+            auto const firstCount = parts[0].length > 0.0f
+                ? std::clamp(static_cast<int>(std::lround(count * parts[0].mass / totalMass)), 1,
+                    parts[1].length > 0.0f ? count - 1 : count)
+                : 0;
+
+            int const counts[2] = { firstCount, count - firstCount };
+
+            // Stronger stretching starves the far end of grazing paths, along which the altitude grows slower than the
+            // linear model assumes.
+            auto constexpr maxRise = 3.0;
+
+            for(auto p = 0; p < 2; ++p)
+            {
+                auto const& part = parts[p];
+                auto const partCount = counts[p];
+                auto const rise = std::min(static_cast<double>(part.rise), maxRise);
+                auto const c = rise > 1e-4 ? -std::expm1(-rise) : 0.0;
+
+                for(auto i = 0; i < partCount; ++i)
+                {
+                    // The part before the lowest point is walked backwards to keep the nodes in order.
+                    auto const index = part.direction < 0.0f ? partCount - 1 - i : i;
+                    auto const s = (index + 0.5) / partCount;
+                    auto distance = s;
+                    auto derivative = 1.0;
+                    if(c > 0.0)
+                    {
+                        distance = -std::log1p(-s * c) / rise;
+                        derivative = c / (rise * (1.0 - s * c));
+                    }
+
+                    nodes.positions.push_back(static_cast<float>(lowest + part.direction * part.length * distance));
+                    nodes.weights.push_back(static_cast<float>(part.length * derivative / partCount));
+                }
+            }
+
+            Pad(nodes);
+        }
+
+        // Adaptive Simpson rule started from four panels. A panel is accepted once the difference between its one and
+        // two panel estimates is within its share of the tolerance, when it gets too small or when the budget is spent.
+        template <typename Integrand>
+        [[nodiscard]]
+        static auto IntegrateAdaptive(int const sampleCount, float const tolerance, Integrand const& integrand) -> Vector3
+        {
+            struct Panel final
+            {
+                float begin;
+                float end;
+                Vector3 first;
+                Vector3 middle;
+                Vector3 last;
+                Vector3 estimate;
+                int depth;
+            };
+
+            auto constexpr initialPanels = 4;
+            auto constexpr maxDepth = 16;
+
+            Vector3 values[2 * initialPanels + 1];
+            for(auto i = 0; i <= 2 * initialPanels; ++i)
+            {
+                values[i] = integrand(static_cast<float>(i) / (2.0f * initialPanels));
+            }
+            auto evaluations = 2 * initialPanels + 1;
+
+            auto const simpson = [](float const width, Vector3 const& first, Vector3 const& middle, Vector3 const& last)
+            {
+                return (first + middle * 4.0f + last) * (width / 6.0f);
+            };
+
+            std::vector<Panel> panels;
+            auto coarse = Vector3();
+            for(auto i = initialPanels - 1; i >= 0; --i)
+            {
+                auto const begin = static_cast<float>(i) / initialPanels;
+                auto const end = static_cast<float>(i + 1) / initialPanels;
+                auto const estimate = simpson(end - begin, values[2 * i], values[2 * i + 1], values[2 * i + 2]);
+                panels.push_back({ begin, end, values[2 * i], values[2 * i + 1], values[2 * i + 2], estimate, 0 });
+                coarse += estimate;
+            }
+
+            auto const threshold = 15.0f * tolerance * coarse.Length();
+
+            auto result = Vector3();
+            while(!panels.empty())
+            {
+                auto const panel = panels.back();
+                panels.pop_back();
+
+                auto const middle = (panel.begin + panel.end) / 2.0f;
+                auto const firstMiddle = integrand((panel.begin + middle) / 2.0f);
+                auto const lastMiddle = integrand((middle + panel.end) / 2.0f);
+                evaluations += 2;
+
+                auto const halfWidth = (panel.end - panel.begin) / 2.0f;
+                auto const firstHalf = simpson(halfWidth, panel.first, firstMiddle, panel.middle);
+                auto const lastHalf = simpson(halfWidth, panel.middle, lastMiddle, panel.last);
+                auto const difference = firstHalf + lastHalf - panel.estimate;
+
+                if(panel.depth >= maxDepth || evaluations + 4 > sampleCount
+                    || difference.Length() <= threshold * (panel.end - panel.begin))
+                {
+                    result += firstHalf + lastHalf + difference / 15.0f;
+                    continue;
+                }
+
+                panels.push_back({ middle, panel.end, panel.middle, lastMiddle, panel.last, lastHalf, panel.depth + 1 });
+                panels.push_back({ panel.begin, middle, panel.first, firstMiddle, panel.middle, firstHalf, panel.depth + 1 });
+            }
+
+            EvaluationCount() += evaluations;
+            return result;
+        }
+
+        template <typename Integrand>
+        [[nodiscard]]
+        static auto Sum(Nodes const& nodes, Integrand const& integrand) -> Vector3
+        {
+            auto result = Vector3();
+            for(auto i = 0; i < nodes.count; ++i)
+            {
+                result += integrand(nodes.positions[i]) * nodes.weights[i];
+            }
+
+            EvaluationCount() += nodes.count;
+            return result;
+        }
+
+        static auto AppendMidpoints(int const count, Nodes& nodes) -> void
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                nodes.positions.push_back((static_cast<float>(i) + 0.5f) / static_cast<float>(count));
+                nodes.weights.push_back(1.0f / static_cast<float>(count));
+            }
+        }
+
+        static auto Pad(Nodes& nodes) -> void
+        {
+            nodes.count = static_cast<int>(nodes.positions.size());
+            auto const padded = (nodes.count + Padding - 1) / Padding * Padding;
+            nodes.positions.resize(padded, nodes.positions.empty() ? 0.5f : nodes.positions.back());
+            nodes.weights.resize(padded, 0.0f);
+        }
+    };
+}
@@ -3,6 +3,8 @@
 #include "Vector3.hpp"
 #include "PlanetProperties.hpp"
 #include "Transmittance.hpp"
+#include "TransmittanceTable.hpp"
+#include "Quadrature.hpp"
 
 namespace Atmos
 {
@@ -13,6 +15,18 @@ namespace Atmos
         struct IntegrationParams final
         {
             int sampleCount = 512;
+            Kernel kernel = Kernel::Packet;
+            QuadratureRule rule = QuadratureRule::Midpoint;
+            // Relative error of the scattering the adaptive rule aims for.
+            float tolerance = 1e-3f;
+            // With the Packet kernel and every rule but the adaptive one, maps trace the samples of each view ray once
+            // and sweep every sun direction over them instead of tracing the view rays again for every sun direction.
+            bool reuseViewSamples = true;
+
+            auto AddTo(CacheKey& key) const -> void
+            {
+                key.Add(sampleCount).Add(kernel).Add(rule).Add(tolerance).Add(reuseViewSamples);
+            }
         };
 
         static auto GetPathScattering(
@@ -23,45 +37,939 @@ namespace Atmos
             Transmittance::IntegrationParameters const& tParams,
             IntegrationParams const& params) -> Vector3
         {
-            auto const path = b - a;
-            auto const pathDeltaVector = path / static_cast<float>(params.sampleCount);
-            auto const pathDelta = pathDeltaVector.Length();
-            auto const firstViewPathPoint = a + pathDeltaVector / 2.0f;
+            if(params.kernel != Kernel::Scalar && Quadrature::HasNodes(params.rule)
+                && tParams.method == Transmittance::Method::Numeric && Quadrature::IsPathIndependent(tParams.rule))
+            {
+                return Simd::Dispatch([&](auto tag)
+                {
+                    return GetPathScatteringSimd<typename decltype(tag)::Pack>(a, b, sunDir, pp, tParams, params);
+                });
+            }
+
+            if(!Quadrature::HasNodes(params.rule) || tParams.method != Transmittance::Method::Numeric)
+            {
+                return GetPathScatteringPerSample(a, b, sunDir, pp, tParams, params);
+            }
 
+            auto const path = b - a;
             auto const viewSunCos = AngleCos(path, sunDir);
+            auto const rayleightFactor = pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef();
+            auto const mieFactor = pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+
+            // A copy, the sun paths may rebuild the shared buffer of path dependent rules.
+            auto const nodes = Quadrature::GetNodes(params.rule, params.sampleCount, a, b, pp);
+            auto const viewOpticalDepths = GetViewOpticalDepths(a, b, nodes, pp);
 
-            auto rayleightScattering = Vector3();
-            auto mieScattering = Vector3();
-            for(auto i = 0; i < params.sampleCount; ++i)
+            auto scattering = Vector3();
+            for(auto i = 0; i < nodes.count; ++i)
             {
-                auto const viewPathPoint = firstViewPathPoint + pathDeltaVector * i;
-                auto const transmittanceToViewEnterPoint = Transmittance::GetPathTransmittance(viewPathPoint,
-                    a, pp, tParams);
+                auto const viewPathPoint = a + path * nodes.positions[i];
 
                 auto const sunBlockedByPlanet = RayCircleIntersection(viewPathPoint, sunDir, pp.GetPlanetRadius());
                 if(sunBlockedByPlanet)
                 {
                     continue;
                 }
-            
+
                 auto const sunPathEnterPoint
                     = RayCircleIntersection(viewPathPoint, sunDir, pp.GetAtmosphereRadius()).value();
-
                 auto const transmittanceToSunEnterPoint = Transmittance::GetPathTransmittance(viewPathPoint,
                     sunPathEnterPoint, pp, tParams);
 
-                auto const lightPathTransmittance = transmittanceToSunEnterPoint * transmittanceToViewEnterPoint;
+                auto const lightPathTransmittance = transmittanceToSunEnterPoint * Exp(-viewOpticalDepths[i]);
                 auto const pointRadius = viewPathPoint.Length();
-                
-                rayleightScattering += lightPathTransmittance * pp.RayleightDensityRadius(pointRadius);
-                mieScattering += lightPathTransmittance * pp.MieDensityRadius(pointRadius);
+
+                scattering += lightPathTransmittance * (rayleightFactor * pp.RayleightDensityRadius(pointRadius)
+                    + mieFactor * pp.MieDensityRadius(pointRadius)) * nodes.weights[i];
             }
 
-            auto scattering = rayleightScattering * pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef()
-                + mieScattering * pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
-            scattering *= pathDelta;
-            
+            Quadrature::EvaluationCount() += nodes.count;
+
+            return scattering * path.Length();
+        }
+
+        // Optical depth from a to every node of the path from a to b. Consecutive nodes share everything but the
+        // step between them, so the depths are accumulated node to node with Simpson's rule on every step, at the
+        // cost of two density evaluations per node. The result is padded like the nodes.
+        [[nodiscard]]
+        static auto GetViewOpticalDepths(
+            Vector3 const& a,
+            Vector3 const& b,
+            Quadrature::Nodes const& nodes,
+            PlanetProperties const& pp) -> std::vector<Vector3>
+        {
+            auto const path = b - a;
+            auto const pathLength = path.Length();
+
+            auto const extinction = [&](float const s)
+            {
+                auto const radius = (a + path * s).Length();
+                return pp.RayleightDensityRadius(radius) * pp.GetRayleightExtinctionCoef()
+                    + pp.MieDensityRadius(radius) * pp.GetMieExtinctionCoef();
+            };
+
+            auto opticalDepths = std::vector<Vector3>(nodes.positions.size());
+
+            auto opticalDepth = Vector3();
+            auto previousPosition = 0.0f;
+            auto previousExtinction = extinction(0.0f);
+            for(auto i = 0; i < nodes.count; ++i)
+            {
+                auto const position = nodes.positions[i];
+                auto const middleExtinction = extinction((previousPosition + position) / 2.0f);
+                auto const nodeExtinction = extinction(position);
+
+                opticalDepth += (previousExtinction + middleExtinction * 4.0f + nodeExtinction)
+                    * ((position - previousPosition) * pathLength / 6.0f);
+                opticalDepths[i] = opticalDepth;
+
+                previousPosition = position;
+                previousExtinction = nodeExtinction;
+            }
+
+            std::fill(opticalDepths.begin() + nodes.count, opticalDepths.end(), opticalDepth);
+            Quadrature::EvaluationCount() += 2 * nodes.count + 1;
+
+            return opticalDepths;
+        }
+
+        static auto GetPathScattering(
+            Vector3 const& a,
+            Vector3 const& b,
+            Vector3 const& sunDir,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params) -> Vector3
+        {
+            if(params.kernel != Kernel::Scalar && Quadrature::HasNodes(params.rule))
+            {
+                return Simd::Dispatch([&](auto tag)
+                {
+                    return GetPathScatteringSimd<typename decltype(tag)::Pack>(a, b, sunDir, transmittanceTable, params);
+                });
+            }
+
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+
+            auto const path = b - a;
+            auto const viewSunCos = AngleCos(path, sunDir);
+            auto const rayleightFactor = pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef();
+            auto const mieFactor = pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+
+            // The zenith cosines along the view ray are taken with the direction of the whole path, as the vectorized
+            // kernels take them. The direction from the origin to a sample near it loses most of its digits.
+            auto const viewDir = path / path.Length();
+            auto const enterPointRadius = a.Length();
+            auto const enterPointZenithCos = Dot(a, viewDir) / enterPointRadius;
+            auto const viewIntersectsGround = transmittanceTable.RayIntersectsGround(enterPointRadius, enterPointZenithCos);
+            auto const enterPointTransmittance = transmittanceTable.GetTransmittanceToAtmosphere(enterPointRadius,
+                viewIntersectsGround ? -enterPointZenithCos : enterPointZenithCos);
+
+            auto const scattering = Quadrature::Integrate(params.rule, params.sampleCount, params.tolerance, a, b, pp,
+                [&](float const s)
+                {
+                    auto const viewPathPoint = a + path * s;
+                    auto const pointRadius = viewPathPoint.Length();
+                    auto const sunZenithCos = Dot(viewPathPoint, sunDir) / pointRadius;
+
+                    auto const sunBlockedByPlanet = transmittanceTable.RayIntersectsGround(pointRadius, sunZenithCos);
+                    if(sunBlockedByPlanet)
+                    {
+                        return Vector3();
+                    }
+
+                    auto const pointZenithCos = Dot(viewPathPoint, viewDir) / pointRadius;
+                    auto const transmittanceRatio = viewIntersectsGround
+                        ? transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, -pointZenithCos) / enterPointTransmittance
+                        : enterPointTransmittance / transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, pointZenithCos);
+                    auto const transmittanceToViewEnterPoint = Vector3(std::min(transmittanceRatio.x, 1.0f),
+                        std::min(transmittanceRatio.y, 1.0f), std::min(transmittanceRatio.z, 1.0f));
+                    auto const transmittanceToSunEnterPoint
+                        = transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, sunZenithCos);
+
+                    auto const lightPathTransmittance = transmittanceToSunEnterPoint * transmittanceToViewEnterPoint;
+
+                    return lightPathTransmittance * (rayleightFactor * pp.RayleightDensityRadius(pointRadius)
+                        + mieFactor * pp.MieDensityRadius(pointRadius));
+                });
+
+            return scattering * path.Length();
+        }
+
+        // Transmittance back to the view ray origin integrated from scratch for every sample, for the adaptive rule and
+        // the analytic transmittance, which need no prefix.
+        [[nodiscard]]
+        static auto GetPathScatteringPerSample(
+            Vector3 const& a,
+            Vector3 const& b,
+            Vector3 const& sunDir,
+            PlanetProperties const& pp,
+            Transmittance::IntegrationParameters const& tParams,
+            IntegrationParams const& params) -> Vector3
+        {
+            auto const path = b - a;
+            auto const viewSunCos = AngleCos(path, sunDir);
+            auto const rayleightFactor = pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef();
+            auto const mieFactor = pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+
+            auto const scattering = Quadrature::Integrate(params.rule, params.sampleCount, params.tolerance, a, b, pp,
+                [&](float const s)
+                {
+                    auto const viewPathPoint = a + path * s;
+
+                    auto const sunBlockedByPlanet = RayCircleIntersection(viewPathPoint, sunDir, pp.GetPlanetRadius());
+                    if(sunBlockedByPlanet)
+                    {
+                        return Vector3();
+                    }
+
+                    auto const transmittanceToViewEnterPoint = Transmittance::GetPathTransmittance(viewPathPoint,
+                        a, pp, tParams);
+                    auto const sunPathEnterPoint
+                        = RayCircleIntersection(viewPathPoint, sunDir, pp.GetAtmosphereRadius()).value();
+                    auto const transmittanceToSunEnterPoint = Transmittance::GetPathTransmittance(viewPathPoint,
+                        sunPathEnterPoint, pp, tParams);
+
+                    auto const lightPathTransmittance = transmittanceToSunEnterPoint * transmittanceToViewEnterPoint;
+                    auto const pointRadius = viewPathPoint.Length();
+
+                    return lightPathTransmittance * (rayleightFactor * pp.RayleightDensityRadius(pointRadius)
+                        + mieFactor * pp.MieDensityRadius(pointRadius));
+                });
+
+            return scattering * path.Length();
+        }
+
+        // Nodes of the view path in the lanes of a pack, the optical depths back to the view ray origin accumulated
+        // beforehand and every lane marching its own sun path in lockstep with the path independent rule of the
+        // transmittance parameters.
+        template <typename Pack>
+        static auto GetPathScatteringSimd(
+            Vector3 const& a,
+            Vector3 const& b,
+            Vector3 const& sunDir,
+            PlanetProperties const& pp,
+            Transmittance::IntegrationParameters const& tParams,
+            IntegrationParams const& params) -> Vector3
+        {
+            auto const path = b - a;
+            auto const& nodes = Quadrature::GetNodes(params.rule, params.sampleCount, a, b, pp);
+            auto const viewOpticalDepths = GetViewOpticalDepths(a, b, nodes, pp);
+
+            auto const viewSunCos = AngleCos(path, sunDir);
+
+            auto const viewPathDelta = Simd::Vector3Pack<Pack>(path);
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const sun = Simd::Vector3Pack<Pack>(sunDir);
+            auto const rayleightExtinction = Simd::Vector3Pack<Pack>(pp.GetRayleightExtinctionCoef());
+            auto const mieExtinction = Simd::Vector3Pack<Pack>(pp.GetMieExtinctionCoef());
+            auto const zero = Simd::Vector3Pack<Pack>(Vector3());
+
+            auto rayleightScattering = zero;
+            auto mieScattering = zero;
+            for(auto i = 0; i < nodes.count; i += Pack::Width)
+            {
+                auto const weight = Pack::Load(nodes.weights.data() + i);
+                auto const viewPathPoint = viewPathEnterPoint + viewPathDelta * Pack::Load(nodes.positions.data() + i);
+
+                Pack discriminant;
+                Pack tNear;
+                Pack tFar;
+                Simd::RaySphereIntersection(viewPathPoint, sun, pp.GetPlanetRadius(), discriminant, tNear, tFar);
+                auto const sunBlockedByPlanet = (discriminant >= Pack(0.0f)) & (tFar >= Pack(0.0f));
+
+                auto const active = (weight > Pack(0.0f)) & !sunBlockedByPlanet;
+                if(!Any(active))
+                {
+                    continue;
+                }
+
+                Simd::RaySphereIntersection(viewPathPoint, sun, pp.GetAtmosphereRadius(), discriminant, tNear, tFar);
+                auto const sunPathEnterPoint = viewPathPoint + sun * Select(tNear >= Pack(0.0f), tNear, tFar);
+
+                Pack sunRayleightDensity;
+                Pack sunMieDensity;
+                Transmittance::GetPathDensitySimd(viewPathPoint, sunPathEnterPoint, pp, tParams, sunRayleightDensity, sunMieDensity);
+
+                auto const viewOpticalDepth = Simd::LoadPoints<Pack>(viewOpticalDepths.data() + i, nodes.count - i);
+                auto const lightPathTransmittance = Exp(rayleightExtinction * -sunRayleightDensity
+                    + mieExtinction * -sunMieDensity - viewOpticalDepth);
+
+                auto const pointRadius = viewPathPoint.Length();
+                auto const weightedTransmittance = lightPathTransmittance * weight;
+                rayleightScattering = rayleightScattering
+                    + Select(active, weightedTransmittance * pp.RayleightDensityRadius(pointRadius), zero);
+                mieScattering = mieScattering
+                    + Select(active, weightedTransmittance * pp.MieDensityRadius(pointRadius), zero);
+            }
+
+            Quadrature::EvaluationCount() += nodes.count;
+
+            auto scattering = ReduceAdd(rayleightScattering) * pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef()
+                + ReduceAdd(mieScattering) * pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+            scattering *= path.Length();
+
+            return scattering;
+        }
+
+        // Nodes of the view path in the lanes of a pack with both transmittances looked up from the table. The lookup at the
+        // view ray origin is shared by all samples.
+        template <typename Pack>
+        static auto GetPathScatteringSimd(
+            Vector3 const& a,
+            Vector3 const& b,
+            Vector3 const& sunDir,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params) -> Vector3
+        {
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+
+            auto const path = b - a;
+            auto const& nodes = Quadrature::GetNodes(params.rule, params.sampleCount, a, b, pp);
+
+            auto const viewSunCos = AngleCos(path, sunDir);
+
+            auto const viewDir = path / path.Length();
+            auto const enterPointRadius = a.Length();
+            auto const enterPointZenithCos = Dot(a, viewDir) / enterPointRadius;
+            auto const viewIntersectsGround = transmittanceTable.RayIntersectsGround(enterPointRadius, enterPointZenithCos);
+            auto const enterPointTransmittance = Simd::Vector3Pack<Pack>(transmittanceTable.GetTransmittanceToAtmosphere(
+                enterPointRadius, viewIntersectsGround ? -enterPointZenithCos : enterPointZenithCos));
+
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const viewPathDelta = Simd::Vector3Pack<Pack>(path);
+            auto const view = Simd::Vector3Pack<Pack>(viewDir);
+            auto const sun = Simd::Vector3Pack<Pack>(sunDir);
+            auto const one = Pack(1.0f);
+            auto const zero = Simd::Vector3Pack<Pack>(Vector3());
+
+            auto rayleightScattering = zero;
+            auto mieScattering = zero;
+            for(auto i = 0; i < nodes.count; i += Pack::Width)
+            {
+                auto const weight = Pack::Load(nodes.weights.data() + i);
+                auto const viewPathPoint = viewPathEnterPoint + viewPathDelta * Pack::Load(nodes.positions.data() + i);
+                auto const pointRadius = viewPathPoint.Length();
+                auto const sunZenithCos = Dot(viewPathPoint, sun) / pointRadius;
+
+                auto const sunBlockedByPlanet = transmittanceTable.RayIntersectsGround(pointRadius, sunZenithCos);
+                auto const active = (weight > Pack(0.0f)) & !sunBlockedByPlanet;
+                if(!Any(active))
+                {
+                    continue;
+                }
+
+                auto const pointZenithCos = Dot(viewPathPoint, view) / pointRadius;
+                auto transmittanceToViewEnterPoint = viewIntersectsGround
+                    ? transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, -pointZenithCos) / enterPointTransmittance
+                    : enterPointTransmittance / transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, pointZenithCos);
+                transmittanceToViewEnterPoint = {
+                    Min(transmittanceToViewEnterPoint.x, one),
+                    Min(transmittanceToViewEnterPoint.y, one),
+                    Min(transmittanceToViewEnterPoint.z, one)
+                };
+
+                auto const transmittanceToSunEnterPoint = transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, sunZenithCos);
+                auto const lightPathTransmittance = transmittanceToSunEnterPoint * transmittanceToViewEnterPoint * weight;
+
+                rayleightScattering = rayleightScattering
+                    + Select(active, lightPathTransmittance * pp.RayleightDensityRadius(pointRadius), zero);
+                mieScattering = mieScattering
+                    + Select(active, lightPathTransmittance * pp.MieDensityRadius(pointRadius), zero);
+            }
+
+            Quadrature::EvaluationCount() += nodes.count;
+
+            auto scattering = ReduceAdd(rayleightScattering) * pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef()
+                + ReduceAdd(mieScattering) * pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+            scattering *= path.Length();
+
             return scattering;
         }
+
+        // Scattering along count view rays sharing the origin and the sun, one ray per lane. Rays are sampled at the
+        // same fractions of their lengths, so the lanes stay in lockstep; rules whose nodes depend on the path are
+        // integrated ray by ray.
+        static auto GetPathScatteringPacket(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const& sunDir,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Vector3* const scattering) -> void
+        {
+            if(params.kernel != Kernel::Packet || !Quadrature::IsPathIndependent(params.rule))
+            {
+                for(auto i = 0; i < count; ++i)
+                {
+                    scattering[i] = GetPathScattering(a, b[i], sunDir, transmittanceTable, params);
+                }
+                return;
+            }
+
+            Simd::Dispatch([&](auto tag)
+            {
+                GetPathScatteringPacketSimd<typename decltype(tag)::Pack>(a, b, count, sunDir, transmittanceTable, params,
+                    scattering);
+            });
+        }
+
+        template <typename Pack>
+        static auto GetPathScatteringPacketSimd(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const& sunDir,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Vector3* const scattering) -> void
+        {
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+            auto const& nodes = Quadrature::GetNodes(params.rule, params.sampleCount, Vector3(), Vector3(), pp);
+
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const sun = Simd::Vector3Pack<Pack>(sunDir);
+            auto const one = Pack(1.0f);
+            auto const zero = Simd::Vector3Pack<Pack>(Vector3());
+
+            auto const enterPointRadius = Pack(a.Length());
+
+            for(auto first = 0; first < count; first += Pack::Width)
+            {
+                auto const path = Simd::LoadPoints<Pack>(b + first, count - first) - viewPathEnterPoint;
+                auto const pathLength = path.Length();
+                // Divided as the scalar kernel divides, since a reciprocal moves the zenith cosines of grazing rays by
+                // enough to tell in the transmittance table.
+                auto const viewDir = path / pathLength;
+
+                auto const enterPointZenithCos = Dot(viewPathEnterPoint, viewDir) / enterPointRadius;
+                auto const viewIntersectsGround = transmittanceTable.RayIntersectsGround(enterPointRadius, enterPointZenithCos);
+                auto const enterPointTransmittance = transmittanceTable.GetTransmittanceToAtmosphere(enterPointRadius,
+                    Select(viewIntersectsGround, -enterPointZenithCos, enterPointZenithCos));
+
+                auto rayleightScattering = zero;
+                auto mieScattering = zero;
+                for(auto i = 0; i < nodes.count; ++i)
+                {
+                    auto const viewPathPoint = viewPathEnterPoint + path * Pack(nodes.positions[i]);
+                    auto const pointRadius = viewPathPoint.Length();
+                    auto const sunZenithCos = Dot(viewPathPoint, sun) / pointRadius;
+
+                    auto const active = !transmittanceTable.RayIntersectsGround(pointRadius, sunZenithCos);
+                    if(!Any(active))
+                    {
+                        continue;
+                    }
+
+                    auto const pointZenithCos = Dot(viewPathPoint, viewDir) / pointRadius;
+                    auto const pointTransmittance = transmittanceTable.GetTransmittanceToAtmosphere(pointRadius,
+                        Select(viewIntersectsGround, -pointZenithCos, pointZenithCos));
+                    auto transmittanceToViewEnterPoint = Select(viewIntersectsGround,
+                        pointTransmittance / enterPointTransmittance, enterPointTransmittance / pointTransmittance);
+                    transmittanceToViewEnterPoint = {
+                        Min(transmittanceToViewEnterPoint.x, one),
+                        Min(transmittanceToViewEnterPoint.y, one),
+                        Min(transmittanceToViewEnterPoint.z, one)
+                    };
+
+                    auto const transmittanceToSunEnterPoint = transmittanceTable.GetTransmittanceToAtmosphere(pointRadius, sunZenithCos);
+                    auto const lightPathTransmittance = transmittanceToSunEnterPoint * transmittanceToViewEnterPoint
+                        * Pack(nodes.weights[i]);
+
+                    rayleightScattering = rayleightScattering
+                        + Select(active, lightPathTransmittance * pp.RayleightDensityRadius(pointRadius), zero);
+                    mieScattering = mieScattering
+                        + Select(active, lightPathTransmittance * pp.MieDensityRadius(pointRadius), zero);
+                }
+
+                Quadrature::EvaluationCount() += static_cast<std::int64_t>(nodes.count) * std::min(count - first, Pack::Width);
+
+                Vector3 rayleightLanes[Pack::Width];
+                Vector3 mieLanes[Pack::Width];
+                Simd::StorePoints(rayleightScattering, rayleightLanes, Pack::Width);
+                Simd::StorePoints(mieScattering, mieLanes, Pack::Width);
+
+                for(auto lane = 0; lane < std::min(count - first, Pack::Width); ++lane)
+                {
+                    auto const lanePath = b[first + lane] - a;
+                    auto const viewSunCos = AngleCos(lanePath, sunDir);
+
+                    auto laneScattering = rayleightLanes[lane] * pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef()
+                        + mieLanes[lane] * pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+                    laneScattering *= lanePath.Length();
+
+                    scattering[first + lane] = laneScattering;
+                }
+            }
+        }
+
+        // Scattering along count view rays sharing the origin for each of sunCount sun directions, stored at
+        // scattering[sun * count + ray]. Everything about a sample but the sun side, its position, its radius and its
+        // densities weighted by the transmittance back to the origin, is computed once per view ray, so every further
+        // sun direction costs a sun transmittance lookup per sample. Rays are traced a packet at a time with path
+        // independent rules and one at a time with the nodes in the lanes otherwise.
+        static auto GetPathScatteringSweep(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Vector3* const scattering) -> void
+        {
+            if(params.kernel != Kernel::Packet || !Quadrature::HasNodes(params.rule))
+            {
+                for(auto sun = 0; sun < sunCount; ++sun)
+                {
+                    GetPathScatteringPacket(a, b, count, sunDirs[sun], transmittanceTable, params, scattering + sun * count);
+                }
+                return;
+            }
+
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+            SweepSunDirections(a, b, count, sunDirs, sunCount, transmittanceTable, params,
+                [&](int const sun, int const ray, Vector3 const& rayleight, Vector3 const& mie, Vector3 const& path)
+                {
+                    scattering[sun * count + ray] = ApplyPhase(rayleight, mie, path, sunDirs[sun], pp);
+                });
+        }
+
+        // As GetPathScatteringSweep, but the Rayleigh and Mie integrals of transmittance times density are kept apart,
+        // without the phase functions and scattering coefficients that ApplyPhase multiplies in afterwards. They depend
+        // on neither, so tables of them survive changes to both. Every kernel is swept, the midpoint rule standing in
+        // for the adaptive one, which has no nodes.
+        static auto GetPathScatteringIntegralsSweep(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Vector3* const rayleight,
+            Vector3* const mie) -> void
+        {
+            auto sweepParams = params;
+            sweepParams.kernel = Kernel::Packet;
+            if(!Quadrature::HasNodes(params.rule))
+            {
+                sweepParams.rule = QuadratureRule::Midpoint;
+            }
+
+            SweepSunDirections(a, b, count, sunDirs, sunCount, transmittanceTable, sweepParams,
+                [&](int const sun, int const ray, Vector3 const& rayleightIntegral, Vector3 const& mieIntegral,
+                    Vector3 const& path)
+                {
+                    auto const pathLength = path.Length();
+                    rayleight[sun * count + ray] = rayleightIntegral * pathLength;
+                    mie[sun * count + ray] = mieIntegral * pathLength;
+                });
+        }
+
+        // Light scattered towards the viewer from the integrals of GetPathScatteringIntegralsSweep, with the phase
+        // functions and scattering coefficients of pp.
+        [[nodiscard]]
+        static auto ApplyPhase(
+            Vector3 const& rayleight,
+            Vector3 const& mie,
+            float const viewSunCos,
+            PlanetProperties const& pp) -> Vector3
+        {
+            return rayleight * pp.RayleightPhaseCos(viewSunCos) * pp.GetRayleightScatteringCoef()
+                + mie * pp.MiePhaseCos(viewSunCos) * pp.GetMieScatteringCoef();
+        }
+
+        // Spectral scattering along count view rays sharing the origin for each of sunCount sun directions, stored at
+        // scattering[sun * count + ray]. The samples are traced once per view ray and in scalar, their wavelengths
+        // filling the lanes instead, so N wavelengths cost N / Pack::Width exponentials per sample and sun direction.
+        // The optical depths come from the optical depth texture of the table, which must have been computed. Spp
+        // supplies the coefficients and the Mie asymmetry, the geometry and densities being those of the table. The
+        // midpoint rule stands in for the adaptive one.
+        template <int N>
+        static auto GetPathScatteringSpectralSweep(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            SpectralPlanetProperties<N> const& spp,
+            IntegrationParams const& params,
+            Spectrum<N>* const scattering) -> void
+        {
+            constexpr auto MaxWidth = N % 16 == 0 ? 16 : N % 8 == 0 ? 8 : 4;
+            Simd::DispatchAtMost<MaxWidth>([&](auto tag)
+            {
+                GetPathScatteringSpectralSweepSimd<typename decltype(tag)::Pack>(a, b, count, sunDirs, sunCount,
+                    transmittanceTable, spp, params, scattering);
+            });
+        }
+
+    private:
+        // Hands output the sun index, ray index, Rayleigh and Mie sums and path of every ray and sun direction, the
+        // sums being per unit path length and free of phase functions and scattering coefficients.
+        template <typename Output>
+        static auto SweepSunDirections(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Output const& output) -> void
+        {
+            Simd::Dispatch([&](auto tag)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                if(Quadrature::IsPathIndependent(params.rule))
+                {
+                    GetPathScatteringSweepPacketSimd<Pack>(a, b, count, sunDirs, sunCount, transmittanceTable, params, output);
+                }
+                else
+                {
+                    GetPathScatteringSweepSimd<Pack>(a, b, count, sunDirs, sunCount, transmittanceTable, params, output);
+                }
+            });
+        }
+
+        // The sun independent part of a pack of view path samples. The densities already hold the quadrature weight
+        // and the transmittance back to the view ray origin.
+        template <typename Pack>
+        struct ViewSample final
+        {
+            Simd::Vector3Pack<Pack> point;
+            Pack radius;
+            Simd::Vector3Pack<Pack> rayleight;
+            Simd::Vector3Pack<Pack> mie;
+        };
+
+        template <typename Pack>
+        static auto GetViewSample(
+            Simd::Vector3Pack<Pack> const& viewPathPoint,
+            Simd::Vector3Pack<Pack> const& viewDir,
+            Pack const& weight,
+            typename Pack::Mask const& viewIntersectsGround,
+            Simd::Vector3Pack<Pack> const& enterPointTransmittance,
+            TransmittanceTable const& transmittanceTable) -> ViewSample<Pack>
+        {
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+            auto const one = Pack(1.0f);
+
+            auto const pointRadius = viewPathPoint.Length();
+            auto const pointZenithCos = Dot(viewPathPoint, viewDir) / pointRadius;
+            auto const pointTransmittance = transmittanceTable.GetTransmittanceToAtmosphere(pointRadius,
+                Select(viewIntersectsGround, -pointZenithCos, pointZenithCos));
+            auto const transmittanceToViewEnterPoint = Select(viewIntersectsGround,
+                pointTransmittance / enterPointTransmittance, enterPointTransmittance / pointTransmittance);
+            auto const weightedTransmittance = Simd::Vector3Pack<Pack>(
+                Min(transmittanceToViewEnterPoint.x, one) * weight,
+                Min(transmittanceToViewEnterPoint.y, one) * weight,
+                Min(transmittanceToViewEnterPoint.z, one) * weight);
+
+            return {
+                viewPathPoint,
+                pointRadius,
+                weightedTransmittance * pp.RayleightDensityRadius(pointRadius),
+                weightedTransmittance * pp.MieDensityRadius(pointRadius)
+            };
+        }
+
+        // Sums the view samples lit by the sun, weighted by the transmittance towards it.
+        template <typename Pack>
+        static auto AddSunSide(
+            std::vector<ViewSample<Pack>> const& samples,
+            Vector3 const& sunDir,
+            TransmittanceTable const& transmittanceTable,
+            Simd::Vector3Pack<Pack>& rayleightScattering,
+            Simd::Vector3Pack<Pack>& mieScattering) -> void
+        {
+            auto const sun = Simd::Vector3Pack<Pack>(sunDir);
+            auto const zero = Simd::Vector3Pack<Pack>(Vector3());
+
+            rayleightScattering = zero;
+            mieScattering = zero;
+            for(auto const& sample : samples)
+            {
+                auto const sunZenithCos = Dot(sample.point, sun) / sample.radius;
+                auto const active = !transmittanceTable.RayIntersectsGround(sample.radius, sunZenithCos);
+                if(!Any(active))
+                {
+                    continue;
+                }
+
+                auto const transmittanceToSunEnterPoint = transmittanceTable.GetTransmittanceToAtmosphere(sample.radius, sunZenithCos);
+                rayleightScattering = rayleightScattering + Select(active, transmittanceToSunEnterPoint * sample.rayleight, zero);
+                mieScattering = mieScattering + Select(active, transmittanceToSunEnterPoint * sample.mie, zero);
+            }
+        }
+
+        [[nodiscard]]
+        static auto ApplyPhase(
+            Vector3 const& rayleightScattering,
+            Vector3 const& mieScattering,
+            Vector3 const& path,
+            Vector3 const& sunDir,
+            PlanetProperties const& pp) -> Vector3
+        {
+            return ApplyPhase(rayleightScattering, mieScattering, AngleCos(path, sunDir), pp) * path.Length();
+        }
+
+        // One view ray per lane, as GetPathScatteringPacketSimd.
+        template <typename Pack, typename Output>
+        static auto GetPathScatteringSweepPacketSimd(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Output const& output) -> void
+        {
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+            auto const& nodes = Quadrature::GetNodes(params.rule, params.sampleCount, Vector3(), Vector3(), pp);
+
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const enterPointRadius = Pack(a.Length());
+
+            auto samples = std::vector<ViewSample<Pack>>(nodes.count);
+            for(auto first = 0; first < count; first += Pack::Width)
+            {
+                auto const lanes = std::min(count - first, Pack::Width);
+                auto const path = Simd::LoadPoints<Pack>(b + first, lanes) - viewPathEnterPoint;
+                auto const viewDir = path / path.Length();
+
+                auto const enterPointZenithCos = Dot(viewPathEnterPoint, viewDir) / enterPointRadius;
+                auto const viewIntersectsGround = transmittanceTable.RayIntersectsGround(enterPointRadius, enterPointZenithCos);
+                auto const enterPointTransmittance = transmittanceTable.GetTransmittanceToAtmosphere(enterPointRadius,
+                    Select(viewIntersectsGround, -enterPointZenithCos, enterPointZenithCos));
+
+                for(auto i = 0; i < nodes.count; ++i)
+                {
+                    samples[i] = GetViewSample(viewPathEnterPoint + path * Pack(nodes.positions[i]), viewDir,
+                        Pack(nodes.weights[i]), viewIntersectsGround, enterPointTransmittance, transmittanceTable);
+                }
+
+                Quadrature::EvaluationCount() += static_cast<std::int64_t>(nodes.count) * lanes;
+
+                Vector3 lanePaths[Pack::Width];
+                Simd::StorePoints(path, lanePaths, Pack::Width);
+
+                for(auto sun = 0; sun < sunCount; ++sun)
+                {
+                    Simd::Vector3Pack<Pack> rayleightScattering;
+                    Simd::Vector3Pack<Pack> mieScattering;
+                    AddSunSide(samples, sunDirs[sun], transmittanceTable, rayleightScattering, mieScattering);
+
+                    Vector3 rayleightLanes[Pack::Width];
+                    Vector3 mieLanes[Pack::Width];
+                    Simd::StorePoints(rayleightScattering, rayleightLanes, Pack::Width);
+                    Simd::StorePoints(mieScattering, mieLanes, Pack::Width);
+
+                    for(auto lane = 0; lane < lanes; ++lane)
+                    {
+                        output(sun, first + lane, rayleightLanes[lane], mieLanes[lane], lanePaths[lane]);
+                    }
+                }
+            }
+        }
+
+        // The sun independent part of a pack of view path samples of the spectral sweep. The densities hold the
+        // quadrature weight, the optical depths are those back to the view ray origin.
+        template <typename Pack>
+        struct SpectralSample final
+        {
+            Simd::Vector3Pack<Pack> point;
+            Pack radius;
+            Pack rayleight;
+            Pack mie;
+            Pack rayleightDepth;
+            Pack mieDepth;
+        };
+
+        // The geometry and optical depths of the samples are handled a pack of samples at a time, then the
+        // wavelengths of each sample a pack of wavelengths at a time.
+        template <typename Pack, int N>
+        static auto GetPathScatteringSpectralSweepSimd(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            SpectralPlanetProperties<N> const& spp,
+            IntegrationParams const& params,
+            Spectrum<N>* const scattering) -> void
+        {
+            constexpr auto Packs = N / Pack::Width;
+
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+            auto const rule = Quadrature::HasNodes(params.rule) ? params.rule : QuadratureRule::Midpoint;
+
+            Pack rayleightExtinction[Packs];
+            Pack mieExtinction[Packs];
+            Pack rayleightScatteringCoef[Packs];
+            Pack mieScatteringCoef[Packs];
+            for(auto k = 0; k < Packs; ++k)
+            {
+                rayleightExtinction[k] = -Pack::Load(spp.GetRayleightExtinctionCoef().values + k * Pack::Width);
+                mieExtinction[k] = -Pack::Load(spp.GetMieExtinctionCoef().values + k * Pack::Width);
+                rayleightScatteringCoef[k] = Pack::Load(spp.GetRayleightScatteringCoef().values + k * Pack::Width);
+                mieScatteringCoef[k] = Pack::Load(spp.GetMieScatteringCoef().values + k * Pack::Width);
+            }
+
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const zero = Pack(0.0f);
+
+            auto samples = std::vector<SpectralSample<Pack>>();
+            for(auto ray = 0; ray < count; ++ray)
+            {
+                auto const path = b[ray] - a;
+                auto const pathLength = path.Length();
+                auto const& nodes = Quadrature::GetNodes(rule, params.sampleCount, a, b[ray], pp);
+
+                auto const viewPathDelta = Simd::Vector3Pack<Pack>(path);
+                samples.resize((nodes.count + Pack::Width - 1) / Pack::Width);
+                for(auto i = 0; i < nodes.count; i += Pack::Width)
+                {
+                    float rayleightDepths[Pack::Width];
+                    float mieDepths[Pack::Width];
+                    for(auto lane = 0; lane < Pack::Width; ++lane)
+                    {
+                        auto const depth = transmittanceTable.GetOpticalDepth(a,
+                            a + path * nodes.positions[std::min(i + lane, nodes.count - 1)]);
+                        rayleightDepths[lane] = depth.x;
+                        mieDepths[lane] = depth.y;
+                    }
+
+                    auto& sample = samples[i / Pack::Width];
+                    auto const weight = Pack::Load(nodes.weights.data() + i);
+                    sample.point = viewPathEnterPoint + viewPathDelta * Pack::Load(nodes.positions.data() + i);
+                    sample.radius = sample.point.Length();
+                    sample.rayleight = weight * pp.RayleightDensityRadius(sample.radius);
+                    sample.mie = weight * pp.MieDensityRadius(sample.radius);
+                    sample.rayleightDepth = Pack::Load(rayleightDepths);
+                    sample.mieDepth = Pack::Load(mieDepths);
+                }
+
+                Quadrature::EvaluationCount() += nodes.count;
+
+                for(auto sun = 0; sun < sunCount; ++sun)
+                {
+                    auto const sunDir = Simd::Vector3Pack<Pack>(sunDirs[sun]);
+
+                    Pack rayleightScattering[Packs];
+                    Pack mieScattering[Packs];
+                    for(auto const& sample : samples)
+                    {
+                        auto const sunZenithCos = Dot(sample.point, sunDir) / sample.radius;
+                        auto const active = !transmittanceTable.RayIntersectsGround(sample.radius, sunZenithCos);
+                        if(!Any(active))
+                        {
+                            continue;
+                        }
+
+                        Pack rayleightDepth;
+                        Pack mieDepth;
+                        transmittanceTable.GetOpticalDepthToAtmosphere(sample.radius, sunZenithCos, rayleightDepth, mieDepth);
+
+                        float rayleightDepths[Pack::Width];
+                        float mieDepths[Pack::Width];
+                        float rayleightDensities[Pack::Width];
+                        float mieDensities[Pack::Width];
+                        (rayleightDepth + sample.rayleightDepth).Store(rayleightDepths);
+                        (mieDepth + sample.mieDepth).Store(mieDepths);
+                        Select(active, sample.rayleight, zero).Store(rayleightDensities);
+                        Select(active, sample.mie, zero).Store(mieDensities);
+
+                        for(auto lane = 0; lane < Pack::Width; ++lane)
+                        {
+                            if(rayleightDensities[lane] == 0.0f && mieDensities[lane] == 0.0f)
+                            {
+                                continue;
+                            }
+
+                            auto const laneRayleightDepth = Pack(rayleightDepths[lane]);
+                            auto const laneMieDepth = Pack(mieDepths[lane]);
+                            auto const laneRayleightDensity = Pack(rayleightDensities[lane]);
+                            auto const laneMieDensity = Pack(mieDensities[lane]);
+                            for(auto k = 0; k < Packs; ++k)
+                            {
+                                auto const transmittance = Simd::Exp(rayleightExtinction[k] * laneRayleightDepth
+                                    + mieExtinction[k] * laneMieDepth);
+                                rayleightScattering[k] = rayleightScattering[k] + transmittance * laneRayleightDensity;
+                                mieScattering[k] = mieScattering[k] + transmittance * laneMieDensity;
+                            }
+                        }
+                    }
+
+                    auto const viewSunCos = AngleCos(path, sunDirs[sun]);
+                    auto const rayleightFactor = Pack(spp.RayleightPhaseCos(viewSunCos) * pathLength);
+                    auto const mieFactor = Pack(spp.MiePhaseCos(viewSunCos) * pathLength);
+
+                    auto& texel = scattering[sun * count + ray];
+                    for(auto k = 0; k < Packs; ++k)
+                    {
+                        (rayleightScattering[k] * rayleightScatteringCoef[k] * rayleightFactor
+                            + mieScattering[k] * mieScatteringCoef[k] * mieFactor).Store(texel.values + k * Pack::Width);
+                    }
+                }
+            }
+        }
+
+        // One view ray at a time with its nodes in the lanes, as GetPathScatteringSimd.
+        template <typename Pack, typename Output>
+        static auto GetPathScatteringSweepSimd(
+            Vector3 const& a,
+            Vector3 const* const b,
+            int const count,
+            Vector3 const* const sunDirs,
+            int const sunCount,
+            TransmittanceTable const& transmittanceTable,
+            IntegrationParams const& params,
+            Output const& output) -> void
+        {
+            auto const& pp = transmittanceTable.GetPlanetProperties();
+
+            auto const viewPathEnterPoint = Simd::Vector3Pack<Pack>(a);
+            auto const enterPointRadius = a.Length();
+
+            auto samples = std::vector<ViewSample<Pack>>();
+            for(auto ray = 0; ray < count; ++ray)
+            {
+                auto const path = b[ray] - a;
+                auto const& nodes = Quadrature::GetNodes(params.rule, params.sampleCount, a, b[ray], pp);
+
+                auto const viewDir = path / path.Length();
+                auto const enterPointZenithCos = Dot(a, viewDir) / enterPointRadius;
+                auto const viewIntersectsGround = transmittanceTable.RayIntersectsGround(enterPointRadius, enterPointZenithCos);
+                auto const enterPointTransmittance = Simd::Vector3Pack<Pack>(transmittanceTable.GetTransmittanceToAtmosphere(
+                    enterPointRadius, viewIntersectsGround ? -enterPointZenithCos : enterPointZenithCos));
+                auto const viewIntersectsGroundMask = Pack(viewIntersectsGround ? 1.0f : 0.0f) > Pack(0.0f);
+
+                auto const viewPathDelta = Simd::Vector3Pack<Pack>(path);
+                samples.resize((nodes.count + Pack::Width - 1) / Pack::Width);
+                for(auto i = 0; i < nodes.count; i += Pack::Width)
+                {
+                    samples[i / Pack::Width] = GetViewSample(
+                        viewPathEnterPoint + viewPathDelta * Pack::Load(nodes.positions.data() + i),
+                        Simd::Vector3Pack<Pack>(viewDir), Pack::Load(nodes.weights.data() + i), viewIntersectsGroundMask,
+                        enterPointTransmittance, transmittanceTable);
+                }
+
+                Quadrature::EvaluationCount() += nodes.count;
+
+                for(auto sun = 0; sun < sunCount; ++sun)
+                {
+                    Simd::Vector3Pack<Pack> rayleightScattering;
+                    Simd::Vector3Pack<Pack> mieScattering;
+                    AddSunSide(samples, sunDirs[sun], transmittanceTable, rayleightScattering, mieScattering);
+
+                    output(sun, ray, ReduceAdd(rayleightScattering), ReduceAdd(mieScattering), path);
+                }
+            }
+        }
     };
 }
\ No newline at end of file
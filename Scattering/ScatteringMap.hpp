@@ -1,103 +1,916 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
 #include "PlanetProperties.hpp"
 #include "Texture.hpp"
-#include "Transmittance.hpp"
+#include "TextureSampler.hpp"
+#include "TransmittanceTable.hpp"
 #include "Scattering.hpp"
+#include "TextureCache.hpp"
+#include "Scheduler.hpp"
 
 namespace Atmos
 {
     class ScatteringMap final
     {
+    public:
+        // How a zenith cosine axis spreads its texels, Cubic packing them around the horizon.
+        enum class Mapping
+        {
+            Linear,
+            Cubic
+        };
+
+        struct RefinementParams final
+        {
+            // Spacing in texels of the grid that is always computed.
+            int coarseSpacing = 16;
+            // A cell is interpolated once bilinear interpolation from its corners predicts the texels at its edge and
+            // centre midpoints within this fraction of their radiance...
+            float tolerance = 1e-2f;
+            // ...or within this absolute radiance, which keeps dark regions from being refined down to single texels.
+            float absoluteTolerance = 1e-5f;
+            // Seconds after which refinement stops and the remaining cells are interpolated, zero meaning no limit.
+            double timeBudget = 0.0;
+        };
+
+    private:
         PlanetProperties pp;
         Texture2D<Vector3> tex;
+        Texture4D<Vector3> fullTex;
 
-        Transmittance::IntegrationParameters tParams;
+        TransmittanceTable transmittanceTable;
         Scattering::IntegrationParams sParams;
+        std::int64_t evaluationCount = 0;
+        std::int64_t computedTexelCount = 0;
+        Mapping fullViewZenithMapping = Mapping::Linear;
+        Mapping fullSunZenithMapping = Mapping::Linear;
+
+        // Rayleigh and Mie integrals free of phase functions and scattering coefficients, empty until ComputeDeferred
+        // and ComputeFullDeferred fill them.
+        Texture2D<Vector3> rayleightTex;
+        Texture2D<Vector3> mieTex;
+        Texture4D<Vector3> fullRayleightTex;
+        Texture4D<Vector3> fullMieTex;
+        Mapping deferredViewZenithMapping = Mapping::Linear;
+        Mapping deferredSunZenithMapping = Mapping::Linear;
+
+        // Side in texels of the square tiles the per-texel kernels are scheduled in.
+        static constexpr int TileSize = 16;
 
     public:
         explicit ScatteringMap(
             std::size_t const viewZenithCosResolution,
             std::size_t const sunZenithCosResolution,
-            PlanetProperties const& planetProperties,
-            Transmittance::IntegrationParameters const& tParams,
+            TransmittanceTable const& transmittanceTable,
             Scattering::IntegrationParams const& sParams)
-            : tex(viewZenithCosResolution, sunZenithCosResolution), pp(planetProperties), tParams(tParams), sParams(sParams)
+            : pp(transmittanceTable.GetPlanetProperties()), tex(viewZenithCosResolution, sunZenithCosResolution),
+            transmittanceTable(transmittanceTable), sParams(sParams)
         { }
-        
-        enum class Mapping
+
+        // Also allocates the full table filled by ComputeFull, with the observer altitude and the azimuth between the
+        // view and sun directions as the two extra dimensions.
+        explicit ScatteringMap(
+            std::size_t const viewZenithCosResolution,
+            std::size_t const sunZenithCosResolution,
+            std::size_t const sunAzimuthCosResolution,
+            std::size_t const altitudeResolution,
+            TransmittanceTable const& transmittanceTable,
+            Scattering::IntegrationParams const& sParams)
+            : pp(transmittanceTable.GetPlanetProperties()), tex(viewZenithCosResolution, sunZenithCosResolution),
+            fullTex(viewZenithCosResolution, sunZenithCosResolution, sunAzimuthCosResolution, altitudeResolution),
+            transmittanceTable(transmittanceTable), sParams(sParams)
+        { }
+
+        auto Compute(
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> void
         {
-            Linear,
-            Cubic
-        };
+            if(sParams.kernel == Kernel::Packet)
+            {
+                ComputePackets(viewZenithMapping, sunZenithMapping);
+                return;
+            }
 
-        
+            evaluationCount = Scheduler::ForEachTile(static_cast<int>(tex.GetUResolution()),
+                static_cast<int>(tex.GetVResolution()), TileSize, TileSize, [&](Scheduler::Tile const& tile)
+            {
+                for(auto i = tile.v0; i < tile.v1; ++i)
+                {
+                    auto const v = tex.IndexToV(i);
+                    auto const sunZenithCos = VToSunZenithCos(sunZenithMapping, v);
+
+                    for(auto j = tile.u0; j < tile.u1; ++j)
+                    {
+                        auto const u = tex.IndexToU(j);
+                        auto const viewZenithCos = UToViewZenithCos(viewZenithMapping, u);
+
+                        tex[i][j] = Calculate(viewZenithCos, sunZenithCos);
+                    }
+                }
+            });
+        }
+
+        // Reads the texture from the cache, or computes it and stores it there. Reports whether it was a hit, which
+        // leaves the evaluation count at zero.
         auto Compute(
+            TextureCache const& cache,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> bool
+        {
+            auto const key = GetCacheKey(viewZenithMapping, sunZenithMapping);
+            if(cache.Load(key, tex))
+            {
+                evaluationCount = 0;
+                return true;
+            }
+
+            Compute(viewZenithMapping, sunZenithMapping);
+            cache.Store(key, tex);
+            return false;
+        }
+
+        // Bakes the Rayleigh and Mie integrals of every texel apart and without the phase functions and scattering
+        // coefficients, then resolves the texture from them. Changing those afterwards only takes another Resolve.
+        // The view rays are always swept, as GetPathScatteringIntegralsSweep does.
+        auto ComputeDeferred(
             Mapping const viewZenithMapping,
             Mapping const sunZenithMapping
         ) -> void
         {
-            #pragma omp parallel for
-            for(auto i = 0; i < static_cast<int>(tex.GetVResolution()); ++i)
+            deferredViewZenithMapping = viewZenithMapping;
+            deferredSunZenithMapping = sunZenithMapping;
+            rayleightTex = Texture2D<Vector3>(tex.GetUResolution(), tex.GetVResolution());
+            mieTex = Texture2D<Vector3>(tex.GetUResolution(), tex.GetVResolution());
+
+            auto const viewPathEnterPoint = GetViewPathEnterPoint();
+
+            auto viewPathExitPoints = std::vector<Vector3>(tex.GetUResolution());
+            for(std::size_t j = 0; j < tex.GetUResolution(); ++j)
             {
-                auto const v = tex.IndexToV(i);
-                auto const sunZenithCos = VToSunZenithCos(sunZenithMapping, v);
-                
-                for(auto j = 0; j < static_cast<int>(tex.GetUResolution()); ++j)
+                auto const viewZenithCos = UToViewZenithCos(viewZenithMapping, tex.IndexToU(j));
+                viewPathExitPoints[j] = GetViewPathExitPoint(viewPathEnterPoint, ZenithCosToDirection(viewZenithCos));
+            }
+
+            auto sunDirs = std::vector<Vector3>(tex.GetVResolution());
+            for(std::size_t i = 0; i < tex.GetVResolution(); ++i)
+            {
+                sunDirs[i] = ZenithCosToDirection(VToSunZenithCos(sunZenithMapping, tex.IndexToV(i)));
+            }
+
+            evaluationCount = SweepViewRayIntegrals({ viewPathEnterPoint }, viewPathExitPoints, sunDirs,
+                [&](std::size_t, std::size_t const i, std::size_t const j, Vector3 const& rayleight, Vector3 const& mie)
+                {
+                    rayleightTex[i][j] = rayleight;
+                    mieTex[i][j] = mie;
+                });
+
+            Resolve(pp);
+        }
+
+        // Reads the deferred tables from the cache, or computes them and stores them there, and resolves the texture.
+        // Their keys leave out the scattering coefficients and the Mie asymmetry, so changing those is still a hit.
+        auto ComputeDeferred(
+            TextureCache const& cache,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> bool
+        {
+            auto const rayleightKey = GetDeferredCacheKey("ScatteringMapRayleight", viewZenithMapping, sunZenithMapping);
+            auto const mieKey = GetDeferredCacheKey("ScatteringMapMie", viewZenithMapping, sunZenithMapping);
+
+            rayleightTex = Texture2D<Vector3>(tex.GetUResolution(), tex.GetVResolution());
+            mieTex = Texture2D<Vector3>(tex.GetUResolution(), tex.GetVResolution());
+            if(cache.Load(rayleightKey, rayleightTex) && cache.Load(mieKey, mieTex))
+            {
+                deferredViewZenithMapping = viewZenithMapping;
+                deferredSunZenithMapping = sunZenithMapping;
+                evaluationCount = 0;
+                Resolve(pp);
+                return true;
+            }
+
+            ComputeDeferred(viewZenithMapping, sunZenithMapping);
+            cache.Store(rayleightKey, rayleightTex);
+            cache.Store(mieKey, mieTex);
+            return false;
+        }
+
+        // Bakes the fixed-altitude texture for the spectral properties spp through
+        // Scattering::GetPathScatteringSpectralSweep, which fills the SIMD lanes with wavelengths. Spp supplies the
+        // coefficients and the Mie asymmetry, the geometry and densities being those of the transmittance table, whose
+        // optical depths are computed on first use.
+        template <int N>
+        auto ComputeSpectral(
+            SpectralPlanetProperties<N> const& spp,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> Texture2D<Spectrum<N>>
+        {
+            if(!transmittanceTable.HasOpticalDepths())
+            {
+                transmittanceTable.ComputeOpticalDepths();
+            }
+
+            auto spectralTex = Texture2D<Spectrum<N>>(tex.GetUResolution(), tex.GetVResolution());
+            auto const viewPathEnterPoint = GetViewPathEnterPoint();
+
+            auto viewPathExitPoints = std::vector<Vector3>(tex.GetUResolution());
+            for(std::size_t j = 0; j < tex.GetUResolution(); ++j)
+            {
+                auto const viewZenithCos = UToViewZenithCos(viewZenithMapping, tex.IndexToU(j));
+                viewPathExitPoints[j] = GetViewPathExitPoint(viewPathEnterPoint, ZenithCosToDirection(viewZenithCos));
+            }
+
+            auto sunDirs = std::vector<Vector3>(tex.GetVResolution());
+            for(std::size_t i = 0; i < tex.GetVResolution(); ++i)
+            {
+                sunDirs[i] = ZenithCosToDirection(VToSunZenithCos(sunZenithMapping, tex.IndexToV(i)));
+            }
+
+            evaluationCount = ForEachSweepBlock({ viewPathEnterPoint }, viewPathExitPoints, sunDirs,
+                [&](std::size_t, int const firstView, int const views, int const firstSun, int const suns)
+                {
+                    auto texels = std::vector<Spectrum<N>>(static_cast<std::size_t>(suns) * views);
+                    Scattering::GetPathScatteringSpectralSweep(viewPathEnterPoint, viewPathExitPoints.data() + firstView,
+                        views, sunDirs.data() + firstSun, suns, transmittanceTable, spp, sParams, texels.data());
+
+                    for(auto sun = 0; sun < suns; ++sun)
+                    {
+                        for(auto j = 0; j < views; ++j)
+                        {
+                            spectralTex[firstSun + sun][firstView + j] = texels[static_cast<std::size_t>(sun) * views + j];
+                        }
+                    }
+                });
+
+            return spectralTex;
+        }
+
+        // Rebuilds the textures from whichever deferred tables were computed, with the phase functions and scattering
+        // coefficients of look. Its other properties are baked into the tables and should match those of the
+        // transmittance table. A single pass over the texels without any integration.
+        auto Resolve(PlanetProperties const& look) -> void
+        {
+            if(rayleightTex.GetUResolution() > 0)
+            {
+                Scheduler::ForEach(static_cast<int>(tex.GetVResolution()), 1, [&](int const i)
+                {
+                    auto const sunDir = ZenithCosToDirection(VToSunZenithCos(deferredSunZenithMapping, tex.IndexToV(i)));
+                    for(std::size_t j = 0; j < tex.GetUResolution(); ++j)
+                    {
+                        auto const viewDir = ZenithCosToDirection(UToViewZenithCos(deferredViewZenithMapping, tex.IndexToU(j)));
+                        tex[i][j] = Scattering::ApplyPhase(rayleightTex[i][j], mieTex[i][j], Dot(viewDir, sunDir), look);
+                    }
+                });
+            }
+
+            if(fullRayleightTex.GetUResolution() > 0)
+            {
+                auto const viewResolution = fullTex.GetUResolution();
+                auto const sunResolution = fullTex.GetVResolution();
+                auto const azimuthResolution = fullTex.GetWResolution();
+                auto const rowCount = static_cast<int>(sunResolution * azimuthResolution * fullTex.GetQResolution());
+
+                Scheduler::ForEach(rowCount, 1, [&](int const row)
+                {
+                    auto const i = static_cast<std::size_t>(row) % sunResolution;
+                    auto const k = static_cast<std::size_t>(row) / sunResolution % azimuthResolution;
+                    auto const q = static_cast<std::size_t>(row) / sunResolution / azimuthResolution;
+
+                    auto const sunDir = ZenithAzimuthCosToDirection(
+                        VToSunZenithCos(fullSunZenithMapping, IndexToUnit(i, sunResolution)),
+                        WToSunAzimuthCos(IndexToUnit(k, azimuthResolution)));
+                    for(std::size_t j = 0; j < viewResolution; ++j)
+                    {
+                        auto const viewDir = ZenithCosToDirection(
+                            UToFullViewZenithCos(fullViewZenithMapping, IndexToUnit(j, viewResolution)));
+                        fullTex[q][k][i][j] = Scattering::ApplyPhase(fullRayleightTex[q][k][i][j], fullMieTex[q][k][i][j],
+                            Dot(viewDir, sunDir), look);
+                    }
+                });
+            }
+        }
+
+        // Computes a coarse grid, then repeatedly splits the cells whose corners do not predict their midpoints within
+        // tolerance, level by level, and interpolates the texels of the cells that remain. Cut short by the time
+        // budget, it leaves a preview whose error shrinks with every level it got through.
+        auto ComputeAdaptive(
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping,
+            RefinementParams const& refinement
+        ) -> void
+        {
+            auto const start = std::chrono::steady_clock::now();
+            auto const uResolution = static_cast<int>(tex.GetUResolution());
+            auto const vResolution = static_cast<int>(tex.GetVResolution());
+
+            evaluationCount = 0;
+            computedTexelCount = 0;
+
+            if(uResolution < 2 || vResolution < 2)
+            {
+                Compute(viewZenithMapping, sunZenithMapping);
+                computedTexelCount = static_cast<std::int64_t>(uResolution) * vResolution;
+                return;
+            }
+
+            auto computed = std::vector<std::uint8_t>(static_cast<std::size_t>(uResolution) * vResolution);
+            auto pending = std::vector<std::pair<int, int>>();
+
+            auto const request = [&](int const j, int const i)
+            {
+                auto& flag = computed[static_cast<std::size_t>(i) * uResolution + j];
+                if(!flag)
+                {
+                    flag = 1;
+                    pending.emplace_back(j, i);
+                }
+            };
+
+            auto const computePending = [&]
+            {
+                evaluationCount += Scheduler::ForEach(static_cast<int>(pending.size()), 16, [&](int const k)
+                {
+                    auto const j = pending[k].first;
+                    auto const i = pending[k].second;
+
+                    tex[i][j] = Calculate(UToViewZenithCos(viewZenithMapping, tex.IndexToU(j)),
+                        VToSunZenithCos(sunZenithMapping, tex.IndexToV(i)));
+                });
+                computedTexelCount += static_cast<std::int64_t>(pending.size());
+                pending.clear();
+            };
+
+            auto const gridLines = [&](int const resolution)
+            {
+                auto lines = std::vector<int>();
+                for(auto line = 0; line < resolution - 1; line += std::max(refinement.coarseSpacing, 1))
+                {
+                    lines.push_back(line);
+                }
+                lines.push_back(resolution - 1);
+                return lines;
+            };
+
+            auto const uLines = gridLines(uResolution);
+            auto const vLines = gridLines(vResolution);
+
+            auto cells = std::vector<Cell>();
+            for(std::size_t b = 0; b + 1 < vLines.size(); ++b)
+            {
+                for(std::size_t a = 0; a + 1 < uLines.size(); ++a)
+                {
+                    cells.push_back({ uLines[a], vLines[b], uLines[a + 1], vLines[b + 1] });
+                }
+            }
+
+            for(auto const i : vLines)
+            {
+                for(auto const j : uLines)
+                {
+                    request(j, i);
+                }
+            }
+            computePending();
+
+            auto const withinTolerance = [&](Vector3 const& exact, Vector3 const& interpolated)
+            {
+                auto const within = [&](float const e, float const t)
+                {
+                    return std::abs(t - e) <= std::max(refinement.tolerance * std::abs(e), refinement.absoluteTolerance);
+                };
+                return within(exact.x, interpolated.x) && within(exact.y, interpolated.y) && within(exact.z, interpolated.z);
+            };
+
+            auto leaves = std::vector<Cell>();
+            auto splitCells = std::vector<Cell>();
+            while(!cells.empty())
+            {
+                auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if(refinement.timeBudget > 0.0 && elapsed > refinement.timeBudget)
+                {
+                    leaves.insert(leaves.end(), cells.begin(), cells.end());
+                    break;
+                }
+
+                splitCells.clear();
+                for(auto const& cell : cells)
                 {
-                    auto const u = tex.IndexToU(j);
-                    auto const viewZenithCos = UToViewZenithCos(viewZenithMapping, u);
+                    if(cell.u1 - cell.u0 < 2 && cell.v1 - cell.v0 < 2)
+                    {
+                        leaves.push_back(cell);
+                        continue;
+                    }
+
+                    auto const uMid = (cell.u0 + cell.u1) / 2;
+                    auto const vMid = (cell.v0 + cell.v1) / 2;
+                    request(uMid, cell.v0);
+                    request(uMid, cell.v1);
+                    request(cell.u0, vMid);
+                    request(cell.u1, vMid);
+                    request(uMid, vMid);
+                    splitCells.push_back(cell);
+                }
+                computePending();
+
+                cells.clear();
+                for(auto const& cell : splitCells)
+                {
+                    auto const uMid = (cell.u0 + cell.u1) / 2;
+                    auto const vMid = (cell.v0 + cell.v1) / 2;
+
+                    std::pair<int, int> const midpoints[] = {
+                        { uMid, cell.v0 }, { uMid, cell.v1 }, { cell.u0, vMid }, { cell.u1, vMid }, { uMid, vMid }
+                    };
+                    auto const accepted = std::all_of(std::begin(midpoints), std::end(midpoints), [&](auto const& texel)
+                    {
+                        return withinTolerance(tex[texel.second][texel.first], Interpolate(cell, texel.first, texel.second));
+                    });
+
+                    if(accepted)
+                    {
+                        leaves.push_back(cell);
+                        continue;
+                    }
 
-                    tex[i][j] = Calculate(viewZenithCos, sunZenithCos);
+                    int const uSplits[] = { cell.u0, uMid, cell.u1 };
+                    int const vSplits[] = { cell.v0, vMid, cell.v1 };
+                    for(auto b = 0; b < 2; ++b)
+                    {
+                        for(auto a = 0; a < 2; ++a)
+                        {
+                            if(uSplits[a] < uSplits[a + 1] && vSplits[b] < vSplits[b + 1])
+                            {
+                                cells.push_back({ uSplits[a], vSplits[b], uSplits[a + 1], vSplits[b + 1] });
+                            }
+                        }
+                    }
                 }
             }
+
+            // Leaves tile the texture, each owning its texels up to but excluding its far edges unless they are the
+            // border of the texture, so every texel is written once.
+            Scheduler::ForEach(static_cast<int>(leaves.size()), 16, [&](int const k)
+            {
+                auto const& cell = leaves[k];
+                auto const uEnd = cell.u1 == uResolution - 1 ? cell.u1 + 1 : cell.u1;
+                auto const vEnd = cell.v1 == vResolution - 1 ? cell.v1 + 1 : cell.v1;
+
+                for(auto i = cell.v0; i < vEnd; ++i)
+                {
+                    for(auto j = cell.u0; j < uEnd; ++j)
+                    {
+                        if(!computed[static_cast<std::size_t>(i) * uResolution + j])
+                        {
+                            tex[i][j] = Interpolate(cell, j, i);
+                        }
+                    }
+                }
+            });
         }
 
-        auto GetTexture() const -> Texture2D<Vector3> const&
+        // Reads the texture from the cache, or computes it and stores it there. Reports whether it was a hit, which
+        // leaves the evaluation count at zero.
+        auto ComputeFull(
+            TextureCache const& cache,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> bool
         {
-            return tex;
+            auto const key = GetFullCacheKey(viewZenithMapping, sunZenithMapping);
+            if(cache.Load(key, fullTex))
+            {
+                fullViewZenithMapping = viewZenithMapping;
+                fullSunZenithMapping = sunZenithMapping;
+                evaluationCount = 0;
+                return true;
+            }
+
+            ComputeFull(viewZenithMapping, sunZenithMapping);
+            cache.Store(key, fullTex);
+            return false;
         }
 
+        // Everything the fixed-altitude texture depends on.
+        [[nodiscard]]
+        auto GetCacheKey(Mapping const viewZenithMapping, Mapping const sunZenithMapping) const -> CacheKey
+        {
+            auto key = CacheKey("ScatteringMap");
+            key.Add(tex.GetUResolution()).Add(tex.GetVResolution()).Add(viewZenithMapping).Add(sunZenithMapping);
+            key.Add(transmittanceTable.GetCacheKey());
+            sParams.AddTo(key);
+            return key;
+        }
 
-    private:
+        // Everything a deferred table of the fixed-altitude texture depends on, which excludes the scattering
+        // coefficients and the Mie asymmetry.
+        [[nodiscard]]
+        auto GetDeferredCacheKey(
+            char const* const table,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping) const -> CacheKey
+        {
+            auto key = CacheKey(table);
+            key.Add(tex.GetUResolution()).Add(tex.GetVResolution()).Add(viewZenithMapping).Add(sunZenithMapping);
+            key.Add(transmittanceTable.GetMediumCacheKey());
+            sParams.AddTo(key);
+            return key;
+        }
 
+        // Everything the full table depends on.
         [[nodiscard]]
-        auto Calculate(float const viewZenithCos, float const sunZenithCos) const -> Vector3
+        auto GetFullCacheKey(Mapping const viewZenithMapping, Mapping const sunZenithMapping) const -> CacheKey
+        {
+            auto key = CacheKey("ScatteringMapFull");
+            key.Add(fullTex.GetUResolution()).Add(fullTex.GetVResolution()).Add(fullTex.GetWResolution())
+                .Add(fullTex.GetQResolution()).Add(viewZenithMapping).Add(sunZenithMapping);
+            key.Add(transmittanceTable.GetCacheKey());
+            sParams.AddTo(key);
+            return key;
+        }
+
+        // As GetDeferredCacheKey, for the deferred full tables.
+        [[nodiscard]]
+        auto GetFullDeferredCacheKey(
+            char const* const table,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping) const -> CacheKey
         {
-            auto const viewZenithSin = std::sin(std::acosf(viewZenithCos));
-            auto const sunZenithSin = std::sin(std::acosf(sunZenithCos));
-            
-            auto const viewDir = Vector3(viewZenithSin, viewZenithCos, 0.0f);
-            auto const sunDir = Vector3(
-                sunZenithSin, 
-                sunZenithCos, 
-                0.0f
-            );
+            auto key = CacheKey(table);
+            key.Add(fullTex.GetUResolution()).Add(fullTex.GetVResolution()).Add(fullTex.GetWResolution())
+                .Add(fullTex.GetQResolution()).Add(viewZenithMapping).Add(sunZenithMapping);
+            key.Add(transmittanceTable.GetMediumCacheKey());
+            sParams.AddTo(key);
+            return key;
+        }
 
-            auto const viewPathEnterPoint = Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * 0.95f, 0.0f);
-            Vector3 viewPathExitPoint;
+        // Bakes the full table: view zenith over the whole sphere, sun zenith, view-sun azimuth and observer altitude.
+        // With reuseViewSamples the view rays of every altitude are swept by all its rows, otherwise work is handed out
+        // in blocks of rows sharing an azimuth and altitude, and each row is traced as packets.
+        auto ComputeFull(
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> void
+        {
+            fullViewZenithMapping = viewZenithMapping;
+            fullSunZenithMapping = sunZenithMapping;
 
-            auto const planetTest = RayCircleIntersection(viewPathEnterPoint, viewDir, pp.GetPlanetRadius());
-            if(planetTest)
+            auto const viewResolution = fullTex.GetUResolution();
+            auto const sunResolution = fullTex.GetVResolution();
+            auto const azimuthResolution = fullTex.GetWResolution();
+            auto const altitudeResolution = fullTex.GetQResolution();
+
+            auto viewPathExitPoints = std::vector<Vector3>(viewResolution * altitudeResolution);
+            for(std::size_t q = 0; q < altitudeResolution; ++q)
             {
-                viewPathExitPoint = planetTest.value();
+                auto const viewPathEnterPoint = GetViewPathEnterPoint(QToAltitude(IndexToUnit(q, altitudeResolution)));
+                for(std::size_t j = 0; j < viewResolution; ++j)
+                {
+                    auto const viewZenithCos = UToFullViewZenithCos(viewZenithMapping, IndexToUnit(j, viewResolution));
+                    viewPathExitPoints[q * viewResolution + j]
+                        = GetViewPathExitPoint(viewPathEnterPoint, ZenithCosToDirection(viewZenithCos));
+                }
             }
-            else
+
+            if(sParams.kernel == Kernel::Packet && sParams.reuseViewSamples && Quadrature::HasNodes(sParams.rule))
             {
-                auto const atmoTest = RayCircleIntersection(viewPathEnterPoint, viewDir, pp.GetAtmosphereRadius());
-                if(atmoTest)
+                auto viewPathEnterPoints = std::vector<Vector3>(altitudeResolution);
+                for(std::size_t q = 0; q < altitudeResolution; ++q)
                 {
-                    viewPathExitPoint = atmoTest.value();
+                    viewPathEnterPoints[q] = GetViewPathEnterPoint(QToAltitude(IndexToUnit(q, altitudeResolution)));
+                }
+
+                // Rows of the same altitude, the azimuth varying slowest.
+                auto sunDirs = std::vector<Vector3>(sunResolution * azimuthResolution);
+                for(std::size_t k = 0; k < azimuthResolution; ++k)
+                {
+                    for(std::size_t i = 0; i < sunResolution; ++i)
+                    {
+                        sunDirs[k * sunResolution + i] = ZenithAzimuthCosToDirection(
+                            VToSunZenithCos(sunZenithMapping, IndexToUnit(i, sunResolution)),
+                            WToSunAzimuthCos(IndexToUnit(k, azimuthResolution)));
+                    }
+                }
+
+                evaluationCount = SweepViewRays(viewPathEnterPoints, viewPathExitPoints, sunDirs,
+                    [&](std::size_t const q, std::size_t const sun, std::size_t const j, Vector3 const& texel)
+                    {
+                        fullTex[q][sun / sunResolution][sun % sunResolution][j] = texel;
+                    });
+                return;
+            }
+
+            auto const rowCount = static_cast<int>(sunResolution * azimuthResolution * altitudeResolution);
+            evaluationCount = Scheduler::ForEach(rowCount, 1, [&](int const row)
+            {
+                auto const i = static_cast<std::size_t>(row) % sunResolution;
+                auto const k = static_cast<std::size_t>(row) / sunResolution % azimuthResolution;
+                auto const q = static_cast<std::size_t>(row) / sunResolution / azimuthResolution;
+
+                auto const viewPathEnterPoint = GetViewPathEnterPoint(QToAltitude(IndexToUnit(q, altitudeResolution)));
+                auto const sunDir = ZenithAzimuthCosToDirection(
+                    VToSunZenithCos(sunZenithMapping, IndexToUnit(i, sunResolution)),
+                    WToSunAzimuthCos(IndexToUnit(k, azimuthResolution)));
+                auto const exitPoints = viewPathExitPoints.data() + q * viewResolution;
+
+                if(sParams.kernel == Kernel::Packet && fullTex.GetLayout() == TextureLayout::Linear)
+                {
+                    Scattering::GetPathScatteringPacket(viewPathEnterPoint, exitPoints, static_cast<int>(viewResolution),
+                        sunDir, transmittanceTable, sParams, fullTex.data() + fullTex.Offset(0, i, k, q));
+                }
+                else if(sParams.kernel == Kernel::Packet)
+                {
+                    auto texels = std::vector<Vector3>(viewResolution);
+                    Scattering::GetPathScatteringPacket(viewPathEnterPoint, exitPoints, static_cast<int>(viewResolution),
+                        sunDir, transmittanceTable, sParams, texels.data());
+
+                    for(std::size_t j = 0; j < viewResolution; ++j)
+                    {
+                        fullTex[q][k][i][j] = texels[j];
+                    }
                 }
                 else
                 {
-                    throw;
+                    for(std::size_t j = 0; j < viewResolution; ++j)
+                    {
+                        fullTex[q][k][i][j] = Scattering::GetPathScattering(viewPathEnterPoint, exitPoints[j], sunDir,
+                            transmittanceTable, sParams);
+                    }
+                }
+            });
+        }
+
+        // The full table counterpart of ComputeDeferred. GetScattering can then also apply the phase functions per
+        // lookup, which keeps the Mie peak sharper than interpolating the resolved table does.
+        auto ComputeFullDeferred(
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> void
+        {
+            fullViewZenithMapping = viewZenithMapping;
+            fullSunZenithMapping = sunZenithMapping;
+
+            auto const viewResolution = fullTex.GetUResolution();
+            auto const sunResolution = fullTex.GetVResolution();
+            auto const azimuthResolution = fullTex.GetWResolution();
+            auto const altitudeResolution = fullTex.GetQResolution();
+
+            fullRayleightTex = Texture4D<Vector3>(viewResolution, sunResolution, azimuthResolution, altitudeResolution);
+            fullMieTex = Texture4D<Vector3>(viewResolution, sunResolution, azimuthResolution, altitudeResolution);
+
+            auto viewPathEnterPoints = std::vector<Vector3>(altitudeResolution);
+            auto viewPathExitPoints = std::vector<Vector3>(viewResolution * altitudeResolution);
+            for(std::size_t q = 0; q < altitudeResolution; ++q)
+            {
+                viewPathEnterPoints[q] = GetViewPathEnterPoint(QToAltitude(IndexToUnit(q, altitudeResolution)));
+                for(std::size_t j = 0; j < viewResolution; ++j)
+                {
+                    auto const viewZenithCos = UToFullViewZenithCos(viewZenithMapping, IndexToUnit(j, viewResolution));
+                    viewPathExitPoints[q * viewResolution + j]
+                        = GetViewPathExitPoint(viewPathEnterPoints[q], ZenithCosToDirection(viewZenithCos));
                 }
             }
 
-            return Scattering::GetPathScattering(viewPathEnterPoint, viewPathExitPoint, sunDir, pp, tParams, sParams);
+            auto sunDirs = std::vector<Vector3>(sunResolution * azimuthResolution);
+            for(std::size_t k = 0; k < azimuthResolution; ++k)
+            {
+                for(std::size_t i = 0; i < sunResolution; ++i)
+                {
+                    sunDirs[k * sunResolution + i] = ZenithAzimuthCosToDirection(
+                        VToSunZenithCos(sunZenithMapping, IndexToUnit(i, sunResolution)),
+                        WToSunAzimuthCos(IndexToUnit(k, azimuthResolution)));
+                }
+            }
+
+            evaluationCount = SweepViewRayIntegrals(viewPathEnterPoints, viewPathExitPoints, sunDirs,
+                [&](std::size_t const q, std::size_t const sun, std::size_t const j, Vector3 const& rayleight,
+                    Vector3 const& mie)
+                {
+                    fullRayleightTex[q][sun / sunResolution][sun % sunResolution][j] = rayleight;
+                    fullMieTex[q][sun / sunResolution][sun % sunResolution][j] = mie;
+                });
+
+            Resolve(pp);
+        }
+
+        // Reads the deferred full tables from the cache, or computes them and stores them there, and resolves the
+        // full table.
+        auto ComputeFullDeferred(
+            TextureCache const& cache,
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> bool
+        {
+            auto const rayleightKey = GetFullDeferredCacheKey("ScatteringMapFullRayleight", viewZenithMapping, sunZenithMapping);
+            auto const mieKey = GetFullDeferredCacheKey("ScatteringMapFullMie", viewZenithMapping, sunZenithMapping);
+
+            fullRayleightTex = Texture4D<Vector3>(fullTex.GetUResolution(), fullTex.GetVResolution(),
+                fullTex.GetWResolution(), fullTex.GetQResolution());
+            fullMieTex = Texture4D<Vector3>(fullTex.GetUResolution(), fullTex.GetVResolution(),
+                fullTex.GetWResolution(), fullTex.GetQResolution());
+            if(cache.Load(rayleightKey, fullRayleightTex) && cache.Load(mieKey, fullMieTex))
+            {
+                fullViewZenithMapping = viewZenithMapping;
+                fullSunZenithMapping = sunZenithMapping;
+                evaluationCount = 0;
+                Resolve(pp);
+                return true;
+            }
+
+            ComputeFullDeferred(viewZenithMapping, sunZenithMapping);
+            cache.Store(rayleightKey, fullRayleightTex);
+            cache.Store(mieKey, fullMieTex);
+            return false;
+        }
+
+        auto GetTexture() const -> Texture2D<Vector3> const&
+        {
+            return tex;
+        }
+
+        [[nodiscard]]
+        auto GetFullTexture() const -> Texture4D<Vector3> const&
+        {
+            return fullTex;
+        }
+
+        // Whether ComputeFullDeferred has filled the deferred full tables, which the GetScattering overloads taking
+        // planet properties read rather than the table of ComputeFull.
+        [[nodiscard]]
+        auto HasFullDeferredTables() const -> bool
+        {
+            return fullRayleightTex.GetSize() > 0;
+        }
+
+        // Single scattering towards an observer at the given altitude, read from the table baked by ComputeFull.
+        // The azimuth cosine is measured between the horizontal projections of the view and sun directions.
+        [[nodiscard]]
+        auto GetScattering(
+            float const altitude,
+            float const viewZenithCos,
+            float const sunZenithCos,
+            float const sunAzimuthCos) const -> Vector3
+        {
+            auto const u = std::clamp(FullViewZenithCosToU(fullViewZenithMapping, viewZenithCos), 0.0f, 1.0f);
+            auto const v = std::clamp(SunZenithCosToV(fullSunZenithMapping, sunZenithCos), 0.0f, 1.0f);
+            auto const w = std::clamp(SunAzimuthCosToW(sunAzimuthCos), 0.0f, 1.0f);
+            auto const q = std::clamp(AltitudeToQ(altitude), 0.0f, 1.0f);
+
+            return fullTex.Sample(u, v, w, q);
+        }
+
+        // As above, but read from the deferred tables of ComputeFullDeferred with the phase functions and scattering
+        // coefficients of look applied to the interpolated integrals, so they can change from one pixel to the next.
+        // Without deferred tables look is ignored and the table of ComputeFull is read.
+        [[nodiscard]]
+        auto GetScattering(
+            float const altitude,
+            float const viewZenithCos,
+            float const sunZenithCos,
+            float const sunAzimuthCos,
+            PlanetProperties const& look) const -> Vector3
+        {
+            if(!HasFullDeferredTables())
+            {
+                return GetScattering(altitude, viewZenithCos, sunZenithCos, sunAzimuthCos);
+            }
+
+            auto const u = std::clamp(FullViewZenithCosToU(fullViewZenithMapping, viewZenithCos), 0.0f, 1.0f);
+            auto const v = std::clamp(SunZenithCosToV(fullSunZenithMapping, sunZenithCos), 0.0f, 1.0f);
+            auto const w = std::clamp(SunAzimuthCosToW(sunAzimuthCos), 0.0f, 1.0f);
+            auto const q = std::clamp(AltitudeToQ(altitude), 0.0f, 1.0f);
+
+            auto const viewSunCos = Dot(ZenithCosToDirection(viewZenithCos),
+                ZenithAzimuthCosToDirection(sunZenithCos, std::clamp(sunAzimuthCos, -1.0f, 1.0f)));
+            return Scattering::ApplyPhase(fullRayleightTex.Sample(u, v, w, q), fullMieTex.Sample(u, v, w, q),
+                viewSunCos, look);
         }
 
+        // GetScattering for count queries at once, for lighting code that makes many lookups. The queries are mapped
+        // to coordinates of the full table with its own parameterizations and filtered by TextureSampler.
+        auto GetScattering(
+            std::size_t const count,
+            float const* const altitudes,
+            float const* const viewZenithCos,
+            float const* const sunZenithCos,
+            float const* const sunAzimuthCos,
+            Vector3* const scattering) const -> void
+        {
+            ForEachQueryBlock(count, altitudes, viewZenithCos, sunZenithCos, sunAzimuthCos,
+                [&](std::size_t const first, std::size_t const blockCount, QueryCoordinates const& c)
+                {
+                    TextureSampler::Sample(fullTex.GetView(), blockCount, c.u, c.v, c.w, c.q, scattering + first);
+                });
+        }
+
+        // As above, but read from the deferred tables with the phase functions and scattering coefficients of look,
+        // or from the table of ComputeFull without them.
+        auto GetScattering(
+            std::size_t const count,
+            float const* const altitudes,
+            float const* const viewZenithCos,
+            float const* const sunZenithCos,
+            float const* const sunAzimuthCos,
+            PlanetProperties const& look,
+            Vector3* const scattering) const -> void
+        {
+            if(!HasFullDeferredTables())
+            {
+                GetScattering(count, altitudes, viewZenithCos, sunZenithCos, sunAzimuthCos, scattering);
+                return;
+            }
+
+            ForEachQueryBlock(count, altitudes, viewZenithCos, sunZenithCos, sunAzimuthCos,
+                [&](std::size_t const first, std::size_t const blockCount, QueryCoordinates const& c)
+                {
+                    Vector3 rayleight[QueryBlockSize];
+                    Vector3 mie[QueryBlockSize];
+                    TextureSampler::Sample(fullRayleightTex.GetView(), blockCount, c.u, c.v, c.w, c.q, rayleight);
+                    TextureSampler::Sample(fullMieTex.GetView(), blockCount, c.u, c.v, c.w, c.q, mie);
+
+                    for(std::size_t i = 0; i < blockCount; ++i)
+                    {
+                        auto const viewSunCos = Dot(ZenithCosToDirection(viewZenithCos[first + i]),
+                            ZenithAzimuthCosToDirection(sunZenithCos[first + i],
+                                std::clamp(sunAzimuthCos[first + i], -1.0f, 1.0f)));
+                        scattering[first + i] = Scattering::ApplyPhase(rayleight[i], mie[i], viewSunCos, look);
+                    }
+                });
+        }
+
+        // Density evaluations made by the last Compute, summed over all threads.
+        [[nodiscard]]
+        auto GetEvaluationCount() const -> std::int64_t
+        {
+            return evaluationCount;
+        }
+
+        // Texels integrated by the last ComputeAdaptive, the others having been interpolated.
+        [[nodiscard]]
+        auto GetComputedTexelCount() const -> std::int64_t
+        {
+            return computedTexelCount;
+        }
+
+        // Parameterizations of the tables, public so that callers sampling GetTexture or GetFullTexture themselves
+        // map their queries the way the tables were computed. The *ToU, *ToV, *ToW and AltitudeToQ functions leave
+        // clamping to [0, 1] to the caller.
+        //
+        // The observer stays a small margin inside the atmosphere so no view path degenerates to a point.
+        // Altitudes are spaced quadratically, denser near the ground where the sky changes fastest.
+        [[nodiscard]]
+        auto QToAltitude(float const q) const -> float
+        {
+            // Q				[0,  1]
+            // Altitude			[margin, height - margin]
+            auto const margin = AltitudeMargin * pp.GetAtmosphereHeight();
+            return margin + (pp.GetAtmosphereHeight() - 2.0f * margin) * q * q;
+        }
+
+        [[nodiscard]]
+        auto AltitudeToQ(float const altitude) const -> float
+        {
+            auto const margin = AltitudeMargin * pp.GetAtmosphereHeight();
+            return std::sqrtf(std::max(0.0f, (altitude - margin) / (pp.GetAtmosphereHeight() - 2.0f * margin)));
+        }
+
+        [[nodiscard]]
+        auto static UToFullViewZenithCos(Mapping const mapping, float const u) -> float
+        {
+            // U				[0,  1]
+            // ViewZenith		[1, -1]
+
+            auto const t = 1.0f - 2.0f * u;
+            switch(mapping)
+            {
+            case Mapping::Linear:
+                return t;
+            case Mapping::Cubic:
+                return t * t * t;
+            }
+            return 0.0f;
+        }
+
+        [[nodiscard]]
+        auto static FullViewZenithCosToU(Mapping const mapping, float const viewZenithCos) -> float
+        {
+            switch(mapping)
+            {
+            case Mapping::Linear:
+                return (1.0f - viewZenithCos) / 2.0f;
+            case Mapping::Cubic:
+                return (1.0f - std::cbrtf(viewZenithCos)) / 2.0f;
+            }
+            return 0.0f;
+        }
+
+        [[nodiscard]]
         auto static UToViewZenithCos(Mapping const mapping, float const u) -> float
         {
             // U				[0,  1]
@@ -113,6 +926,7 @@ namespace Atmos
             return 0.0f;
         }
 
+        [[nodiscard]]
         auto static ViewZenithCosToU(Mapping const mapping, float const viewZenithCos) -> float
         {
             switch(mapping)
@@ -120,46 +934,322 @@ namespace Atmos
             case Mapping::Linear:
                 return -viewZenithCos;
             case Mapping::Cubic:
-                return -std::powf(viewZenithCos, 1.0f / 3.0f);
+                return std::cbrtf(-viewZenithCos);
             }
             return 0.0f;
         }
 
+        [[nodiscard]]
         auto static VToSunZenithCos(Mapping const mapping, float const v) -> float
         {
             // V				[0,  1]
             // SunZenith		[1, -1]
 
+            auto const t = 1.0f - 2.0f * v;
             switch(mapping)
             {
             case Mapping::Linear:
-                return 1.0f - 2.0f * v;
+                return t;
+            case Mapping::Cubic:
+                return t * t * t;
             }
             return 0.0f;
         }
 
-        auto static SunZenithCosToV(Mapping const mapping, float const viewZenithCos) -> float
+        [[nodiscard]]
+        auto static SunZenithCosToV(Mapping const mapping, float const sunZenithCos) -> float
         {
             switch(mapping)
             {
             case Mapping::Linear:
-                return (1.0f - viewZenithCos) / 2.0f;
+                return (1.0f - sunZenithCos) / 2.0f;
+            case Mapping::Cubic:
+                return (1.0f - std::cbrtf(sunZenithCos)) / 2.0f;
             }
             return 0.0f;
         }
 
-        auto static WToSunAzimuthCos(float const v) -> float
+        [[nodiscard]]
+        auto static WToSunAzimuthCos(float const w) -> float
         {
-            // V				[0,  1]
+            // W				[0,  1]
             // SunAzimuth		[1, -1]
-            return 1.0f - 2.0f * v;
-
+            return 1.0f - 2.0f * w;
         }
 
+        [[nodiscard]]
         auto static SunAzimuthCosToW(float const sunAzimuthCos) -> float
         {
             return (1.0f - sunAzimuthCos) / 2.0f;
         }
+
+    private:
+        // Texel rectangle of ComputeAdaptive, corners included.
+        struct Cell final
+        {
+            int u0;
+            int v0;
+            int u1;
+            int v1;
+        };
+
+        // Queries of the bulk GetScattering are mapped to table coordinates this many at a time.
+        static constexpr std::size_t QueryBlockSize = 256;
+
+        struct QueryCoordinates final
+        {
+            float u[QueryBlockSize];
+            float v[QueryBlockSize];
+            float w[QueryBlockSize];
+            float q[QueryBlockSize];
+        };
+
+        template <typename Function>
+        auto ForEachQueryBlock(
+            std::size_t const count,
+            float const* const altitudes,
+            float const* const viewZenithCos,
+            float const* const sunZenithCos,
+            float const* const sunAzimuthCos,
+            Function const& function) const -> void
+        {
+            QueryCoordinates coordinates;
+            for(std::size_t first = 0; first < count; first += QueryBlockSize)
+            {
+                auto const blockCount = std::min(count - first, QueryBlockSize);
+                for(std::size_t i = 0; i < blockCount; ++i)
+                {
+                    coordinates.u[i] = FullViewZenithCosToU(fullViewZenithMapping, viewZenithCos[first + i]);
+                    coordinates.v[i] = SunZenithCosToV(fullSunZenithMapping, sunZenithCos[first + i]);
+                    coordinates.w[i] = SunAzimuthCosToW(sunAzimuthCos[first + i]);
+                    coordinates.q[i] = AltitudeToQ(altitudes[first + i]);
+                }
+
+                function(first, blockCount, coordinates);
+            }
+        }
+
+        [[nodiscard]]
+        auto Interpolate(Cell const& cell, int const j, int const i) const -> Vector3
+        {
+            auto const tu = cell.u1 > cell.u0 ? static_cast<float>(j - cell.u0) / static_cast<float>(cell.u1 - cell.u0) : 0.0f;
+            auto const tv = cell.v1 > cell.v0 ? static_cast<float>(i - cell.v0) / static_cast<float>(cell.v1 - cell.v0) : 0.0f;
+
+            return Lerp(
+                Lerp(tex[cell.v0][cell.u0], tex[cell.v0][cell.u1], tu),
+                Lerp(tex[cell.v1][cell.u0], tex[cell.v1][cell.u1], tu),
+                tv);
+        }
+
+        // Every row shares the view rays, so their exit points are found once and each row is traced as packets, or
+        // the samples of the view rays are traced once and swept by every row.
+        auto ComputePackets(
+            Mapping const viewZenithMapping,
+            Mapping const sunZenithMapping
+        ) -> void
+        {
+            auto const viewPathEnterPoint = GetViewPathEnterPoint();
+
+            auto viewPathExitPoints = std::vector<Vector3>(tex.GetUResolution());
+            for(std::size_t j = 0; j < tex.GetUResolution(); ++j)
+            {
+                auto const viewZenithCos = UToViewZenithCos(viewZenithMapping, tex.IndexToU(j));
+                viewPathExitPoints[j] = GetViewPathExitPoint(viewPathEnterPoint, ZenithCosToDirection(viewZenithCos));
+            }
+
+            if(sParams.reuseViewSamples && Quadrature::HasNodes(sParams.rule))
+            {
+                auto sunDirs = std::vector<Vector3>(tex.GetVResolution());
+                for(std::size_t i = 0; i < tex.GetVResolution(); ++i)
+                {
+                    sunDirs[i] = ZenithCosToDirection(VToSunZenithCos(sunZenithMapping, tex.IndexToV(i)));
+                }
+
+                evaluationCount = SweepViewRays({ viewPathEnterPoint }, viewPathExitPoints, sunDirs,
+                    [&](std::size_t, std::size_t const i, std::size_t const j, Vector3 const& texel)
+                    {
+                        tex[i][j] = texel;
+                    });
+                return;
+            }
+
+            evaluationCount = Scheduler::ForEach(static_cast<int>(tex.GetVResolution()), 1, [&](int const i)
+            {
+                auto const v = tex.IndexToV(i);
+                auto const sunDir = ZenithCosToDirection(VToSunZenithCos(sunZenithMapping, v));
+
+                auto const resolution = static_cast<int>(tex.GetUResolution());
+                if(tex.GetLayout() == TextureLayout::Linear)
+                {
+                    Scattering::GetPathScatteringPacket(viewPathEnterPoint, viewPathExitPoints.data(),
+                        resolution, sunDir, transmittanceTable, sParams, tex.data() + tex.Offset(0, i));
+                }
+                else
+                {
+                    auto row = std::vector<Vector3>(resolution);
+                    Scattering::GetPathScatteringPacket(viewPathEnterPoint, viewPathExitPoints.data(),
+                        resolution, sunDir, transmittanceTable, sParams, row.data());
+
+                    for(std::size_t j = 0; j < row.size(); ++j)
+                    {
+                        tex[i][j] = row[j];
+                    }
+                }
+            });
+        }
+
+        // Sweeps the sun directions over the view rays from each origin, exitPoints holding the rays of one origin
+        // after the other. Store receives the origin, sun and ray indices of every texel. Returns the evaluation count.
+        template <typename Store>
+        auto SweepViewRays(
+            std::vector<Vector3> const& enterPoints,
+            std::vector<Vector3> const& exitPoints,
+            std::vector<Vector3> const& sunDirs,
+            Store const& store) const -> std::int64_t
+        {
+            return ForEachSweepBlock(enterPoints, exitPoints, sunDirs,
+                [&](std::size_t const origin, int const firstView, int const views, int const firstSun, int const suns)
+                {
+                    auto texels = std::vector<Vector3>(static_cast<std::size_t>(suns) * views);
+                    Scattering::GetPathScatteringSweep(enterPoints[origin],
+                        exitPoints.data() + origin * (exitPoints.size() / enterPoints.size()) + firstView, views,
+                        sunDirs.data() + firstSun, suns, transmittanceTable, sParams, texels.data());
+
+                    for(auto sun = 0; sun < suns; ++sun)
+                    {
+                        for(auto j = 0; j < views; ++j)
+                        {
+                            store(origin, static_cast<std::size_t>(firstSun + sun), static_cast<std::size_t>(firstView + j),
+                                texels[static_cast<std::size_t>(sun) * views + j]);
+                        }
+                    }
+                });
+        }
+
+        // As SweepViewRays, storing the Rayleigh and Mie integrals of every texel.
+        template <typename Store>
+        auto SweepViewRayIntegrals(
+            std::vector<Vector3> const& enterPoints,
+            std::vector<Vector3> const& exitPoints,
+            std::vector<Vector3> const& sunDirs,
+            Store const& store) const -> std::int64_t
+        {
+            return ForEachSweepBlock(enterPoints, exitPoints, sunDirs,
+                [&](std::size_t const origin, int const firstView, int const views, int const firstSun, int const suns)
+                {
+                    auto rayleight = std::vector<Vector3>(static_cast<std::size_t>(suns) * views);
+                    auto mie = std::vector<Vector3>(static_cast<std::size_t>(suns) * views);
+                    Scattering::GetPathScatteringIntegralsSweep(enterPoints[origin],
+                        exitPoints.data() + origin * (exitPoints.size() / enterPoints.size()) + firstView, views,
+                        sunDirs.data() + firstSun, suns, transmittanceTable, sParams, rayleight.data(), mie.data());
+
+                    for(auto sun = 0; sun < suns; ++sun)
+                    {
+                        for(auto j = 0; j < views; ++j)
+                        {
+                            auto const texel = static_cast<std::size_t>(sun) * views + j;
+                            store(origin, static_cast<std::size_t>(firstSun + sun), static_cast<std::size_t>(firstView + j),
+                                rayleight[texel], mie[texel]);
+                        }
+                    }
+                });
+        }
+
+        // Work of the sweeps is handed out as blocks of rays and of sun directions so that there is enough of it for
+        // every thread, which traces the samples of a block of rays once per block of sun directions. Block receives
+        // the origin, first ray, ray count, first sun direction and sun direction count of each.
+        template <typename Block>
+        auto ForEachSweepBlock(
+            std::vector<Vector3> const& enterPoints,
+            std::vector<Vector3> const& exitPoints,
+            std::vector<Vector3> const& sunDirs,
+            Block const& block) const -> std::int64_t
+        {
+            constexpr auto ViewBlockSize = 16;
+            constexpr auto SunBlockSize = 32;
+
+            auto const viewCount = static_cast<int>(exitPoints.size() / enterPoints.size());
+            auto const sunCount = static_cast<int>(sunDirs.size());
+            auto const viewBlockCount = (viewCount + ViewBlockSize - 1) / ViewBlockSize;
+            auto const sunBlockCount = (sunCount + SunBlockSize - 1) / SunBlockSize;
+            auto const blockCount = static_cast<int>(enterPoints.size()) * viewBlockCount * sunBlockCount;
+            return Scheduler::ForEach(blockCount, 1, [&](int const index)
+            {
+                auto const firstSun = index % sunBlockCount * SunBlockSize;
+                auto const firstView = index / sunBlockCount % viewBlockCount * ViewBlockSize;
+                auto const origin = static_cast<std::size_t>(index / sunBlockCount / viewBlockCount);
+
+                block(origin, firstView, std::min(ViewBlockSize, viewCount - firstView), firstSun,
+                    std::min(SunBlockSize, sunCount - firstSun));
+            });
+        }
+
+        [[nodiscard]]
+        auto Calculate(float const viewZenithCos, float const sunZenithCos) const -> Vector3
+        {
+            auto const viewDir = ZenithCosToDirection(viewZenithCos);
+            auto const sunDir = ZenithCosToDirection(sunZenithCos);
+
+            auto const viewPathEnterPoint = GetViewPathEnterPoint();
+            auto const viewPathExitPoint = GetViewPathExitPoint(viewPathEnterPoint, viewDir);
+
+            return Scattering::GetPathScattering(viewPathEnterPoint, viewPathExitPoint, sunDir, transmittanceTable, sParams);
+        }
+
+        [[nodiscard]]
+        auto GetViewPathEnterPoint() const -> Vector3
+        {
+            return GetViewPathEnterPoint(pp.GetAtmosphereHeight() * 0.95f);
+        }
+
+        [[nodiscard]]
+        auto GetViewPathEnterPoint(float const altitude) const -> Vector3
+        {
+            return Vector3(0.0f, pp.GetPlanetRadius() + altitude, 0.0f);
+        }
+
+        [[nodiscard]]
+        auto GetViewPathExitPoint(Vector3 const& viewPathEnterPoint, Vector3 const& viewDir) const -> Vector3
+        {
+            auto const planetTest = RayCircleIntersection(viewPathEnterPoint, viewDir, pp.GetPlanetRadius());
+            if(planetTest)
+            {
+                return planetTest.value();
+            }
+
+            auto const atmoTest = RayCircleIntersection(viewPathEnterPoint, viewDir, pp.GetAtmosphereRadius());
+            if(atmoTest)
+            {
+                return atmoTest.value();
+            }
+
+            throw;
+        }
+
+        [[nodiscard]]
+        auto static ZenithCosToDirection(float const zenithCos) -> Vector3
+        {
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+            return Vector3(zenithSin, zenithCos, 0.0f);
+        }
+
+        // The sun is rotated around the zenith away from the view plane (z = 0) by the azimuth.
+        [[nodiscard]]
+        auto static ZenithAzimuthCosToDirection(float const zenithCos, float const azimuthCos) -> Vector3
+        {
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+            auto const azimuthSin = std::sqrtf(std::max(0.0f, 1.0f - azimuthCos * azimuthCos));
+            return Vector3(zenithSin * azimuthCos, zenithCos, zenithSin * azimuthSin);
+        }
+
+        // Texture4D::Sample places texel i at i / (resolution - 1), so texels are computed at the same coordinates.
+        [[nodiscard]]
+        auto static IndexToUnit(std::size_t const index, std::size_t const resolution) -> float
+        {
+            return resolution > 1 ? static_cast<float>(index) / static_cast<float>(resolution - 1) : 0.0f;
+        }
+
+        float static constexpr AltitudeMargin = 1e-3f;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#include "Quadrature.hpp"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace Atmos
+{
+    // Work stealing over the OpenMP threads, shared by every map builder. Each thread starts with an equal contiguous
+    // range of tasks, the same split as the static schedule that first touches the textures, so on NUMA systems a
+    // thread mostly writes pages of its own node. A thread whose range runs dry steals the back half of the range of
+    // another, so the expensive tasks, rays that reach the ground or a sun below the horizon, no longer leave cores
+    // idle at the end.
+    //
+    // Every call returns the density evaluations its tasks made, summed per thread from Quadrature::EvaluationCount.
+    // Called from inside a parallel region, tasks run one after another on the calling thread.
+    class Scheduler final
+    {
+    public:
+        // Half-open box of a grid of work items.
+        struct Tile final
+        {
+            int u0;
+            int v0;
+            int w0;
+            int u1;
+            int v1;
+            int w1;
+        };
+
+        // Calls function(item) for every item of [0, count), grain consecutive items making up a task.
+        template <typename Function>
+        static auto ForEach(int const count, int const grain, Function const& function) -> std::int64_t
+        {
+            auto const taskCount = (count + grain - 1) / grain;
+            return Run(taskCount, [&](int const task)
+            {
+                auto const last = std::min(count, (task + 1) * grain);
+                for(auto item = task * grain; item < last; ++item)
+                {
+                    function(item);
+                }
+            });
+        }
+
+        // Calls function(tile) for tiles of uTile x vTile x wTile items covering the grid, u varying fastest. Tiles
+        // are numbered in the order of the texels, so the range a thread starts with covers the texels it touched
+        // first.
+        template <typename Function>
+        static auto ForEachTile(
+            int const uCount,
+            int const vCount,
+            int const wCount,
+            int const uTile,
+            int const vTile,
+            int const wTile,
+            Function const& function) -> std::int64_t
+        {
+            auto const uTiles = (uCount + uTile - 1) / uTile;
+            auto const vTiles = (vCount + vTile - 1) / vTile;
+            auto const wTiles = (wCount + wTile - 1) / wTile;
+
+            return Run(uTiles * vTiles * wTiles, [&](int const task)
+            {
+                auto const u = task % uTiles * uTile;
+                auto const v = task / uTiles % vTiles * vTile;
+                auto const w = task / uTiles / vTiles * wTile;
+
+                function(Tile{ u, v, w, std::min(u + uTile, uCount), std::min(v + vTile, vCount), std::min(w + wTile, wCount) });
+            });
+        }
+
+        template <typename Function>
+        static auto ForEachTile(int const uCount, int const vCount, int const uTile, int const vTile, Function const& function)
+            -> std::int64_t
+        {
+            return ForEachTile(uCount, vCount, 1, uTile, vTile, 1, function);
+        }
+
+        // Pins the threads to one logical processor each, thread i to processor i, which keeps the operating system
+        // from moving them away from the pages they touched. Off unless ATMOS_PIN_THREADS is set to 1.
+        static auto SetThreadPinning(bool const enabled) -> void
+        {
+            ThreadPinning() = enabled;
+        }
+
+        [[nodiscard]]
+        static auto GetThreadPinning() -> bool
+        {
+            return ThreadPinning();
+        }
+
+    private:
+        // Begin and end of the remaining range of a thread, packed so that owner and thieves update both at once. One
+        // cache line per queue keeps their updates from invalidating each other.
+        struct alignas(64) Queue final
+        {
+            std::atomic<std::uint64_t> range;
+        };
+
+        template <typename Function>
+        static auto Run(int const taskCount, Function const& task) -> std::int64_t
+        {
+            auto const evaluationsBefore = Quadrature::EvaluationCount();
+
+#if defined(_OPENMP)
+            auto const threadCount = std::min(omp_get_max_threads(), taskCount);
+            if(threadCount > 1 && !omp_in_parallel())
+            {
+                auto queues = std::vector<Queue>(static_cast<std::size_t>(threadCount));
+                for(auto t = 0; t < threadCount; ++t)
+                {
+                    auto const begin = static_cast<std::int64_t>(taskCount) * t / threadCount;
+                    auto const end = static_cast<std::int64_t>(taskCount) * (t + 1) / threadCount;
+                    queues[t].range.store(Pack(static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end)));
+                }
+
+                auto evaluations = std::int64_t(0);
+
+                #pragma omp parallel num_threads(threadCount) reduction(+ : evaluations)
+                {
+                    auto const threadEvaluationsBefore = Quadrature::EvaluationCount();
+                    auto const thread = omp_get_thread_num();
+                    if(ThreadPinning())
+                    {
+                        PinThread(thread);
+                    }
+
+                    // A team smaller than asked for leaves queues without an owner, which the others steal from.
+                    auto index = 0;
+                    while(Pop(queues[thread], index) || Steal(queues, thread, index))
+                    {
+                        task(index);
+                    }
+
+                    evaluations += Quadrature::EvaluationCount() - threadEvaluationsBefore;
+                }
+
+                return evaluations;
+            }
+#endif
+
+            for(auto index = 0; index < taskCount; ++index)
+            {
+                task(index);
+            }
+            return Quadrature::EvaluationCount() - evaluationsBefore;
+        }
+
+        [[nodiscard]]
+        static auto Pack(std::uint32_t const begin, std::uint32_t const end) -> std::uint64_t
+        {
+            return static_cast<std::uint64_t>(end) << 32 | begin;
+        }
+
+        [[nodiscard]]
+        static auto Begin(std::uint64_t const range) -> std::uint32_t
+        {
+            return static_cast<std::uint32_t>(range);
+        }
+
+        [[nodiscard]]
+        static auto End(std::uint64_t const range) -> std::uint32_t
+        {
+            return static_cast<std::uint32_t>(range >> 32);
+        }
+
+        // Takes the first task of the range.
+        static auto Pop(Queue& queue, int& index) -> bool
+        {
+            auto range = queue.range.load();
+            while(Begin(range) < End(range))
+            {
+                if(queue.range.compare_exchange_weak(range, Pack(Begin(range) + 1, End(range))))
+                {
+                    index = static_cast<int>(Begin(range));
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Moves the back half of the first non-empty range after the thread's own into its own, which is empty, and
+        // takes the first task of it. Only owners refill a range, so a thief never overwrites tasks.
+        static auto Steal(std::vector<Queue>& queues, int const thread, int& index) -> bool
+        {
+            auto const count = static_cast<int>(queues.size());
+            for(auto offset = 1; offset < count; ++offset)
+            {
+                auto& victim = queues[(thread + offset) % count].range;
+                auto range = victim.load();
+                while(Begin(range) < End(range))
+                {
+                    auto const middle = End(range) - (End(range) - Begin(range) + 1) / 2;
+                    if(victim.compare_exchange_weak(range, Pack(Begin(range), middle)))
+                    {
+                        index = static_cast<int>(middle);
+                        queues[thread].range.store(Pack(middle + 1, End(range)));
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        [[nodiscard]]
+        static auto ThreadPinning() -> bool&
+        {
+            static auto enabled = GetPinningOverride() == "1";
+            return enabled;
+        }
+
+        static auto PinThread(int const thread) -> void
+        {
+#if defined(_WIN32)
+            auto const processorCount = static_cast<int>(std::min<DWORD>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS), 64));
+            SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (thread % processorCount));
+#elif defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(static_cast<int>(static_cast<unsigned>(thread) % std::max(1u, std::thread::hardware_concurrency())), &set);
+            sched_setaffinity(0, sizeof set, &set);
+#else
+            static_cast<void>(thread);
+#endif
+        }
+
+        // Value of the ATMOS_PIN_THREADS environment variable, empty when it is not set.
+        [[nodiscard]]
+        static auto GetPinningOverride() -> std::string
+        {
+#if defined(_MSC_VER)
+            char* value = nullptr;
+            std::size_t size = 0;
+            if(_dupenv_s(&value, &size, "ATMOS_PIN_THREADS") != 0 || value == nullptr)
+            {
+                return {};
+            }
+
+            auto const text = std::string(value);
+            std::free(value);
+            return text;
+#else
+            auto const value = std::getenv("ATMOS_PIN_THREADS");
+            return value ? std::string(value) : std::string();
+#endif
+        }
+    };
+}
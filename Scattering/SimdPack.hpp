@@ -0,0 +1,678 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Vector3.hpp"
+#include "CpuFeatures.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATMOS_SIMD_SSE2 1
+// The AVX-512 intrinsics of GCC 12 leave a vector undefined on purpose, which it reports once they are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#endif
+
+// MSVC accepts the intrinsics of every instruction set whatever the target, so on x64 all packs are compiled and the
+// widest one the processor supports is picked at run time. GCC and Clang compile the wider packs with target
+// attributes instead, and Dispatch runs the kernels through trampolines of the same target that inline them whole.
+// The GCC trampolines do not contract into FMAs, which AVX-512 implies, so that the kernels round as the scalar code
+// and MSVC do; Clang builds need -ffp-contract=off for that. Other compilers only get the packs their flags enable.
+#if defined(_MSC_VER) && defined(_M_X64)
+#define ATMOS_SIMD_AVX2 1
+#define ATMOS_SIMD_AVX512 1
+#define ATMOS_SIMD_F16C 1
+#define ATMOS_SIMD_TARGET(isa)
+#define ATMOS_SIMD_TRAMPOLINE(isa)
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ATMOS_SIMD_AVX2 1
+#define ATMOS_SIMD_AVX512 1
+#define ATMOS_SIMD_F16C 1
+#define ATMOS_SIMD_TARGET_ATTRIBUTES 1
+#define ATMOS_SIMD_TARGET(isa) __attribute__((target(isa)))
+#if defined(__clang__)
+#define ATMOS_SIMD_TRAMPOLINE(isa) __attribute__((target(isa), flatten))
+#else
+#define ATMOS_SIMD_TRAMPOLINE(isa) __attribute__((target(isa), flatten, optimize("fp-contract=off")))
+#endif
+#else
+#define ATMOS_SIMD_TARGET(isa)
+#define ATMOS_SIMD_TRAMPOLINE(isa)
+#if defined(__AVX2__)
+#define ATMOS_SIMD_AVX2 1
+#endif
+
+#if defined(__AVX512F__)
+#define ATMOS_SIMD_AVX512 1
+#endif
+
+#if defined(__F16C__)
+#define ATMOS_SIMD_F16C 1
+#endif
+#endif
+
+namespace Atmos
+{
+    enum class Kernel
+    {
+        // One sample at a time, kept for validating the vectorized kernels.
+        Scalar,
+        // Samples are processed Simd::GetWidth() at a time in structure-of-arrays form.
+        Simd,
+        // Neighbouring rays traced in lockstep, one per lane, where the caller has a batch of rays. Single ray calls
+        // fall back to Simd.
+        Packet
+    };
+}
+
+// Packs of floats with one lane per march sample. Every pack offers the same interface so that the kernels are written
+// once as templates: broadcasting, loading and gathering constructors, stores (StoreInt32 truncating), arithmetic,
+// comparisons producing a Mask, Select, Sqrt, Floor, Min, Max, Pow2 (for integer valued lanes) and ReduceAdd. Exp is
+// built on top of them.
+namespace Atmos::Simd
+{
+#if defined(ATMOS_SIMD_SSE2)
+    struct Float4 final
+    {
+        static constexpr int Width = 4;
+
+        struct Mask final
+        {
+            __m128 v;
+        };
+
+        __m128 v;
+
+        Float4() : v(_mm_setzero_ps()) { }
+        Float4(float const f) : v(_mm_set1_ps(f)) { }
+        Float4(__m128 const v) : v(v) { }
+
+        static auto Load(float const* const p) -> Float4 { return _mm_loadu_ps(p); }
+        auto Store(float* const p) const -> void { _mm_storeu_ps(p, v); }
+        auto StoreInt32(std::int32_t* const p) const -> void { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(v)); }
+        static auto Ramp() -> Float4 { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+
+        // Lane i reads p[offsets[i]]. SSE2 has no gather instruction, so the lanes are loaded one by one.
+        static auto Gather(float const* const p, std::int32_t const* const offsets) -> Float4
+        {
+            return _mm_setr_ps(p[offsets[0]], p[offsets[1]], p[offsets[2]], p[offsets[3]]);
+        }
+    };
+
+    inline auto operator+(Float4 const& a, Float4 const& b) -> Float4 { return _mm_add_ps(a.v, b.v); }
+    inline auto operator-(Float4 const& a, Float4 const& b) -> Float4 { return _mm_sub_ps(a.v, b.v); }
+    inline auto operator*(Float4 const& a, Float4 const& b) -> Float4 { return _mm_mul_ps(a.v, b.v); }
+    inline auto operator/(Float4 const& a, Float4 const& b) -> Float4 { return _mm_div_ps(a.v, b.v); }
+    inline auto operator-(Float4 const& a) -> Float4 { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+    inline auto operator<(Float4 const& a, Float4 const& b) -> Float4::Mask { return { _mm_cmplt_ps(a.v, b.v) }; }
+    inline auto operator<=(Float4 const& a, Float4 const& b) -> Float4::Mask { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline auto operator>(Float4 const& a, Float4 const& b) -> Float4::Mask { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline auto operator>=(Float4 const& a, Float4 const& b) -> Float4::Mask { return { _mm_cmpge_ps(a.v, b.v) }; }
+    inline auto operator&(Float4::Mask const& a, Float4::Mask const& b) -> Float4::Mask { return { _mm_and_ps(a.v, b.v) }; }
+    inline auto operator|(Float4::Mask const& a, Float4::Mask const& b) -> Float4::Mask { return { _mm_or_ps(a.v, b.v) }; }
+    inline auto operator!(Float4::Mask const& a) -> Float4::Mask { return { _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))) }; }
+    inline auto Any(Float4::Mask const& m) -> bool { return _mm_movemask_ps(m.v) != 0; }
+
+    inline auto Select(Float4::Mask const& m, Float4 const& a, Float4 const& b) -> Float4
+    {
+        return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+    }
+
+    inline auto Sqrt(Float4 const& a) -> Float4 { return _mm_sqrt_ps(a.v); }
+    inline auto Min(Float4 const& a, Float4 const& b) -> Float4 { return _mm_min_ps(a.v, b.v); }
+    inline auto Max(Float4 const& a, Float4 const& b) -> Float4 { return _mm_max_ps(a.v, b.v); }
+
+    inline auto Floor(Float4 const& a) -> Float4
+    {
+        // Only used on values well inside the int32 range.
+        auto const t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+    }
+
+    inline auto Pow2(Float4 const& n) -> Float4
+    {
+        auto const i = _mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(127));
+        return _mm_castsi128_ps(_mm_slli_epi32(i, 23));
+    }
+
+    inline auto ReduceAdd(Float4 const& a) -> float
+    {
+        auto const h = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+        return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+    }
+#else
+    struct Float4 final
+    {
+        static constexpr int Width = 4;
+
+        struct Mask final
+        {
+            bool v[4];
+        };
+
+        float v[4];
+
+        Float4() : v{ 0.0f, 0.0f, 0.0f, 0.0f } { }
+        Float4(float const f) : v{ f, f, f, f } { }
+
+        static auto Load(float const* const p) -> Float4 { Float4 r; std::memcpy(r.v, p, sizeof r.v); return r; }
+        auto Store(float* const p) const -> void { std::memcpy(p, v, sizeof v); }
+        auto StoreInt32(std::int32_t* const p) const -> void { for(auto i = 0; i < 4; ++i) p[i] = static_cast<std::int32_t>(v[i]); }
+        static auto Ramp() -> Float4 { Float4 r; for(auto i = 0; i < 4; ++i) r.v[i] = static_cast<float>(i); return r; }
+        static auto Gather(float const* const p, std::int32_t const* const offsets) -> Float4
+        {
+            Float4 r;
+            for(auto i = 0; i < 4; ++i) r.v[i] = p[offsets[i]];
+            return r;
+        }
+    };
+
+    template <typename F>
+    inline auto Map(Float4 const& a, Float4 const& b, F const f) -> Float4
+    {
+        Float4 r;
+        for(auto i = 0; i < 4; ++i) r.v[i] = f(a.v[i], b.v[i]);
+        return r;
+    }
+
+    template <typename F>
+    inline auto Compare(Float4 const& a, Float4 const& b, F const f) -> Float4::Mask
+    {
+        Float4::Mask r;
+        for(auto i = 0; i < 4; ++i) r.v[i] = f(a.v[i], b.v[i]);
+        return r;
+    }
+
+    inline auto operator+(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return x + y; }); }
+    inline auto operator-(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return x - y; }); }
+    inline auto operator*(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return x * y; }); }
+    inline auto operator/(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return x / y; }); }
+    inline auto operator-(Float4 const& a) -> Float4 { return Float4(0.0f) - a; }
+    inline auto operator<(Float4 const& a, Float4 const& b) -> Float4::Mask { return Compare(a, b, [](float x, float y) { return x < y; }); }
+    inline auto operator<=(Float4 const& a, Float4 const& b) -> Float4::Mask { return Compare(a, b, [](float x, float y) { return x <= y; }); }
+    inline auto operator>(Float4 const& a, Float4 const& b) -> Float4::Mask { return Compare(a, b, [](float x, float y) { return x > y; }); }
+    inline auto operator>=(Float4 const& a, Float4 const& b) -> Float4::Mask { return Compare(a, b, [](float x, float y) { return x >= y; }); }
+
+    inline auto operator&(Float4::Mask const& a, Float4::Mask const& b) -> Float4::Mask
+    {
+        return { { a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3] } };
+    }
+
+    inline auto operator|(Float4::Mask const& a, Float4::Mask const& b) -> Float4::Mask
+    {
+        return { { a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3] } };
+    }
+
+    inline auto operator!(Float4::Mask const& a) -> Float4::Mask { return { { !a.v[0], !a.v[1], !a.v[2], !a.v[3] } }; }
+    inline auto Any(Float4::Mask const& m) -> bool { return m.v[0] || m.v[1] || m.v[2] || m.v[3]; }
+
+    inline auto Select(Float4::Mask const& m, Float4 const& a, Float4 const& b) -> Float4
+    {
+        Float4 r;
+        for(auto i = 0; i < 4; ++i) r.v[i] = m.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline auto Sqrt(Float4 const& a) -> Float4 { return Map(a, a, [](float x, float) { return std::sqrt(x); }); }
+    inline auto Min(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return std::min(x, y); }); }
+    inline auto Max(Float4 const& a, Float4 const& b) -> Float4 { return Map(a, b, [](float x, float y) { return std::max(x, y); }); }
+    inline auto Floor(Float4 const& a) -> Float4 { return Map(a, a, [](float x, float) { return std::floor(x); }); }
+    inline auto Pow2(Float4 const& n) -> Float4 { return Map(n, n, [](float x, float) { return std::ldexp(1.0f, static_cast<int>(x)); }); }
+    inline auto ReduceAdd(Float4 const& a) -> float { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+#endif
+
+#if defined(ATMOS_SIMD_AVX2)
+#if defined(ATMOS_SIMD_TARGET_ATTRIBUTES) && defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,f16c"))), apply_to = function)
+#elif defined(ATMOS_SIMD_TARGET_ATTRIBUTES)
+#pragma GCC push_options
+#pragma GCC target("avx2,f16c")
+#endif
+    // Aligned explicitly, since GCC and Clang align __m256 to 16 bytes in code compiled without AVX.
+    struct alignas(32) Float8 final
+    {
+        static constexpr int Width = 8;
+
+        struct alignas(32) Mask final
+        {
+            __m256 v;
+        };
+
+        __m256 v;
+
+        Float8() : v(_mm256_setzero_ps()) { }
+        Float8(float const f) : v(_mm256_set1_ps(f)) { }
+        Float8(__m256 const v) : v(v) { }
+
+        static auto Load(float const* const p) -> Float8 { return _mm256_loadu_ps(p); }
+        auto Store(float* const p) const -> void { _mm256_storeu_ps(p, v); }
+        auto StoreInt32(std::int32_t* const p) const -> void { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_cvttps_epi32(v)); }
+        static auto Ramp() -> Float8 { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+        static auto Gather(float const* const p, std::int32_t const* const offsets) -> Float8
+        {
+            return _mm256_i32gather_ps(p, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(offsets)), 4);
+        }
+    };
+
+    inline auto operator+(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_add_ps(a.v, b.v); }
+    inline auto operator-(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_sub_ps(a.v, b.v); }
+    inline auto operator*(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_mul_ps(a.v, b.v); }
+    inline auto operator/(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_div_ps(a.v, b.v); }
+    inline auto operator-(Float8 const& a) -> Float8 { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+    inline auto operator<(Float8 const& a, Float8 const& b) -> Float8::Mask { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline auto operator<=(Float8 const& a, Float8 const& b) -> Float8::Mask { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline auto operator>(Float8 const& a, Float8 const& b) -> Float8::Mask { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline auto operator>=(Float8 const& a, Float8 const& b) -> Float8::Mask { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    inline auto operator&(Float8::Mask const& a, Float8::Mask const& b) -> Float8::Mask { return { _mm256_and_ps(a.v, b.v) }; }
+    inline auto operator|(Float8::Mask const& a, Float8::Mask const& b) -> Float8::Mask { return { _mm256_or_ps(a.v, b.v) }; }
+    inline auto operator!(Float8::Mask const& a) -> Float8::Mask { return { _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+    inline auto Any(Float8::Mask const& m) -> bool { return _mm256_movemask_ps(m.v) != 0; }
+
+    inline auto Select(Float8::Mask const& m, Float8 const& a, Float8 const& b) -> Float8
+    {
+        return _mm256_blendv_ps(b.v, a.v, m.v);
+    }
+
+    inline auto Sqrt(Float8 const& a) -> Float8 { return _mm256_sqrt_ps(a.v); }
+    inline auto Min(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_min_ps(a.v, b.v); }
+    inline auto Max(Float8 const& a, Float8 const& b) -> Float8 { return _mm256_max_ps(a.v, b.v); }
+    inline auto Floor(Float8 const& a) -> Float8 { return _mm256_floor_ps(a.v); }
+
+    inline auto Pow2(Float8 const& n) -> Float8
+    {
+        auto const i = _mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(i, 23));
+    }
+
+    inline auto ReduceAdd(Float8 const& a) -> float
+    {
+        return ReduceAdd(Float4(_mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1))));
+    }
+#if defined(ATMOS_SIMD_TARGET_ATTRIBUTES) && defined(__clang__)
+#pragma clang attribute pop
+#elif defined(ATMOS_SIMD_TARGET_ATTRIBUTES)
+#pragma GCC pop_options
+#endif
+#endif
+
+#if defined(ATMOS_SIMD_AVX512)
+#if defined(ATMOS_SIMD_TARGET_ATTRIBUTES) && defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx2,f16c"))), apply_to = function)
+#elif defined(ATMOS_SIMD_TARGET_ATTRIBUTES)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,f16c")
+#endif
+    struct alignas(64) Float16 final
+    {
+        static constexpr int Width = 16;
+
+        struct Mask final
+        {
+            __mmask16 v;
+        };
+
+        __m512 v;
+
+        Float16() : v(_mm512_setzero_ps()) { }
+        Float16(float const f) : v(_mm512_set1_ps(f)) { }
+        Float16(__m512 const v) : v(v) { }
+
+        static auto Load(float const* const p) -> Float16 { return _mm512_loadu_ps(p); }
+        auto Store(float* const p) const -> void { _mm512_storeu_ps(p, v); }
+        auto StoreInt32(std::int32_t* const p) const -> void { _mm512_storeu_si512(p, _mm512_cvttps_epi32(v)); }
+
+        static auto Ramp() -> Float16
+        {
+            return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+        }
+
+        static auto Gather(float const* const p, std::int32_t const* const offsets) -> Float16
+        {
+            return _mm512_i32gather_ps(_mm512_loadu_si512(offsets), p, 4);
+        }
+    };
+
+    inline auto operator+(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_add_ps(a.v, b.v); }
+    inline auto operator-(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_sub_ps(a.v, b.v); }
+    inline auto operator*(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_mul_ps(a.v, b.v); }
+    inline auto operator/(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_div_ps(a.v, b.v); }
+    inline auto operator-(Float16 const& a) -> Float16 { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+    inline auto operator<(Float16 const& a, Float16 const& b) -> Float16::Mask { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+    inline auto operator<=(Float16 const& a, Float16 const& b) -> Float16::Mask { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+    inline auto operator>(Float16 const& a, Float16 const& b) -> Float16::Mask { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+    inline auto operator>=(Float16 const& a, Float16 const& b) -> Float16::Mask { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+    inline auto operator&(Float16::Mask const& a, Float16::Mask const& b) -> Float16::Mask { return { static_cast<__mmask16>(a.v & b.v) }; }
+    inline auto operator|(Float16::Mask const& a, Float16::Mask const& b) -> Float16::Mask { return { static_cast<__mmask16>(a.v | b.v) }; }
+    inline auto operator!(Float16::Mask const& a) -> Float16::Mask { return { static_cast<__mmask16>(~a.v) }; }
+    inline auto Any(Float16::Mask const& m) -> bool { return m.v != 0; }
+
+    inline auto Select(Float16::Mask const& m, Float16 const& a, Float16 const& b) -> Float16
+    {
+        return _mm512_mask_blend_ps(m.v, b.v, a.v);
+    }
+
+    inline auto Sqrt(Float16 const& a) -> Float16 { return _mm512_sqrt_ps(a.v); }
+    inline auto Min(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_min_ps(a.v, b.v); }
+    inline auto Max(Float16 const& a, Float16 const& b) -> Float16 { return _mm512_max_ps(a.v, b.v); }
+    inline auto Floor(Float16 const& a) -> Float16 { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+    inline auto Pow2(Float16 const& n) -> Float16
+    {
+        auto const i = _mm512_add_epi32(_mm512_cvttps_epi32(n.v), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(i, 23));
+    }
+
+    inline auto ReduceAdd(Float16 const& a) -> float { return _mm512_reduce_add_ps(a.v); }
+#if defined(ATMOS_SIMD_TARGET_ATTRIBUTES) && defined(__clang__)
+#pragma clang attribute pop
+#elif defined(ATMOS_SIMD_TARGET_ATTRIBUTES)
+#pragma GCC pop_options
+#endif
+#endif
+
+    // The widest instruction set both compiled in and supported by the processor, lowered by the ATMOS_ISA environment
+    // variable (sse2, avx2 or avx512) when it names a narrower one. Read once.
+    [[nodiscard]]
+    inline auto GetIsa() -> Isa
+    {
+        static auto const isa = []
+        {
+            auto best = Isa::Sse2;
+#if defined(ATMOS_SIMD_AVX2)
+            if(CpuFeatures::Get().Supports(Isa::Avx2))
+            {
+                best = Isa::Avx2;
+            }
+#endif
+#if defined(ATMOS_SIMD_AVX512)
+            if(CpuFeatures::Get().Supports(Isa::Avx512))
+            {
+                best = Isa::Avx512;
+            }
+#endif
+
+            auto const requested = GetIsaOverride();
+            for(auto const candidate : { Isa::Sse2, Isa::Avx2, Isa::Avx512 })
+            {
+                if(requested == GetIsaName(candidate) && candidate < best)
+                {
+                    best = candidate;
+                }
+            }
+            return best;
+        }();
+
+        return isa;
+    }
+
+    // Whether the half conversion instructions may be used.
+    [[nodiscard]]
+    inline auto UseF16C() -> bool
+    {
+#if defined(ATMOS_SIMD_F16C)
+        static auto const use = CpuFeatures::Get().f16c && GetIsa() != Isa::Sse2;
+        return use;
+#else
+        return false;
+#endif
+    }
+
+    template <typename T>
+    struct PackTag final
+    {
+        using Pack = T;
+    };
+
+#if defined(ATMOS_SIMD_AVX2)
+    // Calls function with a wider pack from code compiled for its instruction set, see ATMOS_SIMD_TARGET.
+    template <typename Function>
+    ATMOS_SIMD_TRAMPOLINE("avx2,f16c")
+    inline auto CallAvx2(Function const& function) -> decltype(function(PackTag<Float4>()))
+    {
+        return function(PackTag<Float8>());
+    }
+#endif
+
+#if defined(ATMOS_SIMD_AVX512)
+    template <typename Function>
+    ATMOS_SIMD_TRAMPOLINE("avx512f,avx2,f16c")
+    inline auto CallAvx512(Function const& function) -> decltype(function(PackTag<Float4>()))
+    {
+        return function(PackTag<Float16>());
+    }
+#endif
+
+    // Calls function with the PackTag of the pack selected by GetIsa, so kernels written as templates over the pack run
+    // with the widest instructions the processor has.
+    template <typename Function>
+    inline auto Dispatch(Function const& function) -> decltype(function(PackTag<Float4>()))
+    {
+        switch(GetIsa())
+        {
+#if defined(ATMOS_SIMD_AVX512)
+        case Isa::Avx512:
+            return CallAvx512(function);
+#endif
+#if defined(ATMOS_SIMD_AVX2)
+        case Isa::Avx2:
+            return CallAvx2(function);
+#endif
+        default:
+            return function(PackTag<Float4>());
+        }
+    }
+
+    // As Dispatch, but never wider than MaxWidth lanes, for kernels whose lanes hold a fixed number of channels.
+    template <int MaxWidth, typename Function>
+    inline auto DispatchAtMost(Function const& function) -> decltype(function(PackTag<Float4>()))
+    {
+        static_assert(MaxWidth >= 4, "Float4 is the narrowest pack.");
+
+#if defined(ATMOS_SIMD_AVX512)
+        if constexpr(MaxWidth >= 16)
+        {
+            if(GetIsa() == Isa::Avx512)
+            {
+                return CallAvx512(function);
+            }
+        }
+#endif
+#if defined(ATMOS_SIMD_AVX2)
+        if constexpr(MaxWidth >= 8)
+        {
+            if(GetIsa() != Isa::Sse2)
+            {
+                return CallAvx2(function);
+            }
+        }
+#endif
+        return function(PackTag<Float4>());
+    }
+
+    // Lanes of the pack Dispatch selects.
+    [[nodiscard]]
+    inline auto GetWidth() -> int
+    {
+        return Dispatch([](auto tag) { return decltype(tag)::Pack::Width; });
+    }
+
+    // Cephes expf: range reduction by powers of two and a degree 5 polynomial, about 2 ulp over the clamped range.
+    template <typename Pack>
+    inline auto Exp(Pack const& x) -> Pack
+    {
+        auto const clamped = Min(Max(x, Pack(-87.3f)), Pack(88.3f));
+        auto const n = Floor(clamped * Pack(1.44269504088896341f) + Pack(0.5f));
+        auto const r = clamped - n * Pack(0.693359375f) + n * Pack(2.12194440e-4f);
+
+        auto p = Pack(1.9875691500e-4f);
+        p = p * r + Pack(1.3981999507e-3f);
+        p = p * r + Pack(8.3334519073e-3f);
+        p = p * r + Pack(4.1665795894e-2f);
+        p = p * r + Pack(1.6666665459e-1f);
+        p = p * r + Pack(5.0000001201e-1f);
+        p = p * r * r + r + Pack(1.0f);
+
+        return p * Pow2(n);
+    }
+
+    template <typename Pack>
+    struct Vector3Pack final
+    {
+        Pack x;
+        Pack y;
+        Pack z;
+
+        Vector3Pack() = default;
+        Vector3Pack(Pack const& x, Pack const& y, Pack const& z)
+            : x(x), y(y), z(z)
+        { }
+
+        explicit Vector3Pack(Vector3 const& v)
+            : x(v.x), y(v.y), z(v.z)
+        { }
+
+        [[nodiscard]]
+        auto Length() const -> Pack
+        {
+            return Sqrt(x * x + y * y + z * z);
+        }
+    };
+
+    template <typename Pack>
+    inline auto operator+(Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x + b.x, a.y + b.y, a.z + b.z };
+    }
+
+    template <typename Pack>
+    inline auto operator-(Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    template <typename Pack>
+    inline auto operator*(Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x * b.x, a.y * b.y, a.z * b.z };
+    }
+
+    template <typename Pack>
+    inline auto operator*(Vector3Pack<Pack> const& a, Pack const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x * b, a.y * b, a.z * b };
+    }
+
+    template <typename Pack>
+    inline auto operator/(Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x / b.x, a.y / b.y, a.z / b.z };
+    }
+
+    template <typename Pack>
+    inline auto operator/(Vector3Pack<Pack> const& a, Pack const& b) -> Vector3Pack<Pack>
+    {
+        return { a.x / b, a.y / b, a.z / b };
+    }
+
+    template <typename Pack>
+    inline auto Dot(Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Pack
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    template <typename Pack>
+    inline auto Exp(Vector3Pack<Pack> const& v) -> Vector3Pack<Pack>
+    {
+        return { Exp(v.x), Exp(v.y), Exp(v.z) };
+    }
+
+    template <typename Pack>
+    inline auto Select(typename Pack::Mask const& m, Vector3Pack<Pack> const& a, Vector3Pack<Pack> const& b) -> Vector3Pack<Pack>
+    {
+        return { Select(m, a.x, b.x), Select(m, a.y, b.y), Select(m, a.z, b.z) };
+    }
+
+    template <typename Pack>
+    inline auto ReduceAdd(Vector3Pack<Pack> const& v) -> Vector3
+    {
+        return { ReduceAdd(v.x), ReduceAdd(v.y), ReduceAdd(v.z) };
+    }
+
+    // Parametric distances along a ray to its two intersections with a sphere centered at the origin, with the same
+    // conventions as RayCircleIntersection. Lanes that miss the sphere get a negative discriminant.
+    template <typename Pack>
+    inline auto RaySphereIntersection(
+        Vector3Pack<Pack> const& rayOrigin,
+        Vector3Pack<Pack> const& rayDir,
+        float const sphereRadius,
+        Pack& discriminant,
+        Pack& tNear,
+        Pack& tFar) -> void
+    {
+        auto const a = Dot(rayDir, rayDir);
+        auto const b = Pack(2.0f) * Dot(rayOrigin, rayDir);
+        auto const c = Dot(rayOrigin, rayOrigin) - Pack(sphereRadius * sphereRadius);
+
+        discriminant = b * b - Pack(4.0f) * a * c;
+        auto const d2 = Sqrt(Max(discriminant, Pack(0.0f)));
+        tNear = (-b - d2) / (Pack(2.0f) * a);
+        tFar = (-b + d2) / (Pack(2.0f) * a);
+    }
+
+    // Lanes of the pack starting at the given index that still lie inside a loop of the given count.
+    template <typename Pack>
+    inline auto LaneIndices(int const first) -> Pack
+    {
+        return Pack(static_cast<float>(first)) + Pack::Ramp();
+    }
+
+    // Loads the given points into lanes, repeating the last point where fewer than Pack::Width remain.
+    template <typename Pack>
+    inline auto LoadPoints(Vector3 const* const points, int const count) -> Vector3Pack<Pack>
+    {
+        float x[Pack::Width];
+        float y[Pack::Width];
+        float z[Pack::Width];
+        for(auto lane = 0; lane < Pack::Width; ++lane)
+        {
+            auto const& point = points[std::min(lane, count - 1)];
+            x[lane] = point.x;
+            y[lane] = point.y;
+            z[lane] = point.z;
+        }
+
+        return { Pack::Load(x), Pack::Load(y), Pack::Load(z) };
+    }
+
+    template <typename Pack>
+    inline auto StorePoints(Vector3Pack<Pack> const& v, Vector3* const points, int const count) -> void
+    {
+        float x[Pack::Width];
+        float y[Pack::Width];
+        float z[Pack::Width];
+        v.x.Store(x);
+        v.y.Store(y);
+        v.z.Store(z);
+
+        for(auto lane = 0; lane < std::min(count, Pack::Width); ++lane)
+        {
+            points[lane] = Vector3(x[lane], y[lane], z[lane]);
+        }
+    }
+
+    template <typename Pack>
+    inline auto Lane(Pack const& p, int const lane) -> float
+    {
+        float values[Pack::Width];
+        p.Store(values);
+        return values[lane];
+    }
+}
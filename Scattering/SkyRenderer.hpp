@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "Texture.hpp"
+#include "Transmittance.hpp"
+#include "TransmittanceTable.hpp"
+#include "Scattering.hpp"
+#include "ScatteringMap.hpp"
+#include "IrradianceMap.hpp"
+#include "Scheduler.hpp"
+
+namespace Atmos
+{
+    // Images of the sky seen by an observer, rendered on the CPU either from the baked tables or by integrating every
+    // view ray from scratch, so that the tables can be checked end to end and their lookups timed at a realistic
+    // rate. Pixels are rendered in tiles scheduled over the threads.
+    //
+    // Both modes add the ground, a Lambertian surface lit by the sun and the sky and seen through the atmosphere.
+    // Only the sky irradiance always comes from the irradiance map: integrating it from scratch would trace a whole
+    // hemisphere of rays for every ground pixel. The sun irradiance is one, as in the tables, and the sun disk is
+    // not drawn.
+    class SkyRenderer final
+    {
+    public:
+        enum class Projection
+        {
+            // Azimuth along the width, elevation from the zenith at the top to the nadir at the bottom.
+            Equirectangular,
+            // Upper hemisphere seen from below with the zenith in the centre, the distance from the centre growing
+            // linearly with the zenith angle. Pixels outside the circle stay black.
+            Fisheye
+        };
+
+        enum class Mode
+        {
+            // Scattering from the full table of the scattering map, with the phase functions applied per pixel where it
+            // has its deferred tables, transmittance from the transmittance table.
+            Tables,
+            // Scattering::GetPathScattering and Transmittance::GetPathTransmittance for every pixel, no table but the
+            // irradiance map involved.
+            Raymarch
+        };
+
+        struct Camera final
+        {
+            std::size_t width = 512;
+            std::size_t height = 256;
+            Projection projection = Projection::Equirectangular;
+            // Above the ground, in the units of the planet properties.
+            float altitude = 1.0f;
+            float sunZenithCos = 0.2f;
+            // Angle around the zenith from the x axis, in radians.
+            float sunAzimuth = 0.0f;
+            float groundAlbedo = 0.1f;
+        };
+
+        struct Frame final
+        {
+            Texture2D<Vector3> image;
+            double seconds = 0.0;
+            // Density evaluations, zero for Mode::Tables.
+            std::int64_t evaluationCount = 0;
+        };
+
+        struct Difference final
+        {
+            float maxAbsolute = 0.0f;
+            float rms = 0.0f;
+            // Relative to the reference, which is kept above a thousandth of its brightest channel so that the dark
+            // parts of the image do not dominate.
+            float maxRelative = 0.0f;
+        };
+
+    private:
+        PlanetProperties pp;
+        ScatteringMap const* scatteringMap;
+        TransmittanceTable const* transmittanceTable;
+        IrradianceMap const* irradianceMap;
+        Scattering::IntegrationParams sParams;
+        Transmittance::IntegrationParameters tParams;
+
+        // Side in pixels of the square tiles the image is rendered in.
+        static constexpr int TileSize = 16;
+
+    public:
+        // The maps are referenced, not copied, and must outlive the renderer. The scattering map needs its full table,
+        // from ComputeFull or ComputeFullDeferred. The integration parameters are those of Mode::Raymarch.
+        explicit SkyRenderer(
+            ScatteringMap const& scatteringMap,
+            TransmittanceTable const& transmittanceTable,
+            IrradianceMap const& irradianceMap,
+            Scattering::IntegrationParams const& sParams,
+            Transmittance::IntegrationParameters const& tParams)
+            : pp(transmittanceTable.GetPlanetProperties()), scatteringMap(&scatteringMap),
+            transmittanceTable(&transmittanceTable), irradianceMap(&irradianceMap), sParams(sParams), tParams(tParams)
+        { }
+
+        [[nodiscard]]
+        auto Render(Camera const& camera, Mode const mode) const -> Frame
+        {
+            auto const start = std::chrono::steady_clock::now();
+
+            auto frame = Frame();
+            frame.image = Texture2D<Vector3>(camera.width, camera.height);
+
+            auto const observer = Vector3(0.0f, pp.GetPlanetRadius() + camera.altitude, 0.0f);
+            auto const sunZenithSin = std::sqrtf(std::max(0.0f, 1.0f - camera.sunZenithCos * camera.sunZenithCos));
+            auto const sunDir = Vector3(sunZenithSin * std::cos(camera.sunAzimuth), camera.sunZenithCos,
+                sunZenithSin * std::sin(camera.sunAzimuth));
+
+            frame.evaluationCount = Scheduler::ForEachTile(static_cast<int>(camera.width), static_cast<int>(camera.height),
+                TileSize, TileSize, [&](Scheduler::Tile const& tile)
+            {
+                thread_local auto pixels = std::vector<Pixel>();
+                pixels.clear();
+                for(auto y = tile.v0; y < tile.v1; ++y)
+                {
+                    for(auto x = tile.u0; x < tile.u1; ++x)
+                    {
+                        auto const viewDir = GetViewDirection(camera, x, y);
+                        if(viewDir)
+                        {
+                            pixels.push_back({ x, y, viewDir.value() });
+                        }
+                    }
+                }
+
+                if(mode == Mode::Tables)
+                {
+                    RenderTables(camera, observer, sunDir, pixels, frame.image);
+                }
+                else
+                {
+                    RenderRaymarch(camera, observer, sunDir, pixels, frame.image);
+                }
+            });
+
+            frame.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return frame;
+        }
+
+        [[nodiscard]]
+        auto static Compare(Texture2D<Vector3> const& image, Texture2D<Vector3> const& reference) -> Difference
+        {
+            auto const count = std::min(image.GetSize(), reference.GetSize());
+
+            auto brightest = 0.0f;
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                auto const& texel = reference.data()[i];
+                brightest = std::max({ brightest, texel.x, texel.y, texel.z });
+            }
+            auto const floor = std::max(1e-3f * brightest, std::numeric_limits<float>::min());
+
+            auto difference = Difference();
+            auto sum = 0.0;
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                auto const& a = image.data()[i];
+                auto const& b = reference.data()[i];
+                float const values[] = { a.x, a.y, a.z };
+                float const expected[] = { b.x, b.y, b.z };
+                for(auto channel = 0; channel < 3; ++channel)
+                {
+                    auto const error = std::fabs(values[channel] - expected[channel]);
+                    difference.maxAbsolute = std::max(difference.maxAbsolute, error);
+                    difference.maxRelative = std::max(difference.maxRelative,
+                        error / std::max(std::fabs(expected[channel]), floor));
+                    sum += static_cast<double>(error) * error;
+                }
+            }
+            difference.rms = count > 0 ? static_cast<float>(std::sqrt(sum / (3.0 * static_cast<double>(count)))) : 0.0f;
+            return difference;
+        }
+
+    private:
+        struct Pixel final
+        {
+            int x;
+            int y;
+            Vector3 viewDir;
+        };
+
+        // Direction through the centre of a pixel, none outside the fisheye circle.
+        [[nodiscard]]
+        auto static GetViewDirection(Camera const& camera, int const x, int const y) -> std::optional<Vector3>
+        {
+            auto const s = (static_cast<float>(x) + 0.5f) / static_cast<float>(camera.width);
+            auto const t = (static_cast<float>(y) + 0.5f) / static_cast<float>(camera.height);
+
+            switch(camera.projection)
+            {
+            case Projection::Equirectangular:
+            {
+                auto const azimuth = 2.0f * PI * s;
+                auto const elevation = PI * (0.5f - t);
+                return Vector3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation),
+                    std::cos(elevation) * std::sin(azimuth));
+            }
+            case Projection::Fisheye:
+            {
+                auto const px = 2.0f * s - 1.0f;
+                auto const py = 2.0f * t - 1.0f;
+                auto const r = std::sqrtf(px * px + py * py);
+                if(r > 1.0f)
+                {
+                    return std::nullopt;
+                }
+
+                auto const zenith = 0.5f * PI * r;
+                auto const azimuth = std::atan2(py, px);
+                return Vector3(std::sin(zenith) * std::cos(azimuth), std::cos(zenith), std::sin(zenith) * std::sin(azimuth));
+            }
+            }
+            return std::nullopt;
+        }
+
+        // Cosine of the angle between the horizontal parts of the view and sun directions, the azimuth axis of the full
+        // table. Straight up or down every azimuth is the same.
+        [[nodiscard]]
+        auto static GetSunAzimuthCos(Vector3 const& viewDir, Vector3 const& sunDir) -> float
+        {
+            auto const viewLength = std::sqrtf(viewDir.x * viewDir.x + viewDir.z * viewDir.z);
+            auto const sunLength = std::sqrtf(sunDir.x * sunDir.x + sunDir.z * sunDir.z);
+            if(viewLength < 1e-6f || sunLength < 1e-6f)
+            {
+                return 1.0f;
+            }
+
+            return std::clamp((viewDir.x * sunDir.x + viewDir.z * sunDir.z) / (viewLength * sunLength), -1.0f, 1.0f);
+        }
+
+        auto RenderTables(
+            Camera const& camera,
+            Vector3 const& observer,
+            Vector3 const& sunDir,
+            std::vector<Pixel> const& pixels,
+            Texture2D<Vector3>& image) const -> void
+        {
+            thread_local auto altitudes = std::vector<float>();
+            thread_local auto viewZenithCos = std::vector<float>();
+            thread_local auto sunZenithCos = std::vector<float>();
+            thread_local auto sunAzimuthCos = std::vector<float>();
+            thread_local auto scattering = std::vector<Vector3>();
+
+            auto const count = pixels.size();
+            altitudes.assign(count, camera.altitude);
+            sunZenithCos.assign(count, camera.sunZenithCos);
+            viewZenithCos.resize(count);
+            sunAzimuthCos.resize(count);
+            scattering.resize(count);
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                viewZenithCos[i] = pixels[i].viewDir.y;
+                sunAzimuthCos[i] = GetSunAzimuthCos(pixels[i].viewDir, sunDir);
+            }
+
+            scatteringMap->GetScattering(count, altitudes.data(), viewZenithCos.data(), sunZenithCos.data(),
+                sunAzimuthCos.data(), pp, scattering.data());
+
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                auto radiance = scattering[i];
+
+                auto const groundPoint = RayCircleIntersection(observer, pixels[i].viewDir, pp.GetPlanetRadius());
+                if(groundPoint)
+                {
+                    auto const groundSunZenithCos = Dot(groundPoint.value(), sunDir) / pp.GetPlanetRadius();
+                    auto const sunTransmittance = groundSunZenithCos > 0.0f
+                        ? transmittanceTable->GetTransmittanceToAtmosphere(pp.GetPlanetRadius(), groundSunZenithCos)
+                        : Vector3();
+
+                    radiance += transmittanceTable->GetTransmittance(observer, groundPoint.value())
+                        * GetGroundRadiance(camera, groundSunZenithCos, sunTransmittance);
+                }
+
+                image[pixels[i].y][pixels[i].x] = radiance;
+            }
+        }
+
+        auto RenderRaymarch(
+            Camera const& camera,
+            Vector3 const& observer,
+            Vector3 const& sunDir,
+            std::vector<Pixel> const& pixels,
+            Texture2D<Vector3>& image) const -> void
+        {
+            for(auto const& pixel : pixels)
+            {
+                auto const groundPoint = RayCircleIntersection(observer, pixel.viewDir, pp.GetPlanetRadius());
+                auto const exitPoint = groundPoint
+                    ? groundPoint.value()
+                    : RayCircleIntersection(observer, pixel.viewDir, pp.GetAtmosphereRadius()).value();
+
+                auto radiance = Scattering::GetPathScattering(observer, exitPoint, sunDir, pp, tParams, sParams);
+
+                if(groundPoint)
+                {
+                    auto const groundSunZenithCos = Dot(groundPoint.value(), sunDir) / pp.GetPlanetRadius();
+                    auto const sunTransmittance = groundSunZenithCos > 0.0f
+                        ? Transmittance::GetPathTransmittance(groundPoint.value(),
+                            RayCircleIntersection(groundPoint.value(), sunDir, pp.GetAtmosphereRadius()).value(), pp, tParams)
+                        : Vector3();
+
+                    radiance += Transmittance::GetPathTransmittance(observer, groundPoint.value(), pp, tParams)
+                        * GetGroundRadiance(camera, groundSunZenithCos, sunTransmittance);
+                }
+
+                image[pixel.y][pixel.x] = radiance;
+            }
+        }
+
+        // Radiance leaving the ground, lit by the sun through the given transmittance and by the sky.
+        [[nodiscard]]
+        auto GetGroundRadiance(Camera const& camera, float const sunZenithCos, Vector3 const& sunTransmittance) const
+            -> Vector3
+        {
+            auto const irradiance = sunTransmittance * std::max(sunZenithCos, 0.0f) + irradianceMap->GetIrradiance(sunZenithCos);
+            return irradiance * (camera.groundAlbedo / PI);
+        }
+    };
+}
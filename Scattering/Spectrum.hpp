@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "Vector3.hpp"
+
+namespace Atmos
+{
+    // N samples of a spectral quantity at the centres of N equal bins over [400, 700] nm, the counterpart of the RGB
+    // Vector3 used everywhere else. N is a multiple of 4 so that the samples fill whole SIMD packs.
+    template <int N>
+    struct Spectrum final
+    {
+        static_assert(N > 0 && N % 4 == 0, "Spectra hold whole packs of four wavelengths.");
+
+        static constexpr int Size = N;
+        static constexpr float FirstWavelength = 400.0f;
+        static constexpr float LastWavelength = 700.0f;
+
+        alignas(16) float values[N] = {};
+
+        Spectrum() = default;
+
+        explicit Spectrum(float const value)
+        {
+            std::fill(values, values + N, value);
+        }
+
+        [[nodiscard]]
+        static auto GetWavelength(int const i) -> float
+        {
+            return FirstWavelength + (LastWavelength - FirstWavelength) * (static_cast<float>(i) + 0.5f) / N;
+        }
+
+        // A smooth coefficient spectrum through the RGB channels, read as samples at 680, 550 and 440 nm, interpolated
+        // and extrapolated linearly in log-log space, so power laws such as Rayleigh's lambda^-4 are reproduced
+        // exactly. Channels that are not all positive are interpolated linearly instead.
+        [[nodiscard]]
+        static auto FromRgb(Vector3 const& rgb) -> Spectrum
+        {
+            auto const logLog = rgb.x > 0.0f && rgb.y > 0.0f && rgb.z > 0.0f;
+            auto const axis = [logLog](float const x) { return logLog ? std::logf(x) : x; };
+
+            float const wavelengths[3] = { axis(440.0f), axis(550.0f), axis(680.0f) };
+            float const samples[3] = { axis(rgb.z), axis(rgb.y), axis(rgb.x) };
+
+            auto spectrum = Spectrum();
+            for(auto i = 0; i < N; ++i)
+            {
+                auto const wavelength = axis(GetWavelength(i));
+                auto const segment = wavelength < wavelengths[1] ? 0 : 1;
+                auto const t = (wavelength - wavelengths[segment]) / (wavelengths[segment + 1] - wavelengths[segment]);
+                auto const sample = samples[segment] + (samples[segment + 1] - samples[segment]) * t;
+
+                spectrum.values[i] = logLog ? std::expf(sample) : std::max(sample, 0.0f);
+            }
+            return spectrum;
+        }
+
+        auto operator[](int const i) -> float&
+        {
+            return values[i];
+        }
+
+        auto operator[](int const i) const -> float
+        {
+            return values[i];
+        }
+
+        auto operator+=(Spectrum const& s) -> Spectrum&
+        {
+            for(auto i = 0; i < N; ++i)
+            {
+                values[i] += s.values[i];
+            }
+            return *this;
+        }
+
+        auto operator*=(float const c) -> Spectrum&
+        {
+            for(auto i = 0; i < N; ++i)
+            {
+                values[i] *= c;
+            }
+            return *this;
+        }
+    };
+
+    template <int N>
+    inline auto operator+(Spectrum<N> a, Spectrum<N> const& b) -> Spectrum<N>
+    {
+        return a += b;
+    }
+
+    template <int N>
+    inline auto operator-(Spectrum<N> const& a, Spectrum<N> const& b) -> Spectrum<N>
+    {
+        auto result = Spectrum<N>();
+        for(auto i = 0; i < N; ++i)
+        {
+            result.values[i] = a.values[i] - b.values[i];
+        }
+        return result;
+    }
+
+    template <int N>
+    inline auto operator-(Spectrum<N> const& s) -> Spectrum<N>
+    {
+        return s * -1.0f;
+    }
+
+    template <int N>
+    inline auto operator*(Spectrum<N> const& a, Spectrum<N> const& b) -> Spectrum<N>
+    {
+        auto result = Spectrum<N>();
+        for(auto i = 0; i < N; ++i)
+        {
+            result.values[i] = a.values[i] * b.values[i];
+        }
+        return result;
+    }
+
+    template <int N>
+    inline auto operator*(Spectrum<N> s, float const c) -> Spectrum<N>
+    {
+        return s *= c;
+    }
+
+    template <int N>
+    inline auto operator*(float const c, Spectrum<N> s) -> Spectrum<N>
+    {
+        return s *= c;
+    }
+
+    template <int N>
+    inline auto operator/(Spectrum<N> s, float const c) -> Spectrum<N>
+    {
+        return s *= 1.0f / c;
+    }
+
+    template <int N>
+    inline auto Lerp(Spectrum<N> const& a, Spectrum<N> const& b, float const t) -> Spectrum<N>
+    {
+        auto result = Spectrum<N>();
+        for(auto i = 0; i < N; ++i)
+        {
+            result.values[i] = a.values[i] * (1.0f - t) + b.values[i] * t;
+        }
+        return result;
+    }
+
+    template <int N>
+    inline auto Exp(Spectrum<N> const& s) -> Spectrum<N>
+    {
+        auto result = Spectrum<N>();
+        for(auto i = 0; i < N; ++i)
+        {
+            result.values[i] = std::expf(s.values[i]);
+        }
+        return result;
+    }
+
+    // Linear sRGB of a radiance spectrum through the CIE 1931 colour matching functions, each bin weighted by their
+    // integral over it. The result is white balanced so that a flat spectrum of one gives (1, 1, 1), the colour of
+    // the sun in the RGB pipeline.
+    template <int N>
+    [[nodiscard]]
+    inline auto ToRgb(Spectrum<N> const& s) -> Vector3
+    {
+        static auto const weights = []
+        {
+            // Multi-lobe Gaussian fit of the colour matching functions by Wyman, Sloan and Shirley.
+            auto const lobe = [](float const x, float const mean, float const below, float const above)
+            {
+                auto const t = (x - mean) / (x < mean ? below : above);
+                return std::expf(-0.5f * t * t);
+            };
+            auto const cmf = [&](float const x)
+            {
+                return Vector3(
+                    1.056f * lobe(x, 599.8f, 37.9f, 31.0f) + 0.362f * lobe(x, 442.0f, 16.0f, 26.7f)
+                        - 0.065f * lobe(x, 501.1f, 20.4f, 26.2f),
+                    0.821f * lobe(x, 568.8f, 46.9f, 40.5f) + 0.286f * lobe(x, 530.9f, 16.3f, 31.1f),
+                    1.217f * lobe(x, 437.0f, 11.8f, 36.0f) + 0.681f * lobe(x, 459.0f, 26.0f, 13.8f));
+            };
+            auto const xyzToRgb = [](Vector3 const& xyz)
+            {
+                return Vector3(
+                    3.2404542f * xyz.x - 1.5371385f * xyz.y - 0.4985314f * xyz.z,
+                    -0.9692660f * xyz.x + 1.8760108f * xyz.y + 0.0415560f * xyz.z,
+                    0.0556434f * xyz.x - 0.2040259f * xyz.y + 1.0572252f * xyz.z);
+            };
+
+            constexpr auto Steps = 16;
+            auto const binWidth = (Spectrum<N>::LastWavelength - Spectrum<N>::FirstWavelength) / N;
+
+            auto rgbWeights = std::array<Vector3, N>();
+            auto white = Vector3();
+            for(auto i = 0; i < N; ++i)
+            {
+                auto xyz = Vector3();
+                for(auto step = 0; step < Steps; ++step)
+                {
+                    auto const wavelength = Spectrum<N>::FirstWavelength
+                        + binWidth * (static_cast<float>(i) + (static_cast<float>(step) + 0.5f) / Steps);
+                    xyz += cmf(wavelength) * (binWidth / Steps);
+                }
+                rgbWeights[i] = xyzToRgb(xyz);
+                white += rgbWeights[i];
+            }
+
+            for(auto& weight : rgbWeights)
+            {
+                weight = weight / white;
+            }
+            return rgbWeights;
+        }();
+
+        auto rgb = Vector3();
+        for(auto i = 0; i < N; ++i)
+        {
+            rgb += weights[i] * s.values[i];
+        }
+        return rgb;
+    }
+}
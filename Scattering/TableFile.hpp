@@ -0,0 +1,659 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "PlanetProperties.hpp"
+#include "Texture.hpp"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Atmos
+{
+    // Self-describing file of finished tables, meant to be mapped into memory and sampled in place. All fields are
+    // little-endian and of fixed width:
+    //
+    //   FileHeader           magic, format version, section count and the offsets of the blocks below
+    //   PlanetMetadata       the planet properties the tables were computed for
+    //   SectionHeader[count] name, channel format, resolution, layout and axis mappings of each table
+    //   payloads             the texels of each table exactly as a TextureND holds them, padding of tiled and Morton
+    //                        layouts included, every payload starting on a 64-byte boundary
+    //
+    // Readers reject files of another major version. Fields are only ever appended to the headers, whose sizes are
+    // stored, so newer minor versions stay readable.
+    class TableFile final
+    {
+    public:
+        static std::uint32_t constexpr MajorVersion = 1;
+        static std::uint32_t constexpr MinorVersion = 0;
+        static std::size_t constexpr PayloadAlignment = 64;
+        // Largest resolution of an axis a reader accepts, which keeps the padded sizes of the layouts far from
+        // overflowing.
+        static std::uint64_t constexpr MaxAxisResolution = std::uint64_t(1) << 24;
+
+        enum class ChannelType : std::uint32_t
+        {
+            Float32 = 1
+        };
+
+        struct FileHeader final
+        {
+            char magic[8];
+            std::uint32_t majorVersion;
+            std::uint32_t minorVersion;
+            std::uint32_t headerSize;
+            std::uint32_t metadataSize;
+            std::uint32_t sectionHeaderSize;
+            std::uint32_t sectionCount;
+            std::uint64_t metadataOffset;
+            std::uint64_t sectionsOffset;
+            std::uint64_t fileSize;
+        };
+
+        struct PlanetMetadata final
+        {
+            float planetRadius;
+            float atmosphereHeight;
+            float rayleightScatteringCoef[3];
+            float rayleightExtinctionCoef[3];
+            float mieScatteringCoef[3];
+            float mieExtinctionCoef[3];
+            float rayleightScaleHeight;
+            float mieScaleHeight;
+            float mieAsymmetryCoef;
+            std::uint32_t mathMode;
+        };
+
+        struct SectionHeader final
+        {
+            char name[48];
+            ChannelType channelType;
+            std::uint32_t channelCount;
+            std::uint32_t dimensionCount;
+            std::uint32_t layout;
+            std::uint64_t resolution[4];
+            // How each axis maps to its parameter, ScatteringMap::Mapping values for the zenith cosine axes of the
+            // scattering tables and zero for fixed parameterizations.
+            std::uint32_t axisMappings[4];
+            std::uint64_t offset;
+            std::uint64_t size;
+            // FNV-1a over the payload in 64-bit words, zero when the writer skipped it.
+            std::uint64_t checksum;
+        };
+
+        TableFile() = default;
+
+        TableFile(TableFile const&) = delete;
+        auto operator=(TableFile const&) -> TableFile& = delete;
+
+        TableFile(TableFile&& other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        auto operator=(TableFile&& other) noexcept -> TableFile&
+        {
+            if(this != &other)
+            {
+                Close();
+                std::swap(bytes, other.bytes);
+                std::swap(byteCount, other.byteCount);
+#if defined(_WIN32)
+                std::swap(mapping, other.mapping);
+#endif
+            }
+            return *this;
+        }
+
+        ~TableFile()
+        {
+            Close();
+        }
+
+        // Maps the file and checks its structure, which costs a few system calls whatever the size of the tables.
+        // Payloads are paged in as they are first sampled. Checksums are only compared by Verify.
+        auto Open(std::filesystem::path const& path) -> bool
+        {
+            Close();
+            if(!Map(path) || !IsValid())
+            {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        auto Close() -> void
+        {
+            if(bytes != nullptr)
+            {
+#if defined(_WIN32)
+                UnmapViewOfFile(bytes);
+                CloseHandle(mapping);
+                mapping = nullptr;
+#else
+                munmap(const_cast<unsigned char*>(bytes), byteCount);
+#endif
+            }
+            bytes = nullptr;
+            byteCount = 0;
+        }
+
+        [[nodiscard]]
+        auto IsOpen() const -> bool
+        {
+            return bytes != nullptr;
+        }
+
+        [[nodiscard]]
+        auto GetHeader() const -> FileHeader const&
+        {
+            return *reinterpret_cast<FileHeader const*>(bytes);
+        }
+
+        [[nodiscard]]
+        auto GetMetadata() const -> PlanetMetadata const&
+        {
+            return *reinterpret_cast<PlanetMetadata const*>(bytes + GetHeader().metadataOffset);
+        }
+
+        [[nodiscard]]
+        auto GetPlanetProperties() const -> PlanetProperties
+        {
+            auto const& metadata = GetMetadata();
+            auto const color = [](float const (&c)[3]) { return Vector3(c[0], c[1], c[2]); };
+
+            auto pp = PlanetProperties();
+            pp.SetMathMode(static_cast<MathMode>(metadata.mathMode));
+            pp.SetPlanetRadius(metadata.planetRadius);
+            pp.SetAtmosphereHeight(metadata.atmosphereHeight);
+            pp.SetRayleightScatteringCoef(color(metadata.rayleightScatteringCoef));
+            pp.SetRayleightExtinctionCoef(color(metadata.rayleightExtinctionCoef));
+            pp.SetMieScatteringCoef(color(metadata.mieScatteringCoef));
+            pp.SetMieExtinctionCoef(color(metadata.mieExtinctionCoef));
+            pp.SetRayleightScaleHeight(metadata.rayleightScaleHeight);
+            pp.SetMieScaleHeight(metadata.mieScaleHeight);
+            pp.SetMieAsymmetryCoef(metadata.mieAsymmetryCoef);
+            return pp;
+        }
+
+        [[nodiscard]]
+        auto GetSectionCount() const -> std::size_t
+        {
+            return GetHeader().sectionCount;
+        }
+
+        [[nodiscard]]
+        auto GetSection(std::size_t const index) const -> SectionHeader const&
+        {
+            auto const& header = GetHeader();
+            return *reinterpret_cast<SectionHeader const*>(bytes + header.sectionsOffset + index * header.sectionHeaderSize);
+        }
+
+        // The section of the given name, null when there is none.
+        [[nodiscard]]
+        auto FindSection(char const* const name) const -> SectionHeader const*
+        {
+            for(std::size_t i = 0; i < GetSectionCount(); ++i)
+            {
+                auto const& section = GetSection(i);
+                if(std::strncmp(section.name, name, sizeof section.name) == 0)
+                {
+                    return &section;
+                }
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]]
+        auto GetPayload(SectionHeader const& section) const -> void const*
+        {
+            return bytes + section.offset;
+        }
+
+        // Views of the texels in the mapping, valid while the file stays open. A missing section or one whose
+        // dimensions or texel format differ from T gives an empty view.
+        template <typename T>
+        [[nodiscard]]
+        auto GetTexture1D(char const* const name) const -> TextureView1D<T>
+        {
+            auto const section = FindTexture<T>(name, 1);
+            return section ? TextureView1D<T>(GetTexels<T>(*section), section->resolution[0]) : TextureView1D<T>();
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto GetTexture2D(char const* const name) const -> TextureView2D<T>
+        {
+            auto const section = FindTexture<T>(name, 2);
+            return section ? TextureView2D<T>(GetTexels<T>(*section), GetLayout(*section)) : TextureView2D<T>();
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto GetTexture3D(char const* const name) const -> TextureView3D<T>
+        {
+            auto const section = FindTexture<T>(name, 3);
+            return section
+                ? TextureView3D<T>(GetTexels<T>(*section), GetLayout(*section), section->resolution[2])
+                : TextureView3D<T>();
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto GetTexture4D(char const* const name) const -> TextureView4D<T>
+        {
+            auto const section = FindTexture<T>(name, 4);
+            return section
+                ? TextureView4D<T>(GetTexels<T>(*section), GetLayout(*section), section->resolution[2], section->resolution[3])
+                : TextureView4D<T>();
+        }
+
+        // Compares the checksums of every section that has one, reading all payloads.
+        [[nodiscard]]
+        auto Verify() const -> bool
+        {
+            for(std::size_t i = 0; i < GetSectionCount(); ++i)
+            {
+                auto const& section = GetSection(i);
+                if(section.checksum != 0 && Checksum(bytes + section.offset, section.size) != section.checksum)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // FNV-1a over whole 64-bit words in four interleaved streams, then over the remaining bytes. Never zero, which
+        // marks a missing checksum.
+        [[nodiscard]]
+        static auto Checksum(void const* const data, std::size_t const size) -> std::uint64_t
+        {
+            auto constexpr Prime = 1099511628211ull;
+
+            auto const* const byteData = static_cast<unsigned char const*>(data);
+            std::uint64_t streams[4] = { 14695981039346656037ull, 1, 2, 3 };
+
+            auto const wordCount = size / sizeof(std::uint64_t);
+            std::size_t i = 0;
+            for(; i + 4 <= wordCount; i += 4)
+            {
+                for(auto s = 0; s < 4; ++s)
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, byteData + (i + s) * sizeof word, sizeof word);
+                    streams[s] = (streams[s] ^ word) * Prime;
+                }
+            }
+
+            auto hash = streams[0];
+            for(auto s = 1; s < 4; ++s)
+            {
+                hash = (hash ^ streams[s]) * Prime;
+            }
+            for(auto b = i * sizeof(std::uint64_t); b < size; ++b)
+            {
+                hash = (hash ^ byteData[b]) * Prime;
+            }
+            return hash != 0 ? hash : 1;
+        }
+
+    private:
+        unsigned char const* bytes = nullptr;
+        std::size_t byteCount = 0;
+#if defined(_WIN32)
+        HANDLE mapping = nullptr;
+#endif
+
+        auto Map(std::filesystem::path const& path) -> bool
+        {
+#if defined(_WIN32)
+            auto const file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if(file == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+
+            LARGE_INTEGER size;
+            if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            {
+                CloseHandle(file);
+                return false;
+            }
+
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            if(mapping == nullptr)
+            {
+                return false;
+            }
+
+            bytes = static_cast<unsigned char const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            byteCount = static_cast<std::size_t>(size.QuadPart);
+            if(bytes == nullptr)
+            {
+                CloseHandle(mapping);
+                mapping = nullptr;
+                return false;
+            }
+            return true;
+#else
+            auto const file = open(path.c_str(), O_RDONLY);
+            if(file < 0)
+            {
+                return false;
+            }
+
+            struct stat status;
+            if(fstat(file, &status) != 0 || status.st_size == 0)
+            {
+                close(file);
+                return false;
+            }
+
+            auto const address = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+            close(file);
+            if(address == MAP_FAILED)
+            {
+                return false;
+            }
+
+            bytes = static_cast<unsigned char const*>(address);
+            byteCount = static_cast<std::size_t>(status.st_size);
+            return true;
+#endif
+        }
+
+        // Every block must lie within the file, so that the accessors never read past the mapping.
+        [[nodiscard]]
+        auto IsValid() const -> bool
+        {
+            auto const within = [this](std::uint64_t const offset, std::uint64_t const size)
+            {
+                return offset <= byteCount && size <= byteCount - offset;
+            };
+
+            if(byteCount < sizeof(FileHeader))
+            {
+                return false;
+            }
+
+            auto const& header = GetHeader();
+            if(std::memcmp(header.magic, Magic, sizeof header.magic) != 0 || header.majorVersion != MajorVersion
+                || header.headerSize < sizeof(FileHeader) || header.metadataSize < sizeof(PlanetMetadata)
+                || header.sectionHeaderSize < sizeof(SectionHeader) || header.fileSize != byteCount
+                || !within(header.metadataOffset, header.metadataSize)
+                || header.metadataOffset % alignof(PlanetMetadata) != 0 || header.sectionsOffset % alignof(SectionHeader) != 0
+                || !within(header.sectionsOffset, std::uint64_t(header.sectionCount) * header.sectionHeaderSize)
+                || GetMetadata().mathMode > static_cast<std::uint32_t>(MathMode::Fast))
+            {
+                return false;
+            }
+
+            for(std::size_t i = 0; i < GetSectionCount(); ++i)
+            {
+                auto const& section = GetSection(i);
+                auto payloadSize = std::uint64_t();
+                if(!within(section.offset, section.size) || section.offset % PayloadAlignment != 0
+                    || !IsShapeValid(section) || !GetPayloadSize(section, payloadSize) || section.size < payloadSize)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Axes past the dimension count must have a resolution of one, so that a section has a single size whatever
+        // the number of axes it is read with.
+        [[nodiscard]]
+        static auto IsShapeValid(SectionHeader const& section) -> bool
+        {
+            if(section.dimensionCount < 1 || section.dimensionCount > 4 || section.channelCount < 1
+                || section.layout > static_cast<std::uint32_t>(TextureLayout::Morton))
+            {
+                return false;
+            }
+
+            for(std::uint32_t axis = 0; axis < 4; ++axis)
+            {
+                auto const resolution = section.resolution[axis];
+                if(axis < section.dimensionCount ? resolution < 1 || resolution > MaxAxisResolution : resolution != 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Bytes of the texels of a section of valid shape, false when they do not fit in 64 bits.
+        [[nodiscard]]
+        static auto GetPayloadSize(SectionHeader const& section, std::uint64_t& size) -> bool
+        {
+            auto const multiply = [&size](std::uint64_t const factor)
+            {
+                if(size > std::numeric_limits<std::uint64_t>::max() / factor)
+                {
+                    return false;
+                }
+                size *= factor;
+                return true;
+            };
+
+            size = std::uint64_t(section.channelCount) * sizeof(float);
+            return multiply(section.dimensionCount == 1 ? section.resolution[0] : GetLayout(section).GetSize())
+                && multiply(section.resolution[2]) && multiply(section.resolution[3]);
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto FindTexture(char const* const name, std::uint32_t const dimensionCount) const -> SectionHeader const*
+        {
+            auto const section = FindSection(name);
+            if(section == nullptr || section->dimensionCount != dimensionCount || section->channelType != ChannelType::Float32
+                || section->channelCount * sizeof(float) != sizeof(T))
+            {
+                return nullptr;
+            }
+            return section;
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto GetTexels(SectionHeader const& section) const -> T const*
+        {
+            return reinterpret_cast<T const*>(bytes + section.offset);
+        }
+
+        [[nodiscard]]
+        static auto GetLayout(SectionHeader const& section) -> TextureLayout2D
+        {
+            return TextureLayout2D(section.resolution[0], section.resolution[1], static_cast<TextureLayout>(section.layout));
+        }
+
+        friend class TableFileWriter;
+
+        static constexpr char Magic[8] = { 'A', 'T', 'M', 'O', 'S', 'T', 'B', 'L' };
+    };
+
+    // Collects textures and writes them as a TableFile. The textures are referenced, not copied, and must outlive
+    // Write.
+    class TableFileWriter final
+    {
+    public:
+        // Mappings are the enums each axis of the texture was computed with, in u, v, w, q order.
+        template <typename Texture, typename... Mappings>
+        auto Add(char const* const name, Texture const& texture, Mappings const... mappings) -> TableFileWriter&
+        {
+            static_assert(sizeof...(Mappings) <= 4, "Textures have at most four axes.");
+
+            using Texel = std::remove_const_t<std::remove_reference_t<decltype(*texture.data())>>;
+            static_assert(sizeof(Texel) % sizeof(float) == 0, "Texels are stored as 32-bit float channels.");
+
+            auto section = TableFile::SectionHeader();
+            std::strncpy(section.name, name, sizeof section.name - 1);
+            section.channelType = TableFile::ChannelType::Float32;
+            section.channelCount = static_cast<std::uint32_t>(sizeof(Texel) / sizeof(float));
+            SetShape(section, texture);
+
+            std::uint32_t const axisMappings[] = { static_cast<std::uint32_t>(mappings)..., 0 };
+            std::copy(axisMappings, axisMappings + sizeof...(Mappings), section.axisMappings);
+
+            section.size = texture.GetSize() * sizeof(Texel);
+            sections.push_back(section);
+            payloads.push_back(texture.data());
+            return *this;
+        }
+
+        // Writes every added texture, computing their checksums unless told not to.
+        auto Write(std::filesystem::path const& path, PlanetProperties const& pp, bool const checksums = true) -> void
+        {
+            auto fout = std::ofstream(path, std::ios::out | std::ios::binary);
+            if(!fout)
+            {
+                throw;
+            }
+
+            auto header = TableFile::FileHeader();
+            std::copy(std::begin(TableFile::Magic), std::end(TableFile::Magic), header.magic);
+            header.majorVersion = TableFile::MajorVersion;
+            header.minorVersion = TableFile::MinorVersion;
+            header.headerSize = sizeof(TableFile::FileHeader);
+            header.metadataSize = sizeof(TableFile::PlanetMetadata);
+            header.sectionHeaderSize = sizeof(TableFile::SectionHeader);
+            header.sectionCount = static_cast<std::uint32_t>(sections.size());
+            header.metadataOffset = Align(sizeof(TableFile::FileHeader), alignof(TableFile::PlanetMetadata));
+            header.sectionsOffset = Align(header.metadataOffset + sizeof(TableFile::PlanetMetadata), alignof(TableFile::SectionHeader));
+
+            auto offset = header.sectionsOffset + sections.size() * sizeof(TableFile::SectionHeader);
+            for(std::size_t i = 0; i < sections.size(); ++i)
+            {
+                offset = Align(offset, TableFile::PayloadAlignment);
+                sections[i].offset = offset;
+                sections[i].checksum = checksums ? TableFile::Checksum(payloads[i], sections[i].size) : 0;
+                offset += sections[i].size;
+            }
+            header.fileSize = offset;
+
+            auto const metadata = GetMetadata(pp);
+            auto position = std::uint64_t(0);
+            auto const writeAt = [&](std::uint64_t const at, void const* const data, std::uint64_t const size)
+            {
+                char const padding[TableFile::PayloadAlignment] = {};
+                fout.write(padding, static_cast<std::streamsize>(at - position));
+                fout.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+                position = at + size;
+            };
+
+            writeAt(0, &header, sizeof header);
+            writeAt(header.metadataOffset, &metadata, sizeof metadata);
+            writeAt(header.sectionsOffset, sections.data(), sections.size() * sizeof(TableFile::SectionHeader));
+            for(std::size_t i = 0; i < sections.size(); ++i)
+            {
+                writeAt(sections[i].offset, payloads[i], sections[i].size);
+            }
+
+            if(!fout)
+            {
+                throw;
+            }
+        }
+
+    private:
+        std::vector<TableFile::SectionHeader> sections;
+        std::vector<void const*> payloads;
+
+        [[nodiscard]]
+        static auto Align(std::uint64_t const offset, std::uint64_t const alignment) -> std::uint64_t
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        [[nodiscard]]
+        static auto GetMetadata(PlanetProperties const& pp) -> TableFile::PlanetMetadata
+        {
+            auto const copy = [](Vector3 const& c, float (&out)[3])
+            {
+                out[0] = c.x;
+                out[1] = c.y;
+                out[2] = c.z;
+            };
+
+            auto metadata = TableFile::PlanetMetadata();
+            metadata.planetRadius = pp.GetPlanetRadius();
+            metadata.atmosphereHeight = pp.GetAtmosphereHeight();
+            copy(pp.GetRayleightScatteringCoef(), metadata.rayleightScatteringCoef);
+            copy(pp.GetRayleightExtinctionCoef(), metadata.rayleightExtinctionCoef);
+            copy(pp.GetMieScatteringCoef(), metadata.mieScatteringCoef);
+            copy(pp.GetMieExtinctionCoef(), metadata.mieExtinctionCoef);
+            metadata.rayleightScaleHeight = pp.GetRayleightScaleHeight();
+            metadata.mieScaleHeight = pp.GetMieScaleHeight();
+            metadata.mieAsymmetryCoef = pp.GetMieAsymmetryCoef();
+            metadata.mathMode = static_cast<std::uint32_t>(pp.GetMathMode());
+            return metadata;
+        }
+
+        template <typename T>
+        static auto SetShape(TableFile::SectionHeader& section, Texture1D<T> const& texture) -> void
+        {
+            SetShape(section, 1, TextureLayout::Linear, texture.GetUResolution(), 1, 1, 1);
+        }
+
+        template <typename T>
+        static auto SetShape(TableFile::SectionHeader& section, Texture2D<T> const& texture) -> void
+        {
+            SetShape(section, 2, texture.GetLayout(), texture.GetUResolution(), texture.GetVResolution(), 1, 1);
+        }
+
+        template <typename T>
+        static auto SetShape(TableFile::SectionHeader& section, Texture3D<T> const& texture) -> void
+        {
+            SetShape(section, 3, texture.GetLayout(), texture.GetUResolution(), texture.GetVResolution(),
+                texture.GetWResolution(), 1);
+        }
+
+        template <typename T>
+        static auto SetShape(TableFile::SectionHeader& section, Texture4D<T> const& texture) -> void
+        {
+            SetShape(section, 4, texture.GetLayout(), texture.GetUResolution(), texture.GetVResolution(),
+                texture.GetWResolution(), texture.GetQResolution());
+        }
+
+        static auto SetShape(
+            TableFile::SectionHeader& section,
+            std::uint32_t const dimensionCount,
+            TextureLayout const layout,
+            std::uint64_t const u,
+            std::uint64_t const v,
+            std::uint64_t const w,
+            std::uint64_t const q) -> void
+        {
+            section.dimensionCount = dimensionCount;
+            section.layout = static_cast<std::uint32_t>(layout);
+            section.resolution[0] = u;
+            section.resolution[1] = v;
+            section.resolution[2] = w;
+            section.resolution[3] = q;
+        }
+    };
+}
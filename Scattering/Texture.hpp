@@ -1,19 +1,268 @@
 #pragma once
 
 #include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
 
 namespace Atmos
 {
+    // Texel buffers are aligned to cache lines so that rows and slices can be streamed and loaded with vector
+    // instructions.
+    template <typename T, std::size_t Alignment = 64>
+    class AlignedAllocator
+    {
+    public:
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+
+        template <typename U>
+        AlignedAllocator(AlignedAllocator<U, Alignment> const&)
+        { }
+
+        [[nodiscard]]
+        auto allocate(std::size_t const count) -> T*
+        {
+            return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        auto deallocate(T* const p, std::size_t const) -> void
+        {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+
+        // Value initialization of plain texels is left to FirstTouch, so that new buffers are not written by the
+        // allocating thread.
+        template <typename U>
+        auto construct(U* const p) -> void
+        {
+            if constexpr(!std::is_trivially_copyable_v<U> || !std::is_trivially_destructible_v<U>)
+            {
+                ::new(static_cast<void*>(p)) U();
+            }
+        }
+
+        template <typename U>
+        auto operator==(AlignedAllocator<U, Alignment> const&) const -> bool
+        {
+            return true;
+        }
+
+        template <typename U>
+        auto operator!=(AlignedAllocator<U, Alignment> const&) const -> bool
+        {
+            return false;
+        }
+    };
+
     template <typename T>
-    class Texture1D final
+    using TextureBuffer = std::vector<T, AlignedAllocator<T>>;
+
+    // Value-initializes the texels of a new buffer in blocks spread over the threads by the static schedule, the same
+    // split Scheduler starts from, so that on NUMA systems each page lands on the node of the thread that computes it.
+    template <typename T>
+    auto FirstTouch(TextureBuffer<T>& texels) -> void
+    {
+        constexpr auto BlockSize = std::size_t(16384) / sizeof(T) + 1;
+        auto const blockCount = static_cast<int>((texels.size() + BlockSize - 1) / BlockSize);
+
+        #pragma omp parallel for schedule(static) if(blockCount > 1)
+        for(auto block = 0; block < blockCount; ++block)
+        {
+            auto const first = texels.data() + static_cast<std::size_t>(block) * BlockSize;
+            auto const last = texels.data() + std::min(static_cast<std::size_t>(block + 1) * BlockSize, texels.size());
+            std::fill(first, last, T());
+        }
+    }
+
+    enum class TextureLayout
+    {
+        // Row after row, v * uResolution + u.
+        Linear,
+        // 8x8 texel tiles stored row after row, each tile itself row after row.
+        Tiled,
+        // Z-order curve over the texture padded to powers of two.
+        Morton
+    };
+
+    // Where texel (u, v) of a slice lives in memory for a given layout.
+    class TextureLayout2D final
     {
     public:
-        Texture1D()
-            : uResolution(0), data()
+        static constexpr std::size_t TileSize = 8;
+
+        TextureLayout2D()
+            : layout(TextureLayout::Linear), uResolution(0), vResolution(0), uTiles(0), vTiles(0), uBits(0), vBits(0)
         { }
-    
-        explicit Texture1D(std::size_t const uResolution)
-            : uResolution(uResolution), data(uResolution)
+
+        TextureLayout2D(std::size_t const uResolution, std::size_t const vResolution, TextureLayout const layout)
+            : layout(layout), uResolution(uResolution), vResolution(vResolution),
+            uTiles((uResolution + TileSize - 1) / TileSize), vTiles((vResolution + TileSize - 1) / TileSize),
+            uBits(CeilLog2(uResolution)), vBits(CeilLog2(vResolution))
+        { }
+
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v) const -> std::size_t
+        {
+            switch(layout)
+            {
+            case TextureLayout::Linear:
+                return v * uResolution + u;
+            case TextureLayout::Tiled:
+                return ((v / TileSize) * uTiles + u / TileSize) * TileSize * TileSize + (v % TileSize) * TileSize + u % TileSize;
+            case TextureLayout::Morton:
+                return MortonOffset(u, v);
+            }
+            return 0;
+        }
+
+        // Number of texels a slice occupies, including padding.
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            switch(layout)
+            {
+            case TextureLayout::Linear:
+                return uResolution * vResolution;
+            case TextureLayout::Tiled:
+                return uTiles * vTiles * TileSize * TileSize;
+            case TextureLayout::Morton:
+                return (std::size_t(1) << uBits) * (std::size_t(1) << vBits);
+            }
+            return 0;
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout;
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return uResolution;
+        }
+
+        [[nodiscard]]
+        auto GetVResolution() const -> std::size_t
+        {
+            return vResolution;
+        }
+
+    private:
+        TextureLayout layout;
+        std::size_t uResolution;
+        std::size_t vResolution;
+        std::size_t uTiles;
+        std::size_t vTiles;
+        unsigned uBits;
+        unsigned vBits;
+
+        // Bits are interleaved up to the shorter side, the remaining bits of the longer side go on top.
+        [[nodiscard]]
+        auto MortonOffset(std::size_t const u, std::size_t const v) const -> std::size_t
+        {
+            auto const sharedBits = std::min(uBits, vBits);
+
+            std::size_t offset = 0;
+            for(unsigned bit = 0; bit < sharedBits; ++bit)
+            {
+                offset |= ((u >> bit) & 1) << (2 * bit);
+                offset |= ((v >> bit) & 1) << (2 * bit + 1);
+            }
+
+            return offset | (u >> sharedBits) << (2 * sharedBits) | (v >> sharedBits) << (2 * sharedBits);
+        }
+
+        [[nodiscard]]
+        auto static CeilLog2(std::size_t const value) -> unsigned
+        {
+            unsigned bits = 0;
+            while((std::size_t(1) << bits) < value)
+            {
+                ++bits;
+            }
+            return bits;
+        }
+    };
+
+    template <typename Texel>
+    class TextureRow final
+    {
+    public:
+        TextureRow(Texel* const texels, TextureLayout2D const& layout, std::size_t const v)
+            : texels(texels), layout(&layout), v(v)
+        { }
+
+        auto operator[](std::size_t const u) const -> Texel&
+        {
+            return texels[layout->Offset(u, v)];
+        }
+
+    private:
+        Texel* texels;
+        TextureLayout2D const* layout;
+        std::size_t v;
+    };
+
+    template <typename Texel>
+    class TextureSlice final
+    {
+    public:
+        TextureSlice(Texel* const texels, TextureLayout2D const& layout)
+            : texels(texels), layout(&layout)
+        { }
+
+        auto operator[](std::size_t const v) const -> TextureRow<Texel>
+        {
+            return TextureRow<Texel>(texels, *layout, v);
+        }
+
+    private:
+        Texel* texels;
+        TextureLayout2D const* layout;
+    };
+
+    template <typename Texel>
+    class TextureVolume final
+    {
+    public:
+        TextureVolume(Texel* const texels, TextureLayout2D const& layout, std::size_t const sliceStride)
+            : texels(texels), layout(&layout), sliceStride(sliceStride)
+        { }
+
+        auto operator[](std::size_t const w) const -> TextureSlice<Texel>
+        {
+            return TextureSlice<Texel>(texels + w * sliceStride, *layout);
+        }
+
+    private:
+        Texel* texels;
+        TextureLayout2D const* layout;
+        std::size_t sliceStride;
+    };
+
+    // Read-only textures over texels owned elsewhere, such as a TextureND or a mapped TableFile section. The
+    // textures sample through their views, so both filter alike.
+    template <typename T>
+    class TextureView1D final
+    {
+    public:
+        TextureView1D()
+            : uResolution(0), texels(nullptr)
+        { }
+
+        TextureView1D(T const* const texels, std::size_t const uResolution)
+            : uResolution(uResolution), texels(texels)
         { }
 
         auto Sample(float const u) const -> T
@@ -23,23 +272,388 @@ namespace Atmos
 
             if(i0 == uResolution - 1)
             {
-                return data[i0];
+                return texels[i0];
             }
 
             auto t = d - i0;
 
 
-            return Lerp(data[i0], data[i0 + 1], t);
+            return Lerp(texels[i0], texels[i0 + 1], t);
+        }
+
+        auto operator[](std::size_t const index) const -> T const&
+        {
+            return texels[index];
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return uResolution;
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels;
+        }
+
+    private:
+        std::size_t uResolution;
+        T const* texels;
+    };
+
+    template <typename T>
+    class TextureView2D final
+    {
+    public:
+        TextureView2D()
+            : layout(), texels(nullptr)
+        { }
+
+        TextureView2D(T const* const texels, TextureLayout2D const& layout)
+            : layout(layout), texels(texels)
+        { }
+
+        auto Sample(float const u, float const v) const -> T
+        {
+            auto const du = u * (GetUResolution() - 1);
+            auto const dv = v * (GetVResolution() - 1);
+            auto const u0 = static_cast<std::size_t>(du);
+            auto const v0 = static_cast<std::size_t>(dv);
+            auto const u1 = std::min(u0 + 1, GetUResolution() - 1);
+            auto const v1 = std::min(v0 + 1, GetVResolution() - 1);
+            auto const tu = du - u0;
+            auto const tv = dv - v0;
+
+            return Lerp(
+                Lerp(texels[layout.Offset(u0, v0)], texels[layout.Offset(u1, v0)], tu),
+                Lerp(texels[layout.Offset(u0, v1)], texels[layout.Offset(u1, v1)], tu),
+                tv);
+        }
+
+        auto operator[](std::size_t const index) const -> TextureRow<T const>
+        {
+            return TextureRow<T const>(texels, layout, index);
+        }
+
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v) const -> std::size_t
+        {
+            return layout.Offset(u, v);
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return layout.GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetVResolution() const -> std::size_t
+        {
+            return layout.GetVResolution();
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return layout.GetSize();
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels;
+        }
+
+    private:
+        TextureLayout2D layout;
+        T const* texels;
+    };
+
+    template <typename T>
+    class TextureView3D final
+    {
+    public:
+        TextureView3D()
+            : wResolution(0), layout(), sliceStride(0), texels(nullptr)
+        { }
+
+        TextureView3D(T const* const texels, TextureLayout2D const& layout, std::size_t const wResolution)
+            : wResolution(wResolution), layout(layout), sliceStride(layout.GetSize()), texels(texels)
+        { }
+
+        auto Sample(float const u, float const v, float const w) const -> T
+        {
+            auto const du = u * (GetUResolution() - 1);
+            auto const dv = v * (GetVResolution() - 1);
+            auto const dw = w * (wResolution - 1);
+            auto const u0 = static_cast<std::size_t>(du);
+            auto const v0 = static_cast<std::size_t>(dv);
+            auto const w0 = static_cast<std::size_t>(dw);
+            auto const u1 = std::min(u0 + 1, GetUResolution() - 1);
+            auto const v1 = std::min(v0 + 1, GetVResolution() - 1);
+            auto const w1 = std::min(w0 + 1, wResolution - 1);
+            auto const tu = du - u0;
+            auto const tv = dv - v0;
+            auto const tw = dw - w0;
+
+            auto const sample = [&](std::size_t const w)
+            {
+                auto const slice = texels + w * sliceStride;
+                return Lerp(
+                    Lerp(slice[layout.Offset(u0, v0)], slice[layout.Offset(u1, v0)], tu),
+                    Lerp(slice[layout.Offset(u0, v1)], slice[layout.Offset(u1, v1)], tu),
+                    tv);
+            };
+
+            return Lerp(sample(w0), sample(w1), tw);
+        }
+
+        auto operator[](std::size_t const index) const -> TextureSlice<T const>
+        {
+            return TextureSlice<T const>(texels + index * sliceStride, layout);
+        }
+
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v, std::size_t const w) const -> std::size_t
+        {
+            return w * sliceStride + layout.Offset(u, v);
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        // Distance between texels of adjacent slices.
+        [[nodiscard]]
+        auto GetSliceStride() const -> std::size_t
+        {
+            return sliceStride;
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return layout.GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetVResolution() const -> std::size_t
+        {
+            return layout.GetVResolution();
+        }
+
+        [[nodiscard]]
+        auto GetWResolution() const -> std::size_t
+        {
+            return wResolution;
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return sliceStride * wResolution;
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels;
+        }
+
+    private:
+        std::size_t wResolution;
+        TextureLayout2D layout;
+        std::size_t sliceStride;
+        T const* texels;
+    };
+
+    template <typename T>
+    class TextureView4D final
+    {
+    public:
+        TextureView4D()
+            : wResolution(0), qResolution(0), layout(), sliceStride(0), volumeStride(0), texels(nullptr)
+        { }
+
+        TextureView4D(
+            T const* const texels,
+            TextureLayout2D const& layout,
+            std::size_t const wResolution,
+            std::size_t const qResolution)
+            : wResolution(wResolution), qResolution(qResolution), layout(layout), sliceStride(layout.GetSize()),
+            volumeStride(sliceStride * wResolution), texels(texels)
+        { }
+
+        // Quadrilinear filtering, the two nearest volumes filtered trilinearly and blended.
+        auto Sample(float const u, float const v, float const w, float const q) const -> T
+        {
+            auto const du = u * (GetUResolution() - 1);
+            auto const dv = v * (GetVResolution() - 1);
+            auto const dw = w * (wResolution - 1);
+            auto const dq = q * (qResolution - 1);
+            auto const u0 = static_cast<std::size_t>(du);
+            auto const v0 = static_cast<std::size_t>(dv);
+            auto const w0 = static_cast<std::size_t>(dw);
+            auto const q0 = static_cast<std::size_t>(dq);
+            auto const u1 = std::min(u0 + 1, GetUResolution() - 1);
+            auto const v1 = std::min(v0 + 1, GetVResolution() - 1);
+            auto const w1 = std::min(w0 + 1, wResolution - 1);
+            auto const q1 = std::min(q0 + 1, qResolution - 1);
+            auto const tu = du - u0;
+            auto const tv = dv - v0;
+            auto const tw = dw - w0;
+            auto const tq = dq - q0;
+
+            auto const sample = [&](std::size_t const w, std::size_t const q)
+            {
+                auto const slice = texels + q * volumeStride + w * sliceStride;
+                return Lerp(
+                    Lerp(slice[layout.Offset(u0, v0)], slice[layout.Offset(u1, v0)], tu),
+                    Lerp(slice[layout.Offset(u0, v1)], slice[layout.Offset(u1, v1)], tu),
+                    tv);
+            };
+
+            return Lerp(
+                Lerp(sample(w0, q0), sample(w1, q0), tw),
+                Lerp(sample(w0, q1), sample(w1, q1), tw),
+                tq);
+        }
+
+        auto operator[](std::size_t const index) const -> TextureVolume<T const>
+        {
+            return TextureVolume<T const>(texels + index * volumeStride, layout, sliceStride);
+        }
+
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v, std::size_t const w, std::size_t const q) const -> std::size_t
+        {
+            return q * volumeStride + w * sliceStride + layout.Offset(u, v);
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        // Distance between texels of adjacent slices.
+        [[nodiscard]]
+        auto GetSliceStride() const -> std::size_t
+        {
+            return sliceStride;
+        }
+
+        // Distance between texels of adjacent volumes.
+        [[nodiscard]]
+        auto GetVolumeStride() const -> std::size_t
+        {
+            return volumeStride;
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return layout.GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetVResolution() const -> std::size_t
+        {
+            return layout.GetVResolution();
+        }
+
+        [[nodiscard]]
+        auto GetWResolution() const -> std::size_t
+        {
+            return wResolution;
+        }
+
+        [[nodiscard]]
+        auto GetQResolution() const -> std::size_t
+        {
+            return qResolution;
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return volumeStride * qResolution;
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels;
+        }
+
+    private:
+        std::size_t wResolution;
+        std::size_t qResolution;
+        TextureLayout2D layout;
+        std::size_t sliceStride;
+        std::size_t volumeStride;
+        T const* texels;
+    };
+
+    template <typename T>
+    class Texture1D final
+    {
+    public:
+        Texture1D()
+            : uResolution(0), texels()
+        { }
+
+        explicit Texture1D(std::size_t const uResolution)
+            : uResolution(uResolution), texels(uResolution)
+        {
+            FirstTouch(texels);
+        }
+
+        auto Sample(float const u) const -> T
+        {
+            return GetView().Sample(u);
         }
 
         auto operator[](std::size_t const index) -> T&
         {
-            return data[index];
+            return texels[index];
         }
 
         auto operator[](std::size_t const index) const -> T const&
         {
-            return data[index];
+            return texels[index];
         }
 
         [[nodiscard]]
@@ -47,16 +661,40 @@ namespace Atmos
         {
             return static_cast<float>(index) / uResolution + 1.0f / (2.0f * static_cast<float>(uResolution));
         }
-    
+
         [[nodiscard]]
         auto GetUResolution() const -> std::size_t
         {
             return uResolution;
         }
 
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return texels.size();
+        }
+
+        [[nodiscard]]
+        auto GetView() const -> TextureView1D<T>
+        {
+            return TextureView1D<T>(texels.data(), uResolution);
+        }
+
+        [[nodiscard]]
+        auto data() -> T*
+        {
+            return texels.data();
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels.data();
+        }
+
     private:
         std::size_t uResolution;
-        std::vector<T> data;
+        TextureBuffer<T> texels;
     };
 
     template <typename T>
@@ -64,70 +702,100 @@ namespace Atmos
     {
     public:
         Texture2D()
-            : vResolution(0), data()
+            : layout(), texels()
         { }
-    
-        Texture2D(std::size_t const uResolution, std::size_t const vResolution)
-            : vResolution(vResolution), data(vResolution)
+
+        Texture2D(std::size_t const uResolution, std::size_t const vResolution, TextureLayout const layout = TextureLayout::Linear)
+            : layout(uResolution, vResolution, layout), texels(this->layout.GetSize())
         {
-            for(std::size_t i = 0; i < vResolution; ++i)
-            {
-                data[i] = Texture1D<T>(uResolution);
-            }
+            FirstTouch(texels);
         }
 
         auto Sample(float const u, float const v) const -> T
         {
-            auto const d = v * (vResolution - 1);
-            auto const i0 = static_cast<std::size_t>(d);
-
-            if(i0 == vResolution - 1)
-            {
-                return data[i0].Sample(u);
-            }
-
-            auto t = d - i0;
+            return GetView().Sample(u, v);
+        }
 
-            return Lerp(data[i0].Sample(u), data[i0 + 1].Sample(u), t);
+        auto operator[](std::size_t const index) -> TextureRow<T>
+        {
+            return TextureRow<T>(texels.data(), layout, index);
         }
 
-        auto operator[](std::size_t index) -> Texture1D<T>&
+        auto operator[](std::size_t const index) const -> TextureRow<T const>
         {
-            return data[index];
+            return TextureRow<T const>(texels.data(), layout, index);
         }
 
-        auto operator[](std::size_t index) const -> Texture1D<T> const&
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v) const -> std::size_t
         {
-            return data[index];
+            return layout.Offset(u, v);
         }
-    
+
         [[nodiscard]]
         auto IndexToV(std::size_t const index) const -> float
         {
-            return static_cast<float>(index) / vResolution + 1.0f / (2.0f * static_cast<float>(vResolution));
+            return static_cast<float>(index) / GetVResolution() + 1.0f / (2.0f * static_cast<float>(GetVResolution()));
         }
 
         auto IndexToU(std::size_t const index) const -> float
         {
-            return data[0].IndexToU(index);
+            return static_cast<float>(index) / GetUResolution() + 1.0f / (2.0f * static_cast<float>(GetUResolution()));
         }
 
 
         [[nodiscard]]
         auto GetUResolution() const -> std::size_t
         {
-            return data[0].GetUResolution();
+            return layout.GetUResolution();
         }
-    
+
         [[nodiscard]]
         auto GetVResolution() const -> std::size_t
         {
-            return vResolution;
+            return layout.GetVResolution();
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return texels.size();
+        }
+
+        [[nodiscard]]
+        auto GetView() const -> TextureView2D<T>
+        {
+            return TextureView2D<T>(texels.data(), layout);
+        }
+
+        [[nodiscard]]
+        auto data() -> T*
+        {
+            return texels.data();
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels.data();
         }
 
     private:
-        std::size_t vResolution;
-        std::vector<Texture1D<T>> data;
+        TextureLayout2D layout;
+        TextureBuffer<T> texels;
     };
 
     template <typename T>
@@ -135,41 +803,39 @@ namespace Atmos
     {
     public:
         Texture3D()
-            : wResolution(0), data()
+            : wResolution(0), layout(), sliceStride(0), texels()
         { }
 
-        Texture3D(std::size_t const uResolution, std::size_t const vResolution, std::size_t const wResolution)
-            : wResolution(wResolution), data(wResolution)
+        Texture3D(
+            std::size_t const uResolution,
+            std::size_t const vResolution,
+            std::size_t const wResolution,
+            TextureLayout const layout = TextureLayout::Linear)
+            : wResolution(wResolution), layout(uResolution, vResolution, layout), sliceStride(this->layout.GetSize()),
+            texels(sliceStride * wResolution)
         {
-            for(std::size_t i = 0; i < wResolution; ++i)
-            {
-                data[i] = Texture2D<Vector3>(uResolution, vResolution);
-            }
+            FirstTouch(texels);
         }
 
         auto Sample(float const u, float const v, float const w) const -> T
         {
-            auto const d = w * (wResolution - 1);
-            auto const i0 = static_cast<std::size_t>(d);
-
-            if(i0 == wResolution - 1)
-            {
-                return data[i0].Sample(u, v);
-            }
-
-            auto t = d - i0;
+            return GetView().Sample(u, v, w);
+        }
 
-            return Lerp(data[i0].Sample(u, v), data[i0 + 1].Sample(u, v), t);
+        auto operator[](std::size_t const index) -> TextureSlice<T>
+        {
+            return TextureSlice<T>(texels.data() + index * sliceStride, layout);
         }
 
-        auto operator[](std::size_t index) -> Texture2D<T> &
+        auto operator[](std::size_t const index) const -> TextureSlice<T const>
         {
-            return data[index];
+            return TextureSlice<T const>(texels.data() + index * sliceStride, layout);
         }
 
-        auto operator[](std::size_t index) const -> Texture2D<T> const&
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v, std::size_t const w) const -> std::size_t
         {
-            return data[index];
+            return w * sliceStride + layout.Offset(u, v);
         }
 
         [[nodiscard]]
@@ -180,25 +846,25 @@ namespace Atmos
 
         auto IndexToV(std::size_t const index) const -> float
         {
-            return data[0].IndexToV(index);
+            return static_cast<float>(index) / GetVResolution() + 1.0f / (2.0f * static_cast<float>(GetVResolution()));
         }
 
         auto IndexToU(std::size_t const index) const -> float
         {
-            return data[0].IndexToU(index);
+            return static_cast<float>(index) / GetUResolution() + 1.0f / (2.0f * static_cast<float>(GetUResolution()));
         }
 
 
         [[nodiscard]]
         auto GetUResolution() const -> std::size_t
         {
-            return data[0].GetUResolution();
+            return layout.GetUResolution();
         }
 
         [[nodiscard]]
         auto GetVResolution() const -> std::size_t
         {
-            return data[0].GetVResolution();
+            return layout.GetVResolution();
         }
 
         [[nodiscard]]
@@ -207,8 +873,182 @@ namespace Atmos
             return wResolution;
         }
 
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        // Distance between texels of adjacent slices.
+        [[nodiscard]]
+        auto GetSliceStride() const -> std::size_t
+        {
+            return sliceStride;
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return texels.size();
+        }
+
+        [[nodiscard]]
+        auto GetView() const -> TextureView3D<T>
+        {
+            return TextureView3D<T>(texels.data(), layout, wResolution);
+        }
+
+        [[nodiscard]]
+        auto data() -> T*
+        {
+            return texels.data();
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels.data();
+        }
+
+    private:
+        std::size_t wResolution;
+        TextureLayout2D layout;
+        std::size_t sliceStride;
+        TextureBuffer<T> texels;
+    };
+
+    // Volumes of slices, indexed as tex[q][w][v][u].
+    template <typename T>
+    class Texture4D final
+    {
+    public:
+        Texture4D()
+            : wResolution(0), qResolution(0), layout(), sliceStride(0), volumeStride(0), texels()
+        { }
+
+        Texture4D(
+            std::size_t const uResolution,
+            std::size_t const vResolution,
+            std::size_t const wResolution,
+            std::size_t const qResolution,
+            TextureLayout const layout = TextureLayout::Linear)
+            : wResolution(wResolution), qResolution(qResolution), layout(uResolution, vResolution, layout),
+            sliceStride(this->layout.GetSize()), volumeStride(sliceStride * wResolution),
+            texels(volumeStride * qResolution)
+        {
+            FirstTouch(texels);
+        }
+
+        // Quadrilinear filtering, the two nearest volumes filtered trilinearly and blended.
+        auto Sample(float const u, float const v, float const w, float const q) const -> T
+        {
+            return GetView().Sample(u, v, w, q);
+        }
+
+        auto operator[](std::size_t const index) -> TextureVolume<T>
+        {
+            return TextureVolume<T>(texels.data() + index * volumeStride, layout, sliceStride);
+        }
+
+        auto operator[](std::size_t const index) const -> TextureVolume<T const>
+        {
+            return TextureVolume<T const>(texels.data() + index * volumeStride, layout, sliceStride);
+        }
+
+        [[nodiscard]]
+        auto Offset(std::size_t const u, std::size_t const v, std::size_t const w, std::size_t const q) const -> std::size_t
+        {
+            return q * volumeStride + w * sliceStride + layout.Offset(u, v);
+        }
+
+        [[nodiscard]]
+        auto GetUResolution() const -> std::size_t
+        {
+            return layout.GetUResolution();
+        }
+
+        [[nodiscard]]
+        auto GetVResolution() const -> std::size_t
+        {
+            return layout.GetVResolution();
+        }
+
+        [[nodiscard]]
+        auto GetWResolution() const -> std::size_t
+        {
+            return wResolution;
+        }
+
+        [[nodiscard]]
+        auto GetQResolution() const -> std::size_t
+        {
+            return qResolution;
+        }
+
+        [[nodiscard]]
+        auto GetLayout() const -> TextureLayout
+        {
+            return layout.GetLayout();
+        }
+
+        // Distance between vertically adjacent texels, only meaningful for TextureLayout::Linear.
+        [[nodiscard]]
+        auto GetRowStride() const -> std::size_t
+        {
+            return GetUResolution();
+        }
+
+        // Distance between texels of adjacent slices.
+        [[nodiscard]]
+        auto GetSliceStride() const -> std::size_t
+        {
+            return sliceStride;
+        }
+
+        // Distance between texels of adjacent volumes.
+        [[nodiscard]]
+        auto GetVolumeStride() const -> std::size_t
+        {
+            return volumeStride;
+        }
+
+        [[nodiscard]]
+        auto GetSize() const -> std::size_t
+        {
+            return texels.size();
+        }
+
+        [[nodiscard]]
+        auto GetView() const -> TextureView4D<T>
+        {
+            return TextureView4D<T>(texels.data(), layout, wResolution, qResolution);
+        }
+
+        [[nodiscard]]
+        auto data() -> T*
+        {
+            return texels.data();
+        }
+
+        [[nodiscard]]
+        auto data() const -> T const*
+        {
+            return texels.data();
+        }
+
     private:
         std::size_t wResolution;
-        std::vector<Texture2D<T>> data;
+        std::size_t qResolution;
+        TextureLayout2D layout;
+        std::size_t sliceStride;
+        std::size_t volumeStride;
+        TextureBuffer<T> texels;
     };
-}
\ No newline at end of file
+}
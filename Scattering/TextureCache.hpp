@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include "CacheKey.hpp"
+#include "Texture.hpp"
+
+namespace Atmos
+{
+    // Directory of finished textures, one file per CacheKey. Entries are written to a temporary file and renamed
+    // into place, so jobs sharing the directory only ever see complete entries. The cache is best effort: a failed
+    // write leaves nothing behind and a missing or mismatching entry is a miss.
+    class TextureCache final
+    {
+        std::filesystem::path directory;
+
+        struct Shape final
+        {
+            std::uint64_t uResolution;
+            std::uint64_t vResolution;
+            std::uint64_t wResolution;
+            std::uint64_t qResolution;
+            std::uint64_t layout;
+            std::uint64_t texelCount;
+        };
+
+        struct Header final
+        {
+            char magic[4];
+            std::uint32_t codeVersion;
+            std::uint64_t key;
+            std::uint64_t texelSize;
+            Shape shape;
+        };
+
+    public:
+        explicit TextureCache(std::filesystem::path directory)
+            : directory(std::move(directory))
+        { }
+
+        // Fills the texture, which must already have the resolution and layout of the entry, and reports a hit.
+        template <typename Texture>
+        auto Load(CacheKey const& key, Texture& texture) const -> bool
+        {
+            auto fin = std::ifstream(GetPath(key), std::ios::in | std::ios::binary);
+            if(!fin)
+            {
+                return false;
+            }
+
+            Header header;
+            fin.read(reinterpret_cast<char*>(&header), sizeof header);
+            if(!fin || !Matches(header, MakeHeader(key, texture)))
+            {
+                return false;
+            }
+
+            auto const shape = GetShape(texture);
+            fin.read(reinterpret_cast<char*>(texture.data()), static_cast<std::streamsize>(shape.texelCount * sizeof *texture.data()));
+            return static_cast<bool>(fin);
+        }
+
+        // Reports whether the entry is in place, which includes losing the rename to another job storing the same key.
+        template <typename Texture>
+        auto Store(CacheKey const& key, Texture const& texture) const -> bool
+        {
+            auto error = std::error_code();
+            std::filesystem::create_directories(directory, error);
+
+            auto const path = GetPath(key);
+            auto const temporaryPath = directory / (key.ToString() + "." + GetUniqueSuffix() + ".tmp");
+
+            {
+                auto fout = std::ofstream(temporaryPath, std::ios::out | std::ios::binary);
+                if(!fout)
+                {
+                    return false;
+                }
+
+                auto const header = MakeHeader(key, texture);
+                fout.write(reinterpret_cast<char const*>(&header), sizeof header);
+                fout.write(reinterpret_cast<char const*>(texture.data()),
+                    static_cast<std::streamsize>(header.shape.texelCount * sizeof *texture.data()));
+                fout.close();
+
+                if(!fout)
+                {
+                    std::filesystem::remove(temporaryPath, error);
+                    return false;
+                }
+            }
+
+            std::filesystem::rename(temporaryPath, path, error);
+            if(error)
+            {
+                std::filesystem::remove(temporaryPath, error);
+                return std::filesystem::exists(path, error);
+            }
+
+            return true;
+        }
+
+        [[nodiscard]]
+        auto GetPath(CacheKey const& key) const -> std::filesystem::path
+        {
+            return directory / (key.ToString() + ".tex");
+        }
+
+        [[nodiscard]]
+        auto GetDirectory() const -> std::filesystem::path const&
+        {
+            return directory;
+        }
+
+    private:
+        template <typename Texture>
+        [[nodiscard]]
+        auto static MakeHeader(CacheKey const& key, Texture const& texture) -> Header
+        {
+            return { { 'A', 'T', 'M', 'C' }, CacheKey::CodeVersion, key.GetValue(), sizeof *texture.data(), GetShape(texture) };
+        }
+
+        [[nodiscard]]
+        auto static Matches(Header const& a, Header const& b) -> bool
+        {
+            return std::equal(std::begin(a.magic), std::end(a.magic), std::begin(b.magic))
+                && a.codeVersion == b.codeVersion && a.key == b.key && a.texelSize == b.texelSize
+                && a.shape.uResolution == b.shape.uResolution && a.shape.vResolution == b.shape.vResolution
+                && a.shape.wResolution == b.shape.wResolution && a.shape.qResolution == b.shape.qResolution
+                && a.shape.layout == b.shape.layout && a.shape.texelCount == b.shape.texelCount;
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto static GetShape(Texture1D<T> const& texture) -> Shape
+        {
+            return { texture.GetUResolution(), 1, 1, 1, static_cast<std::uint64_t>(TextureLayout::Linear), texture.GetUResolution() };
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto static GetShape(Texture2D<T> const& texture) -> Shape
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), 1, 1,
+                static_cast<std::uint64_t>(texture.GetLayout()), texture.GetSize() };
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto static GetShape(Texture3D<T> const& texture) -> Shape
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), texture.GetWResolution(), 1,
+                static_cast<std::uint64_t>(texture.GetLayout()), texture.GetSize() };
+        }
+
+        template <typename T>
+        [[nodiscard]]
+        auto static GetShape(Texture4D<T> const& texture) -> Shape
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), texture.GetWResolution(), texture.GetQResolution(),
+                static_cast<std::uint64_t>(texture.GetLayout()), texture.GetSize() };
+        }
+
+        // Distinguishes temporary files of concurrent writers, whether threads of one job or separate processes.
+        [[nodiscard]]
+        auto static GetUniqueSuffix() -> std::string
+        {
+            thread_local auto generator = std::mt19937_64(std::random_device()());
+            return CacheKey("TextureCache").Add(generator()).ToString();
+        }
+    };
+}
@@ -1,70 +1,154 @@
 #pragma once
-#include "Texture.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Texture.hpp"
 #include "Vector3.hpp"
-#include "DirectXPackedVector.h"
+#include "Spectrum.hpp"
+#include "Half.hpp"
 
 namespace Atmos
 {
-
+    // Textures of every dimensionality are written as a stack of rows, u varying fastest, then v, w and q, whatever
+    // their layout. PPM images stack the rows vertically, binary files start with the width, height and depth as
+    // 16-bit integers, the depth of 4D textures being w times q, followed by four halves per texel.
+    //
+    // Rows are converted in parallel into a block of a few megabytes, which is then written with a single call. Spectral
+    // textures are converted to RGB as their rows are, through ToRgb.
     class ExportTexture final
     {
     public:
-        static auto ExportTexturePPM(Texture2D<Vector3> const& texture, char const* const fileName) -> void
+        static auto ExportTexturePPM(Texture1D<Vector3> const& texture, char const* const fileName, float const multiplier) -> void
         {
-            auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
-            if(!fout)
-            {
-                throw;
-            }
+            WritePPM(texture, fileName, multiplier);
+        }
 
-            fout << "P6\n";
-            fout << texture.GetUResolution() << " " << texture.GetVResolution() << "\n255\n";
+        static auto ExportTexturePPM(Texture2D<Vector3> const& texture, char const* const fileName, float const multiplier = 10.0f) -> void
+        {
+            WritePPM(texture, fileName, multiplier);
+        }
 
-            for(size_t i = 0; i < texture.GetVResolution(); ++i)
-            {
-                for(size_t j = 0; j < texture.GetUResolution(); ++j)
-                {
-                    uint8_t color[3];
-                    color[0] = std::min(static_cast<int>(texture[i][j].x * 255 * 10), 255);
-                    color[1] = std::min(static_cast<int>(texture[i][j].y * 255 * 10), 255);
-                    color[2] = std::min(static_cast<int>(texture[i][j].z * 255 * 10), 255);
+        static auto ExportTexturePPM(Texture3D<Vector3> const& texture, char const* const fileName, float const multiplier = 10.0f) -> void
+        {
+            WritePPM(texture, fileName, multiplier);
+        }
 
-                    fout.write(reinterpret_cast<char*>(color), std::size(color));
-                }
-            }
+        static auto ExportTexturePPM(Texture4D<Vector3> const& texture, char const* const fileName, float const multiplier = 10.0f) -> void
+        {
+            WritePPM(texture, fileName, multiplier);
+        }
 
-            fout.close();
+        template <int N>
+        static auto ExportTexturePPM(Texture2D<Spectrum<N>> const& texture, char const* const fileName, float const multiplier = 10.0f) -> void
+        {
+            WritePPM(texture, fileName, multiplier);
+        }
+
+        template <int N>
+        static auto ExportTexturePPM(Texture4D<Spectrum<N>> const& texture, char const* const fileName, float const multiplier = 10.0f) -> void
+        {
+            WritePPM(texture, fileName, multiplier);
         }
 
         static auto ExportTexturePPM(Texture2D<unsigned char> const& texture, char const* const fileName) -> void
         {
-            auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
-            if(!fout)
+            auto fout = OpenPPM(texture, fileName);
+
+            WriteRows(fout, texture, 3, [](unsigned char const* const row, std::size_t const count, unsigned char* const out)
             {
-                throw;
-            }
+                for(std::size_t j = 0; j < count; ++j)
+                {
+                    out[3 * j + 0] = row[j];
+                    out[3 * j + 1] = row[j];
+                    out[3 * j + 2] = row[j];
+                }
+            });
+        }
 
-            fout << "P6\n";
-            fout << texture.GetUResolution() << " " << texture.GetVResolution() << "\n255\n";
+        static auto ExportTextureBinary16(Texture1D<Vector3> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
+
+        static auto ExportTextureBinary16(Texture2D<Vector3> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
+
+        static auto ExportTextureBinary16(Texture3D<Vector3> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
+
+        static auto ExportTextureBinary16(Texture4D<Vector3> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
+
+        template <int N>
+        static auto ExportTextureBinary16(Texture2D<Spectrum<N>> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
 
-            for(size_t i = 0; i < texture.GetVResolution(); ++i)
+        template <int N>
+        static auto ExportTextureBinary16(Texture4D<Spectrum<N>> const& texture, char const* const fileName) -> void
+        {
+            WriteBinary16(texture, fileName);
+        }
+
+    private:
+        // Bytes converted before each write.
+        std::size_t static constexpr BlockSize = std::size_t(4) << 20;
+
+        [[nodiscard]]
+        static auto ToRgb(Vector3 const& texel) -> Vector3
+        {
+            return texel;
+        }
+
+        template <int N>
+        [[nodiscard]]
+        static auto ToRgb(Spectrum<N> const& texel) -> Vector3
+        {
+            return Atmos::ToRgb(texel);
+        }
+
+        struct Dimensions final
+        {
+            std::size_t u;
+            std::size_t v;
+            std::size_t w;
+            std::size_t q;
+        };
+
+        template <typename Texture>
+        static auto WritePPM(Texture const& texture, char const* const fileName, float const multiplier) -> void
+        {
+            auto fout = OpenPPM(texture, fileName);
+
+            WriteRows(fout, texture, 3, [multiplier](auto const* const row, std::size_t const count, unsigned char* const out)
             {
-                for(size_t j = 0; j < texture.GetUResolution(); ++j)
+                auto const toByte = [multiplier](float const value)
                 {
-                    uint8_t color[3];
-                    color[0] = texture[i][j];
-                    color[1] = texture[i][j];
-                    color[2] = texture[i][j];
+                    return static_cast<unsigned char>(std::clamp(static_cast<int>(value * multiplier * 255), 0, 255));
+                };
 
-                    fout.write(reinterpret_cast<char*>(color), std::size(color));
+                for(std::size_t j = 0; j < count; ++j)
+                {
+                    auto const rgb = ToRgb(row[j]);
+                    out[3 * j + 0] = toByte(rgb.x);
+                    out[3 * j + 1] = toByte(rgb.y);
+                    out[3 * j + 2] = toByte(rgb.z);
                 }
-            }
-
-            fout.close();
+            });
         }
 
-        static auto ExportTexturePPM(Texture1D<Vector3> const& texture, char const* const fileName, float const multiplier) -> void
+        template <typename Texture>
+        static auto WriteBinary16(Texture const& texture, char const* const fileName) -> void
         {
             auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
             if(!fout)
@@ -72,23 +156,34 @@ namespace Atmos
                 throw;
             }
 
-            fout << "P6\n";
-            fout << texture.GetUResolution() << " 1\n255\n";
+            auto const dimensions = GetDimensions(texture);
+            std::uint16_t const header[3] = {
+                static_cast<std::uint16_t>(dimensions.u),
+                static_cast<std::uint16_t>(dimensions.v),
+                static_cast<std::uint16_t>(dimensions.w * dimensions.q)
+            };
+            fout.write(reinterpret_cast<char const*>(header), sizeof header);
 
-            for(size_t i = 0; i < texture.GetUResolution(); ++i)
+            WriteRows(fout, texture, 4 * sizeof(std::uint16_t), [](auto const* const row, std::size_t const count, unsigned char* const out)
             {
-                uint8_t color[3];
-                color[0] = std::min(static_cast<int>(texture[i].x * multiplier * 255), 255);
-                color[1] = std::min(static_cast<int>(texture[i].y * multiplier * 255), 255);
-                color[2] = std::min(static_cast<int>(texture[i].z * multiplier * 255), 255);
-
-                fout.write(reinterpret_cast<char*>(color), std::size(color));
-            }
-
-            fout.close();
+                if constexpr(std::is_same_v<std::decay_t<decltype(*row)>, Vector3>)
+                {
+                    Half::FromVector3(row, count, reinterpret_cast<std::uint16_t*>(out));
+                }
+                else
+                {
+                    auto rgb = std::vector<Vector3>(count);
+                    for(std::size_t j = 0; j < count; ++j)
+                    {
+                        rgb[j] = ToRgb(row[j]);
+                    }
+                    Half::FromVector3(rgb.data(), count, reinterpret_cast<std::uint16_t*>(out));
+                }
+            });
         }
 
-        static auto ExportTextureBinary16(Texture2D<Vector3> const& texture, char const* const fileName) -> void
+        template <typename Texture>
+        static auto OpenPPM(Texture const& texture, char const* const fileName) -> std::ofstream
         {
             auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
             if(!fout)
@@ -96,97 +191,133 @@ namespace Atmos
                 throw;
             }
 
-            struct Header final
-            {
-                uint16_t width;
-                uint16_t height;
-                uint16_t depth;
-            } const header = {
-                static_cast<uint16_t>(texture.GetUResolution()),
-                static_cast<uint16_t>(texture.GetVResolution()),
-                static_cast<uint16_t>(1)
-            };
+            auto const dimensions = GetDimensions(texture);
+            fout << "P6\n";
+            fout << dimensions.u << " " << dimensions.v * dimensions.w * dimensions.q << "\n255\n";
 
-            fout.write(reinterpret_cast<char const*>(&header), sizeof header);
-    
-            for(size_t i = 0; i < texture.GetVResolution(); ++i)
+            return fout;
+        }
+
+        // Encode turns a row of texels into bytesPerTexel bytes each. Every thread keeps a row for textures whose
+        // layout does not store rows contiguously.
+        template <typename Texture, typename Encode>
+        static auto WriteRows(std::ofstream& fout, Texture const& texture, std::size_t const bytesPerTexel, Encode const& encode) -> void
+        {
+            using Texel = std::remove_const_t<std::remove_reference_t<decltype(*texture.data())>>;
+
+            auto const dimensions = GetDimensions(texture);
+            auto const rowCount = dimensions.v * dimensions.w * dimensions.q;
+            auto const rowSize = dimensions.u * bytesPerTexel;
+            auto const rowsPerBlock = std::max(std::size_t(1), BlockSize / std::max(rowSize, std::size_t(1)));
+
+            auto block = TextureBuffer<unsigned char>(std::min(rowsPerBlock, rowCount) * rowSize);
+
+            for(std::size_t first = 0; first < rowCount; first += rowsPerBlock)
             {
-                for(size_t j = 0; j < texture.GetUResolution(); ++j)
+                auto const count = static_cast<int>(std::min(rowsPerBlock, rowCount - first));
+
+                #pragma omp parallel
                 {
-                    auto const color = texture[i][j];
-                    auto const halfColor = DirectX::PackedVector::XMHALF4(color.x, color.y, color.z, 0.0f);
+                    auto gathered = std::vector<Texel>(dimensions.u);
 
-                    fout.write(reinterpret_cast<char const*>(&halfColor), sizeof halfColor);
+                    #pragma omp for
+                    for(auto r = 0; r < count; ++r)
+                    {
+                        auto const row = GetRow(texture, first + r, gathered.data());
+                        encode(row, dimensions.u, block.data() + r * rowSize);
+                    }
                 }
+
+                fout.write(reinterpret_cast<char const*>(block.data()), static_cast<std::streamsize>(count * rowSize));
             }
-        }
 
-        static auto ExportTextureBinary16(Texture1D<Vector3> const& texture, char const* const fileName) -> void
-        {
-            auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
             if(!fout)
             {
                 throw;
             }
+        }
 
-            struct Header final
-            {
-                uint16_t width;
-                uint16_t height;
-                uint16_t depth;
-            } const header = {
-                static_cast<uint16_t>(texture.GetUResolution()),
-                static_cast<uint16_t>(1),
-                static_cast<uint16_t>(1)
-            };
+        template <typename T>
+        static auto GetDimensions(Texture1D<T> const& texture) -> Dimensions
+        {
+            return { texture.GetUResolution(), 1, 1, 1 };
+        }
 
-            fout.write(reinterpret_cast<char const*>(&header), sizeof header);
+        template <typename T>
+        static auto GetDimensions(Texture2D<T> const& texture) -> Dimensions
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), 1, 1 };
+        }
 
-            for(size_t i = 0; i < texture.GetUResolution(); ++i)
+        template <typename T>
+        static auto GetDimensions(Texture3D<T> const& texture) -> Dimensions
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), texture.GetWResolution(), 1 };
+        }
+
+        template <typename T>
+        static auto GetDimensions(Texture4D<T> const& texture) -> Dimensions
+        {
+            return { texture.GetUResolution(), texture.GetVResolution(), texture.GetWResolution(), texture.GetQResolution() };
+        }
+
+        // Rows of linear textures are read in place, the others are gathered into the given row.
+        template <typename T>
+        static auto GetRow(Texture1D<T> const& texture, std::size_t, T*) -> T const*
+        {
+            return texture.data();
+        }
+
+        template <typename T>
+        static auto GetRow(Texture2D<T> const& texture, std::size_t const row, T* const gathered) -> T const*
+        {
+            if(texture.GetLayout() == TextureLayout::Linear)
             {
-                auto const color = texture[i];
-                auto const halfColor = DirectX::PackedVector::XMHALF4(color.x, color.y, color.z, 0.0f);
+                return texture.data() + texture.Offset(0, row);
+            }
 
-                fout.write(reinterpret_cast<char const*>(&halfColor), sizeof halfColor);
+            for(std::size_t j = 0; j < texture.GetUResolution(); ++j)
+            {
+                gathered[j] = texture[row][j];
             }
-    
+            return gathered;
         }
 
-        static auto ExportTextureBinary16(Texture3D<Vector3> const& texture, char const* const fileName) -> void
+        template <typename T>
+        static auto GetRow(Texture3D<T> const& texture, std::size_t const row, T* const gathered) -> T const*
         {
-            auto fout = std::ofstream(fileName, std::ios::out | std::ios::binary);
-            if(!fout)
+            auto const i = row % texture.GetVResolution();
+            auto const k = row / texture.GetVResolution();
+
+            if(texture.GetLayout() == TextureLayout::Linear)
             {
-                throw;
+                return texture.data() + texture.Offset(0, i, k);
             }
 
-            struct Header final
+            for(std::size_t j = 0; j < texture.GetUResolution(); ++j)
             {
-                uint16_t width;
-                uint16_t height;
-                uint16_t depth;
-            } const header = {
-                static_cast<uint16_t>(texture.GetUResolution()),
-                static_cast<uint16_t>(texture.GetVResolution()),
-                static_cast<uint16_t>(texture.GetWResolution())
-            };
+                gathered[j] = texture[k][i][j];
+            }
+            return gathered;
+        }
 
-            fout.write(reinterpret_cast<char const*>(&header), sizeof header);
+        template <typename T>
+        static auto GetRow(Texture4D<T> const& texture, std::size_t const row, T* const gathered) -> T const*
+        {
+            auto const i = row % texture.GetVResolution();
+            auto const k = row / texture.GetVResolution() % texture.GetWResolution();
+            auto const q = row / texture.GetVResolution() / texture.GetWResolution();
 
-            for(size_t k = 0; k < texture.GetVResolution(); ++k)
+            if(texture.GetLayout() == TextureLayout::Linear)
             {
-                for(size_t i = 0; i < texture.GetVResolution(); ++i)
-                {
-                    for(size_t j = 0; j < texture.GetUResolution(); ++j)
-                    {
-                        auto const color = texture[k][i][j];
-                        auto const halfColor = DirectX::PackedVector::XMHALF4(color.x, color.y, color.z, 0.0f);
+                return texture.data() + texture.Offset(0, i, k, q);
+            }
 
-                        fout.write(reinterpret_cast<char const*>(&halfColor), sizeof halfColor);
-                    }
-                }
+            for(std::size_t j = 0; j < texture.GetUResolution(); ++j)
+            {
+                gathered[j] = texture[q][k][i][j];
             }
+            return gathered;
         }
-
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "SimdPack.hpp"
+#include "Texture.hpp"
+
+namespace Atmos
+{
+    // Bulk filtering of texture views for code that makes many lookups at once. Coordinates come in arrays and are
+    // filtered Simd::GetWidth() at a time: the corner texels of all lanes are gathered channel by channel and blended
+    // in packs, in the order TextureViewND::Sample blends them, so both agree up to floating point contraction.
+    // Coordinates are clamped to [0, 1] first, so no lookup reads outside the view.
+    //
+    // Float4 has no gather, so below four dimensions its corners cost more to fetch lane by lane than
+    // TextureViewND::Sample takes per lookup. With SSE2 those views are sampled one lookup at a time instead.
+    //
+    // Texels are arrays of floats such as float, Vector2, Vector3 or Spectrum<N>, and a view may hold at most 2^31
+    // floats.
+    class TextureSampler final
+    {
+    public:
+        template <typename T>
+        static constexpr int ChannelCount = static_cast<int>(sizeof(T) / sizeof(float));
+
+        template <typename T>
+        static auto Sample(TextureView1D<T> const& view, std::size_t const count, float const* const u, T* const texels)
+            -> void
+        {
+            if(IsScalarFaster())
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    texels[i] = view.Sample(Clamp(u[i]));
+                }
+                return;
+            }
+
+            ForEachPack(count, texels, [&](auto const tag, std::size_t const first, int const lanes, auto& channels)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                Sample(view, LoadLanes<Pack>(u + first, lanes), channels);
+            });
+        }
+
+        template <typename T>
+        static auto Sample(
+            TextureView2D<T> const& view,
+            std::size_t const count,
+            float const* const u,
+            float const* const v,
+            T* const texels) -> void
+        {
+            if(IsScalarFaster())
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    texels[i] = view.Sample(Clamp(u[i]), Clamp(v[i]));
+                }
+                return;
+            }
+
+            ForEachPack(count, texels, [&](auto const tag, std::size_t const first, int const lanes, auto& channels)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                Sample(view, LoadLanes<Pack>(u + first, lanes), LoadLanes<Pack>(v + first, lanes), channels);
+            });
+        }
+
+        template <typename T>
+        static auto Sample(
+            TextureView3D<T> const& view,
+            std::size_t const count,
+            float const* const u,
+            float const* const v,
+            float const* const w,
+            T* const texels) -> void
+        {
+            if(IsScalarFaster())
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    texels[i] = view.Sample(Clamp(u[i]), Clamp(v[i]), Clamp(w[i]));
+                }
+                return;
+            }
+
+            ForEachPack(count, texels, [&](auto const tag, std::size_t const first, int const lanes, auto& channels)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                Sample(view, LoadLanes<Pack>(u + first, lanes), LoadLanes<Pack>(v + first, lanes),
+                    LoadLanes<Pack>(w + first, lanes), channels);
+            });
+        }
+
+        template <typename T>
+        static auto Sample(
+            TextureView4D<T> const& view,
+            std::size_t const count,
+            float const* const u,
+            float const* const v,
+            float const* const w,
+            float const* const q,
+            T* const texels) -> void
+        {
+            ForEachPack(count, texels, [&](auto const tag, std::size_t const first, int const lanes, auto& channels)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                Sample(view, LoadLanes<Pack>(u + first, lanes), LoadLanes<Pack>(v + first, lanes),
+                    LoadLanes<Pack>(w + first, lanes), LoadLanes<Pack>(q + first, lanes), channels);
+            });
+        }
+
+        // Packed forms for kernels that already hold their coordinates in packs, one pack per channel of the texels.
+
+        template <typename Pack, typename T, int Channels>
+        static auto Sample(TextureView1D<T> const& view, Pack const& u, Pack (&channels)[Channels]) -> void
+        {
+            Pack const coordinates[] = { u };
+            std::size_t const resolutions[] = { view.GetUResolution() };
+            std::size_t const strides[] = { 1 };
+            Filter(view.data(), coordinates, resolutions, strides, true, [](std::size_t, std::size_t)
+            {
+                return std::size_t(0);
+            }, channels);
+        }
+
+        template <typename Pack, typename T, int Channels>
+        static auto Sample(TextureView2D<T> const& view, Pack const& u, Pack const& v, Pack (&channels)[Channels]) -> void
+        {
+            Pack const coordinates[] = { u, v };
+            std::size_t const resolutions[] = { view.GetUResolution(), view.GetVResolution() };
+            std::size_t const strides[] = { 1, view.GetRowStride() };
+            Filter(view.data(), coordinates, resolutions, strides, view.GetLayout() == TextureLayout::Linear,
+                [&](std::size_t const u, std::size_t const v)
+                {
+                    return view.Offset(u, v);
+                }, channels);
+        }
+
+        template <typename Pack, typename T, int Channels>
+        static auto Sample(
+            TextureView3D<T> const& view,
+            Pack const& u,
+            Pack const& v,
+            Pack const& w,
+            Pack (&channels)[Channels]) -> void
+        {
+            Pack const coordinates[] = { u, v, w };
+            std::size_t const resolutions[] = { view.GetUResolution(), view.GetVResolution(), view.GetWResolution() };
+            std::size_t const strides[] = { 1, view.GetRowStride(), view.GetSliceStride() };
+            Filter(view.data(), coordinates, resolutions, strides, view.GetLayout() == TextureLayout::Linear,
+                [&](std::size_t const u, std::size_t const v)
+                {
+                    return view.Offset(u, v, 0);
+                }, channels);
+        }
+
+        template <typename Pack, typename T, int Channels>
+        static auto Sample(
+            TextureView4D<T> const& view,
+            Pack const& u,
+            Pack const& v,
+            Pack const& w,
+            Pack const& q,
+            Pack (&channels)[Channels]) -> void
+        {
+            Pack const coordinates[] = { u, v, w, q };
+            std::size_t const resolutions[] = {
+                view.GetUResolution(), view.GetVResolution(), view.GetWResolution(), view.GetQResolution()
+            };
+            std::size_t const strides[] = { 1, view.GetRowStride(), view.GetSliceStride(), view.GetVolumeStride() };
+            Filter(view.data(), coordinates, resolutions, strides, view.GetLayout() == TextureLayout::Linear,
+                [&](std::size_t const u, std::size_t const v)
+                {
+                    return view.Offset(u, v, 0, 0);
+                }, channels);
+        }
+
+    private:
+        // Whether the views of fewer than four dimensions are sampled lookup by lookup, see the class comment.
+        [[nodiscard]]
+        static auto IsScalarFaster() -> bool
+        {
+            return Simd::GetIsa() == Simd::Isa::Sse2;
+        }
+
+        [[nodiscard]]
+        static auto Clamp(float const coordinate) -> float
+        {
+            return std::min(std::max(coordinate, 0.0f), 1.0f);
+        }
+
+        // Splits count lookups into packs and stores the channels the kernel filters into texels.
+        template <typename T, typename Kernel>
+        static auto ForEachPack(std::size_t const count, T* const texels, Kernel const& kernel) -> void
+        {
+            static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(float) == 0,
+                "Texels must be arrays of floats.");
+
+            Simd::Dispatch([&](auto const tag)
+            {
+                using Pack = typename decltype(tag)::Pack;
+                constexpr auto Channels = ChannelCount<T>;
+
+                for(std::size_t first = 0; first < count; first += Pack::Width)
+                {
+                    auto const lanes = static_cast<int>(std::min<std::size_t>(count - first, Pack::Width));
+
+                    Pack channels[Channels];
+                    kernel(tag, first, lanes, channels);
+
+                    float values[Channels][Pack::Width];
+                    for(auto channel = 0; channel < Channels; ++channel)
+                    {
+                        channels[channel].Store(values[channel]);
+                    }
+
+                    for(auto lane = 0; lane < lanes; ++lane)
+                    {
+                        float texel[Channels];
+                        for(auto channel = 0; channel < Channels; ++channel)
+                        {
+                            texel[channel] = values[channel][lane];
+                        }
+                        std::memcpy(texels + first + lane, texel, sizeof texel);
+                    }
+                }
+            });
+        }
+
+        // Loads the given values into lanes, repeating the last value where fewer than Pack::Width remain.
+        template <typename Pack>
+        static auto LoadLanes(float const* const values, int const count) -> Pack
+        {
+            if(count == Pack::Width)
+            {
+                return Pack::Load(values);
+            }
+
+            float lanes[Pack::Width];
+            for(auto lane = 0; lane < Pack::Width; ++lane)
+            {
+                lanes[lane] = values[std::min(lane, count - 1)];
+            }
+            return Pack::Load(lanes);
+        }
+
+        template <typename Pack>
+        static auto Lerp(Pack const& a, Pack const& b, Pack const& t) -> Pack
+        {
+            return a * (Pack(1.0f) - t) + b * t;
+        }
+
+        // Corner c of a lane takes the upper texel along axis d where bit d of c is set. Offsets are 32-bit integers,
+        // in floats. The lower corner is found from the strides of the axes, except for the u and v axes of Tiled and
+        // Morton slices, whose four corners come from the layout lane by lane. Every other corner adds to one with
+        // fewer bits the step to the upper texel along an axis, zero at the last texel. The blend then runs axis by
+        // axis, each pass halving the corners.
+        template <typename Pack, int Dimensions, typename T, int Channels, typename SliceOffset>
+        static auto Filter(
+            T const* const texels,
+            Pack const (&coordinates)[Dimensions],
+            std::size_t const (&resolutions)[Dimensions],
+            std::size_t const (&strides)[Dimensions],
+            bool const linear,
+            SliceOffset const& sliceOffset,
+            Pack (&channels)[Channels]) -> void
+        {
+            static_assert(Channels == ChannelCount<T>, "One pack per channel of the texels.");
+            constexpr auto Corners = 1 << Dimensions;
+            constexpr auto Width = Pack::Width;
+
+            Pack weights[Dimensions];
+            std::int32_t scaledStrides[Dimensions];
+            alignas(64) std::int32_t lower[Dimensions][Width];
+            alignas(64) std::int32_t steps[Dimensions][Width];
+            for(auto d = 0; d < Dimensions; ++d)
+            {
+                auto const last = static_cast<std::int32_t>(resolutions[d] - 1);
+                auto const scaled = Min(Max(coordinates[d], Pack(0.0f)), Pack(1.0f)) * Pack(static_cast<float>(last));
+                auto const index = Floor(scaled);
+                weights[d] = scaled - index;
+                index.StoreInt32(lower[d]);
+
+                scaledStrides[d] = static_cast<std::int32_t>(strides[d] * Channels);
+                for(auto lane = 0; lane < Width; ++lane)
+                {
+                    steps[d][lane] = lower[d][lane] < last ? scaledStrides[d] : 0;
+                }
+            }
+
+            auto const firstStridedAxis = linear ? 0 : 2;
+
+            alignas(64) std::int32_t offsets[Corners][Width];
+            for(auto lane = 0; lane < Width; ++lane)
+            {
+                auto offset = std::int32_t(0);
+                for(auto d = firstStridedAxis; d < Dimensions; ++d)
+                {
+                    offset += lower[d][lane] * scaledStrides[d];
+                }
+                offsets[0][lane] = offset;
+            }
+
+            if constexpr(Dimensions >= 2)
+            {
+                if(!linear)
+                {
+                    for(auto lane = 0; lane < Width; ++lane)
+                    {
+                        auto const u0 = static_cast<std::size_t>(lower[0][lane]);
+                        auto const v0 = static_cast<std::size_t>(lower[1][lane]);
+                        auto const u1 = u0 + (steps[0][lane] != 0 ? 1 : 0);
+                        auto const v1 = v0 + (steps[1][lane] != 0 ? 1 : 0);
+                        auto const offset = offsets[0][lane];
+
+                        offsets[0][lane] = offset + static_cast<std::int32_t>(sliceOffset(u0, v0) * Channels);
+                        offsets[1][lane] = offset + static_cast<std::int32_t>(sliceOffset(u1, v0) * Channels);
+                        offsets[2][lane] = offset + static_cast<std::int32_t>(sliceOffset(u0, v1) * Channels);
+                        offsets[3][lane] = offset + static_cast<std::int32_t>(sliceOffset(u1, v1) * Channels);
+                    }
+                }
+            }
+
+            for(auto d = firstStridedAxis; d < Dimensions; ++d)
+            {
+                for(auto corner = 0; corner < 1 << d; ++corner)
+                {
+                    for(auto lane = 0; lane < Width; ++lane)
+                    {
+                        offsets[corner | 1 << d][lane] = offsets[corner][lane] + steps[d][lane];
+                    }
+                }
+            }
+
+            auto const data = reinterpret_cast<float const*>(texels);
+            for(auto channel = 0; channel < Channels; ++channel)
+            {
+                Pack values[Corners];
+                for(auto corner = 0; corner < Corners; ++corner)
+                {
+                    values[corner] = Pack::Gather(data + channel, offsets[corner]);
+                }
+
+                auto remaining = Corners;
+                for(auto d = 0; d < Dimensions; ++d)
+                {
+                    remaining /= 2;
+                    for(auto i = 0; i < remaining; ++i)
+                    {
+                        values[i] = Lerp(values[2 * i], values[2 * i + 1], weights[d]);
+                    }
+                }
+
+                channels[channel] = values[0];
+            }
+        }
+    };
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "Transmittance.hpp"
 #include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "Scheduler.hpp"
 
 namespace Atmos
 {
@@ -10,6 +12,7 @@ namespace Atmos
         PlanetProperties pp;
         Texture1D<Vector3> tex;
         Transmittance::IntegrationParameters params;
+        std::int64_t evaluationCount = 0;
         
     public:
         explicit TransmittanceMap(
@@ -21,27 +24,96 @@ namespace Atmos
 
         auto Compute() -> void
         {
-            #pragma omp parallel for
-            for(auto i = 0; i < static_cast<int>(tex.GetUResolution()); ++i)
+            if(params.kernel == Kernel::Packet)
+            {
+                ComputePackets();
+                return;
+            }
+
+            evaluationCount = Scheduler::ForEach(static_cast<int>(tex.GetUResolution()), 16, [&](int const i)
             {
                 auto const u = tex.IndexToU(i);
                 auto const zenithCos = UToZenithCos(u);
 
                 tex[i] = CalculateUsingZenithCos(zenithCos);
-            }
+            });
         }
         
+        // Reads the texture from the cache, or computes it and stores it there. Reports whether it was a hit, which
+        // leaves the evaluation count at zero.
+        auto Compute(TextureCache const& cache) -> bool
+        {
+            auto const key = GetCacheKey();
+            if(cache.Load(key, tex))
+            {
+                evaluationCount = 0;
+                return true;
+            }
+
+            Compute();
+            cache.Store(key, tex);
+            return false;
+        }
+
+        // Everything the texture depends on.
+        [[nodiscard]]
+        auto GetCacheKey() const -> CacheKey
+        {
+            auto key = CacheKey("TransmittanceMap");
+            key.Add(tex.GetUResolution());
+            pp.AddTo(key);
+            params.AddTo(key);
+            return key;
+        }
+
         [[nodiscard]]
         auto GetTexture() const -> Texture1D<Vector3> const&
         {
             return tex;
         }
+
+        // Density evaluations made by the last Compute, summed over all threads.
+        [[nodiscard]]
+        auto GetEvaluationCount() const -> std::int64_t
+        {
+            return evaluationCount;
+        }
         
     private:
+        // Texels are split into blocks of neighbouring directions, each traced as packets.
+        auto ComputePackets() -> void
+        {
+            auto const pathEnterPoint = GetPathEnterPoint();
+            auto const resolution = static_cast<int>(tex.GetUResolution());
+            auto const blockSize = 64;
+
+            evaluationCount = Scheduler::ForEach((resolution + blockSize - 1) / blockSize, 1, [&](int const block)
+            {
+                auto const first = block * blockSize;
+                auto const count = std::min(blockSize, resolution - first);
+
+                Vector3 pathExitPoints[blockSize];
+                Vector3 transmittance[blockSize];
+                for(auto k = 0; k < count; ++k)
+                {
+                    auto const zenithCos = UToZenithCos(tex.IndexToU(first + k));
+                    auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+                    pathExitPoints[k] = GetPathExitPoint(pathEnterPoint, Vector3(zenithSin, zenithCos, 0.0f));
+                }
+
+                Transmittance::GetPathTransmittancePacket(pathEnterPoint, pathExitPoints, count, pp, params, transmittance);
+
+                for(auto k = 0; k < count; ++k)
+                {
+                    tex[first + k] = transmittance[k];
+                }
+            });
+        }
+
         [[nodiscard]]
         auto CalculateUsingZenithCos(float const zenithCos) const -> Vector3
         {
-            auto const zenithSin = std::sinf(std::acosf(zenithCos));
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
             auto const dir = Vector3(zenithSin, zenithCos, 0.0f);
 
             
@@ -51,29 +123,34 @@ namespace Atmos
         [[nodiscard]]
         auto CalculateUsingDirection(Vector3 const& dir) const -> Vector3
         {
-            auto const pathEnterPoint = Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * 0.01f, 0.0f);
-            
-            Vector3 pathExitPoint;
+            auto const pathEnterPoint = GetPathEnterPoint();
+            auto const pathExitPoint = GetPathExitPoint(pathEnterPoint, dir);
+
+            return Transmittance::GetPathTransmittance(pathEnterPoint, pathExitPoint, pp, params);
+        }
 
+        [[nodiscard]]
+        auto GetPathEnterPoint() const -> Vector3
+        {
+            return Vector3(0.0f, pp.GetPlanetRadius() + pp.GetAtmosphereHeight() * 0.01f, 0.0f);
+        }
+
+        [[nodiscard]]
+        auto GetPathExitPoint(Vector3 const& pathEnterPoint, Vector3 const& dir) const -> Vector3
+        {
             auto const planetTest = RayCircleIntersection(pathEnterPoint, dir, pp.GetPlanetRadius());
             if(planetTest)
             {
-                pathExitPoint = planetTest.value();
+                return planetTest.value();
             }
-            else
+
+            auto const atmoTest = RayCircleIntersection(pathEnterPoint, dir, pp.GetAtmosphereRadius());
+            if(atmoTest)
             {
-                auto const atmoTest = RayCircleIntersection(pathEnterPoint, dir, pp.GetAtmosphereRadius());
-                if(atmoTest)
-                {
-                    pathExitPoint = atmoTest.value();
-                }
-                else
-                {
-                    throw;
-                }
+                return atmoTest.value();
             }
 
-            return Transmittance::GetPathTransmittance(pathEnterPoint, pathExitPoint, pp, params);
+            throw;
         }
 
         [[nodiscard]]
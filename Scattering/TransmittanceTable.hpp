@@ -0,0 +1,446 @@
+#pragma once
+#include <algorithm>
+#include "Transmittance.hpp"
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "Scheduler.hpp"
+
+namespace Atmos
+{
+    // Transmittance from a point at radius r along a direction with zenith cosine mu up to the top of the atmosphere.
+    // Only rays that do not hit the planet are stored; transmittance along the others is recovered from the reversed,
+    // upward-looking ray, so transmittance between any two points is a ratio of two lookups.
+    class TransmittanceTable final
+    {
+        PlanetProperties pp;
+        Texture2D<Vector3> tex;
+        // Rayleigh and Mie optical depths per unit extinction coefficient over the same texels, empty until
+        // ComputeOpticalDepths fills it. The spectral integrators read it, whatever their wavelength count.
+        Texture2D<Vector2> depthTex;
+        Transmittance::IntegrationParameters params;
+        std::int64_t evaluationCount = 0;
+
+        // Side in texels of the square tiles the tables are computed in.
+        static constexpr int TileSize = 16;
+
+    public:
+        explicit TransmittanceTable(
+            std::size_t const zenithCosResolution,
+            std::size_t const radiusResolution,
+            PlanetProperties const& planetProperties,
+            Transmittance::IntegrationParameters const& params)
+            : pp(planetProperties), tex(zenithCosResolution, radiusResolution), params(params)
+        { }
+
+        auto Compute() -> void
+        {
+            evaluationCount = Scheduler::ForEachTile(static_cast<int>(tex.GetUResolution()), static_cast<int>(tex.GetVResolution()),
+                TileSize, TileSize, [&](Scheduler::Tile const& tile)
+            {
+                for(auto i = tile.v0; i < tile.v1; ++i)
+                {
+                    auto const radius = VToRadius(IndexToUnit(i, tex.GetVResolution()));
+
+                    for(auto j = tile.u0; j < tile.u1; ++j)
+                    {
+                        auto const zenithCos = UToZenithCos(radius, IndexToUnit(j, tex.GetUResolution()));
+
+                        tex[i][j] = Calculate(radius, zenithCos);
+                    }
+                }
+            });
+        }
+
+        // Fills the optical depth texture, which the RGB lookups do not need.
+        auto ComputeOpticalDepths() -> void
+        {
+            depthTex = Texture2D<Vector2>(tex.GetUResolution(), tex.GetVResolution());
+
+            evaluationCount = Scheduler::ForEachTile(static_cast<int>(depthTex.GetUResolution()),
+                static_cast<int>(depthTex.GetVResolution()), TileSize, TileSize, [&](Scheduler::Tile const& tile)
+            {
+                for(auto i = tile.v0; i < tile.v1; ++i)
+                {
+                    auto const radius = VToRadius(IndexToUnit(i, depthTex.GetVResolution()));
+
+                    for(auto j = tile.u0; j < tile.u1; ++j)
+                    {
+                        auto const zenithCos = UToZenithCos(radius, IndexToUnit(j, depthTex.GetUResolution()));
+                        auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+                        auto const pathEnterPoint = Vector3(0.0f, radius, 0.0f);
+                        auto const pathExitPoint = pathEnterPoint
+                            + Vector3(zenithSin, zenithCos, 0.0f) * DistanceToAtmosphere(radius, zenithCos);
+
+                        depthTex[i][j] = Transmittance::GetPathDensity(pathEnterPoint, pathExitPoint, pp, params);
+                    }
+                }
+            });
+        }
+
+        [[nodiscard]]
+        auto HasOpticalDepths() const -> bool
+        {
+            return depthTex.GetUResolution() > 0;
+        }
+
+        // Reads the texture from the cache, or computes it and stores it there. Reports whether it was a hit, which
+        // leaves the evaluation count at zero.
+        auto Compute(TextureCache const& cache) -> bool
+        {
+            auto const key = GetCacheKey();
+            if(cache.Load(key, tex))
+            {
+                evaluationCount = 0;
+                return true;
+            }
+
+            Compute();
+            cache.Store(key, tex);
+            return false;
+        }
+
+        // Everything the table depends on, also part of the keys of the maps computed from it.
+        [[nodiscard]]
+        auto GetCacheKey() const -> CacheKey
+        {
+            auto key = CacheKey("TransmittanceTable");
+            key.Add(tex.GetUResolution()).Add(tex.GetVResolution());
+            pp.AddTo(key);
+            params.AddTo(key);
+            return key;
+        }
+
+        // The key without the planet properties the table does not depend on, for the tables computed from it that do
+        // not depend on them either.
+        [[nodiscard]]
+        auto GetMediumCacheKey() const -> CacheKey
+        {
+            auto key = CacheKey("TransmittanceTableMedium");
+            key.Add(tex.GetUResolution()).Add(tex.GetVResolution());
+            pp.AddMediumTo(key);
+            params.AddTo(key);
+            return key;
+        }
+
+        [[nodiscard]]
+        auto GetTexture() const -> Texture2D<Vector3> const&
+        {
+            return tex;
+        }
+
+        [[nodiscard]]
+        auto GetPlanetProperties() const -> PlanetProperties const&
+        {
+            return pp;
+        }
+
+        // Density evaluations made by the last Compute or ComputeOpticalDepths, summed over all threads.
+        [[nodiscard]]
+        auto GetEvaluationCount() const -> std::int64_t
+        {
+            return evaluationCount;
+        }
+
+        [[nodiscard]]
+        auto GetTransmittanceToAtmosphere(float const radius, float const zenithCos) const -> Vector3
+        {
+            auto const u = std::clamp(ZenithCosToU(radius, zenithCos), 0.0f, 1.0f);
+            auto const v = std::clamp(RadiusToV(radius), 0.0f, 1.0f);
+
+            return tex.Sample(u, v);
+        }
+
+        [[nodiscard]]
+        auto GetTransmittance(Vector3 const& a, Vector3 const& b) const -> Vector3
+        {
+            auto const path = b - a;
+            auto const pathLength = path.Length();
+            if(pathLength <= 0.0f)
+            {
+                return { 1.0f, 1.0f, 1.0f };
+            }
+
+            auto const dir = path / pathLength;
+            auto const aRadius = a.Length();
+            auto const bRadius = b.Length();
+            auto const aZenithCos = Dot(a, dir) / aRadius;
+            auto const bZenithCos = Dot(b, dir) / bRadius;
+
+            Vector3 transmittance;
+            if(RayIntersectsGround(aRadius, aZenithCos))
+            {
+                transmittance = GetTransmittanceToAtmosphere(bRadius, -bZenithCos)
+                    / GetTransmittanceToAtmosphere(aRadius, -aZenithCos);
+            }
+            else
+            {
+                transmittance = GetTransmittanceToAtmosphere(aRadius, aZenithCos)
+                    / GetTransmittanceToAtmosphere(bRadius, bZenithCos);
+            }
+
+            return {
+                std::min(transmittance.x, 1.0f),
+                std::min(transmittance.y, 1.0f),
+                std::min(transmittance.z, 1.0f)
+            };
+        }
+
+        // Rayleigh and Mie optical depths per unit extinction coefficient, read as the transmittance is.
+        [[nodiscard]]
+        auto GetOpticalDepthToAtmosphere(float const radius, float const zenithCos) const -> Vector2
+        {
+            auto const u = std::clamp(ZenithCosToU(radius, zenithCos), 0.0f, 1.0f);
+            auto const v = std::clamp(RadiusToV(radius), 0.0f, 1.0f);
+
+            return depthTex.Sample(u, v);
+        }
+
+        // The optical depth between two points is a difference of two lookups, as their transmittance is a ratio.
+        [[nodiscard]]
+        auto GetOpticalDepth(Vector3 const& a, Vector3 const& b) const -> Vector2
+        {
+            auto const path = b - a;
+            auto const pathLength = path.Length();
+            if(pathLength <= 0.0f)
+            {
+                return {};
+            }
+
+            auto const dir = path / pathLength;
+            auto const aRadius = a.Length();
+            auto const bRadius = b.Length();
+            auto const aZenithCos = Dot(a, dir) / aRadius;
+            auto const bZenithCos = Dot(b, dir) / bRadius;
+
+            Vector2 depth;
+            if(RayIntersectsGround(aRadius, aZenithCos))
+            {
+                depth = GetOpticalDepthToAtmosphere(bRadius, -bZenithCos) - GetOpticalDepthToAtmosphere(aRadius, -aZenithCos);
+            }
+            else
+            {
+                depth = GetOpticalDepthToAtmosphere(aRadius, aZenithCos) - GetOpticalDepthToAtmosphere(bRadius, bZenithCos);
+            }
+
+            return { std::max(depth.x, 0.0f), std::max(depth.y, 0.0f) };
+        }
+
+        [[nodiscard]]
+        auto RayIntersectsGround(float const radius, float const zenithCos) const -> bool
+        {
+            auto const planetRadius = pp.GetPlanetRadius();
+            return zenithCos < 0.0f && radius * radius * (zenithCos * zenithCos - 1.0f) + planetRadius * planetRadius >= 0.0f;
+        }
+
+        template <typename Pack>
+        [[nodiscard]]
+        auto GetTransmittanceToAtmosphere(Pack const& radius, Pack const& zenithCos) const -> Simd::Vector3Pack<Pack>
+        {
+            Pack u;
+            Pack v;
+            GetCoordinates(radius, zenithCos, u, v);
+
+            Pack channels[3];
+            SampleTexture(tex, u, v, channels);
+            return { channels[0], channels[1], channels[2] };
+        }
+
+        template <typename Pack>
+        auto GetOpticalDepthToAtmosphere(
+            Pack const& radius,
+            Pack const& zenithCos,
+            Pack& rayleightDepth,
+            Pack& mieDepth) const -> void
+        {
+            Pack u;
+            Pack v;
+            GetCoordinates(radius, zenithCos, u, v);
+
+            Pack channels[2];
+            SampleTexture(depthTex, u, v, channels);
+            rayleightDepth = channels[0];
+            mieDepth = channels[1];
+        }
+
+        template <typename Pack>
+        [[nodiscard]]
+        auto RayIntersectsGround(Pack const& radius, Pack const& zenithCos) const -> typename Pack::Mask
+        {
+            auto const planetRadius = Pack(pp.GetPlanetRadius());
+            return (zenithCos < Pack(0.0f))
+                & (radius * radius * (zenithCos * zenithCos - Pack(1.0f)) + planetRadius * planetRadius >= Pack(0.0f));
+        }
+
+    private:
+        template <typename Pack>
+        auto GetCoordinates(Pack const& radius, Pack const& zenithCos, Pack& u, Pack& v) const -> void
+        {
+            auto const planetRadius = Pack(pp.GetPlanetRadius());
+            auto const atmosphereRadius = Pack(pp.GetAtmosphereRadius());
+            auto const h = Pack(HorizonDistance(pp.GetAtmosphereRadius()));
+
+            auto const rho = Sqrt(Max(radius * radius - planetRadius * planetRadius, Pack(0.0f)));
+            auto const d = Max(Pack(0.0f), -radius * zenithCos
+                + Sqrt(Max(Pack(0.0f), radius * radius * (zenithCos * zenithCos - Pack(1.0f)) + atmosphereRadius * atmosphereRadius)));
+            auto const dMin = atmosphereRadius - radius;
+            auto const dMax = rho + h;
+
+            u = Min(Max((d - dMin) / (dMax - dMin), Pack(0.0f)), Pack(1.0f));
+            v = Min(Max(rho / h, Pack(0.0f)), Pack(1.0f));
+        }
+
+        static auto GetChannels(Vector3 const& texel, float* const channels) -> void
+        {
+            channels[0] = texel.x;
+            channels[1] = texel.y;
+            channels[2] = texel.z;
+        }
+
+        static auto GetChannels(Vector2 const& texel, float* const channels) -> void
+        {
+            channels[0] = texel.x;
+            channels[1] = texel.y;
+        }
+
+        // Bilinear filtering with the same conventions as Texture2D::Sample, texels are fetched lane by lane.
+        template <typename Pack, typename Texel, int Channels>
+        auto SampleTexture(Texture2D<Texel> const& texture, Pack const& u, Pack const& v, Pack (&channels)[Channels]) const
+            -> void
+        {
+            auto const uMax = static_cast<float>(texture.GetUResolution() - 1);
+            auto const vMax = static_cast<float>(texture.GetVResolution() - 1);
+
+            auto const du = u * Pack(uMax);
+            auto const dv = v * Pack(vMax);
+            auto const iu = Floor(du);
+            auto const iv = Floor(dv);
+            auto const tu = du - iu;
+            auto const tv = dv - iv;
+
+            float iuLanes[Pack::Width];
+            float ivLanes[Pack::Width];
+            iu.Store(iuLanes);
+            iv.Store(ivLanes);
+
+            auto const data = texture.data();
+
+            float texels[4][Channels][Pack::Width];
+            for(auto lane = 0; lane < Pack::Width; ++lane)
+            {
+                auto const u0 = static_cast<std::size_t>(iuLanes[lane]);
+                auto const v0 = static_cast<std::size_t>(ivLanes[lane]);
+                auto const u1 = std::min(u0 + 1, texture.GetUResolution() - 1);
+                auto const v1 = std::min(v0 + 1, texture.GetVResolution() - 1);
+
+                std::size_t const offsets[4] = {
+                    texture.Offset(u0, v0),
+                    texture.Offset(u1, v0),
+                    texture.Offset(u0, v1),
+                    texture.Offset(u1, v1)
+                };
+                for(auto corner = 0; corner < 4; ++corner)
+                {
+                    float corners[Channels];
+                    GetChannels(data[offsets[corner]], corners);
+                    for(auto channel = 0; channel < Channels; ++channel)
+                    {
+                        texels[corner][channel][lane] = corners[channel];
+                    }
+                }
+            }
+
+            auto const lerp = [&](int const channel)
+            {
+                auto const t00 = Pack::Load(texels[0][channel]);
+                auto const t01 = Pack::Load(texels[1][channel]);
+                auto const t10 = Pack::Load(texels[2][channel]);
+                auto const t11 = Pack::Load(texels[3][channel]);
+                auto const row0 = t00 + (t01 - t00) * tu;
+                auto const row1 = t10 + (t11 - t10) * tu;
+                return row0 + (row1 - row0) * tv;
+            };
+
+            for(auto channel = 0; channel < Channels; ++channel)
+            {
+                channels[channel] = lerp(channel);
+            }
+        }
+
+        [[nodiscard]]
+        auto Calculate(float const radius, float const zenithCos) const -> Vector3
+        {
+            auto const zenithSin = std::sqrtf(std::max(0.0f, 1.0f - zenithCos * zenithCos));
+            auto const pathEnterPoint = Vector3(0.0f, radius, 0.0f);
+            auto const pathExitPoint = pathEnterPoint + Vector3(zenithSin, zenithCos, 0.0f) * DistanceToAtmosphere(radius, zenithCos);
+
+            return Transmittance::GetPathTransmittance(pathEnterPoint, pathExitPoint, pp, params);
+        }
+
+        [[nodiscard]]
+        auto DistanceToAtmosphere(float const radius, float const zenithCos) const -> float
+        {
+            auto const atmosphereRadius = pp.GetAtmosphereRadius();
+            auto const d = radius * radius * (zenithCos * zenithCos - 1.0f) + atmosphereRadius * atmosphereRadius;
+            return std::max(0.0f, -radius * zenithCos + std::sqrtf(std::max(0.0f, d)));
+        }
+
+        // Radius and zenith cosine are mapped as in Bruneton's "Precomputed Atmospheric Scattering": the radius through
+        // the distance to the horizon and the zenith cosine through the distance to the top of the atmosphere, which
+        // keeps the resolution concentrated around the horizon.
+
+        [[nodiscard]]
+        auto HorizonDistance(float const radius) const -> float
+        {
+            auto const planetRadius = pp.GetPlanetRadius();
+            return std::sqrtf(std::max(0.0f, radius * radius - planetRadius * planetRadius));
+        }
+
+        [[nodiscard]]
+        auto VToRadius(float const v) const -> float
+        {
+            auto const rho = HorizonDistance(pp.GetAtmosphereRadius()) * v;
+            return std::sqrtf(rho * rho + pp.GetPlanetRadius() * pp.GetPlanetRadius());
+        }
+
+        [[nodiscard]]
+        auto RadiusToV(float const radius) const -> float
+        {
+            return HorizonDistance(radius) / HorizonDistance(pp.GetAtmosphereRadius());
+        }
+
+        [[nodiscard]]
+        auto UToZenithCos(float const radius, float const u) const -> float
+        {
+            auto const h = HorizonDistance(pp.GetAtmosphereRadius());
+            auto const rho = HorizonDistance(radius);
+            auto const dMin = pp.GetAtmosphereRadius() - radius;
+            auto const dMax = rho + h;
+            auto const d = dMin + u * (dMax - dMin);
+
+            if(d <= 0.0f)
+            {
+                return 1.0f;
+            }
+
+            return std::clamp((h * h - rho * rho - d * d) / (2.0f * radius * d), -1.0f, 1.0f);
+        }
+
+        [[nodiscard]]
+        auto ZenithCosToU(float const radius, float const zenithCos) const -> float
+        {
+            auto const h = HorizonDistance(pp.GetAtmosphereRadius());
+            auto const rho = HorizonDistance(radius);
+            auto const dMin = pp.GetAtmosphereRadius() - radius;
+            auto const dMax = rho + h;
+
+            return (DistanceToAtmosphere(radius, zenithCos) - dMin) / (dMax - dMin);
+        }
+
+        // Texture2D::Sample places texel i at i / (resolution - 1), so texels are computed at the same coordinates.
+        [[nodiscard]]
+        auto static IndexToUnit(int const index, std::size_t const resolution) -> float
+        {
+            return static_cast<float>(index) / static_cast<float>(resolution - 1);
+        }
+    };
+}
@@ -49,6 +49,11 @@ inline auto operator/(Vector2 const& a, float const b) -> Vector2
     return { a.x / b, a.y / b};
 }
 
+inline auto Lerp(Vector2 const& a, Vector2 const& b, float const t) -> Vector2
+{
+    return { a.x * (1.0f - t) + b.x * t, a.y * (1.0f - t) + b.y * t };
+}
+
 inline auto Dot(Vector2 const& a, Vector2 const& b) -> float
 {
     return a.x * b.x + a.y * b.y;
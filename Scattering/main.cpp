@@ -1,7 +1,28 @@
 #include "ScatteringMap.hpp"
 #include "TransmittanceMap.hpp"
+#include "TransmittanceTable.hpp"
 #include "IrradianceMap.hpp"
+#include "MultipleScattering.hpp"
 #include "TextureExport.hpp"
+#include "TextureCache.hpp"
+#include "ParameterSweep.hpp"
+#include "TableFile.hpp"
+#include "SkyRenderer.hpp"
+
+namespace
+{
+    auto PrintComputeResult(bool const cacheHit, std::int64_t const evaluationCount) -> void
+    {
+        if(cacheHit)
+        {
+            std::cout << "  loaded from cache" << std::endl;
+        }
+        else
+        {
+            std::cout << "  density evaluations: " << evaluationCount << std::endl;
+        }
+    }
+}
 
 auto main() -> int
 {
@@ -17,30 +38,152 @@ auto main() -> int
     pp.SetRayleightExtinctionCoef(Vector3(0.0331f, 0.0135f, 0.0058f));
 
 
+    auto const cache = Atmos::TextureCache("cache");
+
+    std::cout << "Instruction set: " << Atmos::Simd::GetIsaName(Atmos::Simd::GetIsa()) << std::endl;
+
     std::cout << "Computing transmittance map" << std::endl;
     auto transmittanceMap = Atmos::TransmittanceMap(512, pp, { 512 });
-    transmittanceMap.Compute();
+    auto const transmittanceMapHit = transmittanceMap.Compute(cache);
+    PrintComputeResult(transmittanceMapHit, transmittanceMap.GetEvaluationCount());
 
     Atmos::ExportTexture::ExportTexturePPM(transmittanceMap.GetTexture(), "transmittance.ppm", 1.0f);
     Atmos::ExportTexture::ExportTextureBinary16(transmittanceMap.GetTexture(), "transmittance.bin");
 
+    std::cout << "Computing transmittance table" << std::endl;
+    auto transmittanceTable = Atmos::TransmittanceTable(256, 64, pp,
+        { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+    auto const transmittanceTableHit = transmittanceTable.Compute(cache);
+    PrintComputeResult(transmittanceTableHit, transmittanceTable.GetEvaluationCount());
+
+    Atmos::ExportTexture::ExportTexturePPM(transmittanceTable.GetTexture(), "transmittance-table.ppm", 1.0f);
+    Atmos::ExportTexture::ExportTextureBinary16(transmittanceTable.GetTexture(), "transmittance-table.bin");
+
     std::cout << "Computing scattering map" << std::endl;
-    auto scatteringMap = Atmos::ScatteringMap(512, 512, pp, { 256 }, { 256 });
-    scatteringMap.Compute(
+    auto scatteringMap = Atmos::ScatteringMap(512, 512, transmittanceTable,
+        { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+    auto const scatteringMapHit = scatteringMap.Compute(
+        cache,
         Atmos::ScatteringMap::Mapping::Linear,
         Atmos::ScatteringMap::Mapping::Linear
     );
+    PrintComputeResult(scatteringMapHit, scatteringMap.GetEvaluationCount());
 
     Atmos::ExportTexture::ExportTexturePPM(scatteringMap.GetTexture(), "scattering.ppm");
     Atmos::ExportTexture::ExportTextureBinary16(scatteringMap.GetTexture(), "scattering.bin");
 
 
+    std::cout << "Computing spectral scattering map" << std::endl;
+    auto const spectralScattering = scatteringMap.ComputeSpectral(Atmos::SpectralPlanetProperties<8>(pp),
+        Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear);
+    PrintComputeResult(false, scatteringMap.GetEvaluationCount());
+
+    Atmos::ExportTexture::ExportTexturePPM(spectralScattering, "scattering-spectral.ppm");
+    Atmos::ExportTexture::ExportTextureBinary16(spectralScattering, "scattering-spectral.bin");
+
+
+    std::cout << "Computing full scattering table" << std::endl;
+    auto fullScatteringMap = Atmos::ScatteringMap(64, 32, 8, 16, transmittanceTable,
+        { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted });
+    auto const fullScatteringMapHit = fullScatteringMap.ComputeFullDeferred(
+        cache,
+        Atmos::ScatteringMap::Mapping::Cubic,
+        Atmos::ScatteringMap::Mapping::Linear
+    );
+    PrintComputeResult(fullScatteringMapHit, fullScatteringMap.GetEvaluationCount());
+
+    Atmos::ExportTexture::ExportTextureBinary16(fullScatteringMap.GetFullTexture(), "scattering-full.bin");
+
+
     std::cout << "Computing irradiance map" << std::endl;
-    auto irradianceMap = Atmos::IrradianceMap(512, 128, pp, { 128 }, { 128 });
-    irradianceMap.Compute();
+    auto irradianceMap = Atmos::IrradianceMap(512, 128, transmittanceTable,
+        { 32, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+    auto const irradianceMapHit = irradianceMap.Compute(cache);
+    PrintComputeResult(irradianceMapHit, irradianceMap.GetEvaluationCount());
 
     Atmos::ExportTexture::ExportTexturePPM(irradianceMap.GetTexture(), "irradiance.ppm", 10.0f);
     Atmos::ExportTexture::ExportTextureBinary16(irradianceMap.GetTexture(), "irradiance.bin");
 
+
+    std::cout << "Rendering sky" << std::endl;
+    auto const skyRenderer = Atmos::SkyRenderer(fullScatteringMap, transmittanceTable, irradianceMap,
+        { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted },
+        { 32, Atmos::Transmittance::Method::Numeric, Atmos::Kernel::Packet, Atmos::QuadratureRule::GaussLegendre });
+    for(auto const projection : { Atmos::SkyRenderer::Projection::Equirectangular, Atmos::SkyRenderer::Projection::Fisheye })
+    {
+        auto camera = Atmos::SkyRenderer::Camera();
+        camera.projection = projection;
+        camera.width = projection == Atmos::SkyRenderer::Projection::Fisheye ? 256 : 512;
+        camera.height = 256;
+        auto const name = std::string(projection == Atmos::SkyRenderer::Projection::Fisheye ? "sky-fisheye" : "sky-equirectangular");
+
+        auto const tables = skyRenderer.Render(camera, Atmos::SkyRenderer::Mode::Tables);
+        auto const raymarch = skyRenderer.Render(camera, Atmos::SkyRenderer::Mode::Raymarch);
+        auto const difference = Atmos::SkyRenderer::Compare(tables.image, raymarch.image);
+        std::cout << "  " << name << ": tables " << tables.seconds * 1e3 << " ms, raymarch " << raymarch.seconds * 1e3
+            << " ms, difference max " << difference.maxAbsolute << ", rms " << difference.rms << ", relative "
+            << difference.maxRelative << std::endl;
+
+        Atmos::ExportTexture::ExportTexturePPM(tables.image, (name + "-tables.ppm").c_str());
+        Atmos::ExportTexture::ExportTexturePPM(raymarch.image, (name + "-raymarch.ppm").c_str());
+    }
+
+
+    std::cout << "Computing multiple scattering" << std::endl;
+    auto multipleScattering = Atmos::MultipleScattering(64, 64, 16, transmittanceTable,
+        { 64, Atmos::Kernel::Packet, Atmos::QuadratureRule::AltitudeAdapted }, {});
+    auto const multipleScatteringHit = multipleScattering.Compute(cache);
+    PrintComputeResult(multipleScatteringHit, multipleScattering.GetEvaluationCount());
+
+    auto const& orderContributions = multipleScattering.GetOrderContributions();
+    for(std::size_t order = 0; order < orderContributions.size(); ++order)
+    {
+        std::cout << "  order " << order + 1 << ": " << orderContributions[order] << std::endl;
+    }
+
+    Atmos::ExportTexture::ExportTextureBinary16(multipleScattering.GetMultipleTexture(), "multiple-scattering.bin");
+
+
+    std::cout << "Writing table file" << std::endl;
+    Atmos::TableFileWriter()
+        .Add("transmittance", transmittanceTable.GetTexture())
+        .Add("scattering", scatteringMap.GetTexture(),
+            Atmos::ScatteringMap::Mapping::Linear, Atmos::ScatteringMap::Mapping::Linear)
+        .Add("scattering-full", fullScatteringMap.GetFullTexture(),
+            Atmos::ScatteringMap::Mapping::Cubic, Atmos::ScatteringMap::Mapping::Linear)
+        .Add("irradiance", irradianceMap.GetTexture())
+        .Add("multiple-scattering", multipleScattering.GetMultipleTexture())
+        .Write("atmosphere.tables", pp);
+
+    auto tableFile = Atmos::TableFile();
+    if(tableFile.Open("atmosphere.tables"))
+    {
+        std::cout << "  " << tableFile.GetSectionCount() << " sections, checksums "
+            << (tableFile.Verify() ? "match" : "differ") << std::endl;
+    }
+
+
+    std::cout << "Running parameter sweep" << std::endl;
+    auto hazyEarth = Atmos::PlanetProperties();
+    hazyEarth.SetMieScatteringCoef(Vector3(0.02f, 0.02f, 0.02f));
+    hazyEarth.SetMieExtinctionCoef(Vector3(0.02f, 0.02f, 0.02f) / 0.9f);
+
+    auto sweepSpecs = Atmos::ParameterSweep::Specs();
+    sweepSpecs.scatteringMap->viewZenithCosResolution = 128;
+    sweepSpecs.scatteringMap->sunZenithCosResolution = 128;
+    sweepSpecs.irradianceMap->resolution = 128;
+
+    auto sweep = Atmos::ParameterSweep(sweepSpecs, &cache);
+    auto const sweepResults = sweep.Run({ { "earth", Atmos::PlanetProperties() }, { "mars", pp }, { "hazy-earth", hazyEarth } });
+    for(auto const& result : sweepResults)
+    {
+        std::cout << "  " << result.name << ": " << result.evaluationCount << " density evaluations, "
+            << result.cacheHits << " cache hits" << std::endl;
+
+        Atmos::ExportTexture::ExportTextureBinary16(result.scatteringMap->GetTexture(), ("sweep-" + result.name + "-scattering.bin").c_str());
+        Atmos::ExportTexture::ExportTextureBinary16(result.irradianceMap->GetTexture(), ("sweep-" + result.name + "-irradiance.bin").c_str());
+    }
+    std::cout << "  " << sweep.GetComputedVariantsPerHour() << " computed variants per hour" << std::endl;
+
     return 0;
 }